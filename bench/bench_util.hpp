@@ -0,0 +1,190 @@
+#ifndef BENCH_UTIL_HPP
+#define BENCH_UTIL_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "net_util.hpp"
+
+using BenchClock = std::chrono::steady_clock;
+
+inline double secondsSince(BenchClock::time_point t0) {
+    return std::chrono::duration<double>(BenchClock::now() - t0).count();
+}
+
+/**
+ * ZipfGenerator: item ranks in [0, n) with P(rank k) ~ 1 / (k+1)^theta,
+ * using Gray et al.'s closed-form method (as in YCSB), O(1) per sample.
+ * Rank 0 is the hottest item; scramble ranks if hot keys must not cluster.
+ */
+class ZipfGenerator {
+public:
+    ZipfGenerator(uint64_t n, double theta = 0.99, uint64_t seed = 42)
+        : n_(n), theta_(theta), rng_(seed), uniform_(0.0, 1.0)
+    {
+        zetaN_ = zeta(n_, theta_);
+        const double zeta2 = zeta(2, theta_);
+        alpha_ = 1.0 / (1.0 - theta_);
+        eta_ = (1.0 - std::pow(2.0 / n_, 1.0 - theta_)) / (1.0 - zeta2 / zetaN_);
+    }
+
+    uint64_t next() {
+        const double u = uniform_(rng_);
+        const double uz = u * zetaN_;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, theta_)) {
+            return 1;
+        }
+        const uint64_t k = static_cast<uint64_t>(n_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return k < n_ ? k : n_ - 1;
+    }
+
+private:
+    static double zeta(uint64_t n, double theta) {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        return sum;
+    }
+
+    uint64_t n_;
+    double theta_;
+    double zetaN_;
+    double alpha_;
+    double eta_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> uniform_;
+};
+
+// Spreads Zipf ranks over the key space (FNV-1a of the rank)
+inline uint64_t scrambleRank(uint64_t rank, uint64_t n) {
+    uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < 8; ++i) {
+        h ^= (rank >> (i * 8)) & 0xFF;
+        h *= 1099511628211ULL;
+    }
+    return h % n;
+}
+
+// "name=host:port,..." as given to load_gen/ycsb; names must match the
+// nodes' own, since clients place keys by node name
+inline bool parseNodeList(const std::string &list, std::vector<NodeAddress> &out) {
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string item = list.substr(pos, end - pos);
+        const size_t eq = item.find('=');
+        const size_t colon = item.rfind(':');
+        if (eq == std::string::npos || colon == std::string::npos || colon < eq) {
+            return false;
+        }
+        out.push_back({item.substr(0, eq), item.substr(eq + 1, colon - eq - 1),
+                       std::atoi(item.c_str() + colon + 1)});
+        pos = end + 1;
+    }
+    return !out.empty();
+}
+
+/**
+ * HdrHistogram: latency histogram in the HdrHistogram layout. Values are kept
+ * with `digits` significant decimal digits over [0, maxValue] in a fixed
+ * array: each power-of-two range is split into the same number of linear
+ * sub-buckets, so record() is a few shifts and percentiles are exact to that
+ * precision. Not thread-safe; give each thread one and merge() them.
+ */
+class HdrHistogram {
+public:
+    explicit HdrHistogram(uint64_t maxValue = 60ull * 1000 * 1000 * 1000, int digits = 3) {
+        const uint64_t largestExact = 2 * static_cast<uint64_t>(std::pow(10.0, digits));
+        subBucketBits_ = 0;
+        while ((uint64_t(1) << subBucketBits_) < largestExact) {
+            ++subBucketBits_;
+        }
+        subBucketMask_ = (uint64_t(1) << subBucketBits_) - 1;
+        maxValue_ = maxValue;
+        int buckets = 1;
+        while ((subBucketMask_ << (buckets - 1)) < maxValue) {
+            ++buckets;
+        }
+        counts_.assign(static_cast<size_t>(buckets + 1) << (subBucketBits_ - 1), 0);
+    }
+
+    void record(uint64_t value) {
+        value = std::min(value, maxValue_);
+        ++counts_[indexOf(value)];
+        ++total_;
+        max_ = std::max(max_, value);
+        sum_ += static_cast<double>(value);
+    }
+
+    void merge(const HdrHistogram &other) {
+        for (size_t i = 0; i < counts_.size() && i < other.counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        max_ = std::max(max_, other.max_);
+        sum_ += other.sum_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ == 0 ? 0.0 : sum_ / total_; }
+
+    // Smallest recorded value (to the histogram's precision) that at least
+    // p percent of values are at or below; p in [0, 100]
+    uint64_t percentile(double p) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * total_)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(highestEquivalent(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    size_t indexOf(uint64_t value) const {
+        // Bucket 0 holds [0, 2^subBucketBits) exactly; bucket b > 0 holds the
+        // upper half of its sub-buckets at a resolution of 2^b
+        const int bucket = 63 - __builtin_clzll(value | subBucketMask_) - (subBucketBits_ - 1);
+        const uint64_t sub = value >> bucket;
+        return (static_cast<size_t>(bucket) << (subBucketBits_ - 1)) + sub;
+    }
+
+    uint64_t highestEquivalent(size_t index) const {
+        const size_t half = size_t(1) << (subBucketBits_ - 1);
+        if (index < 2 * half) {
+            return index;
+        }
+        const int bucket = static_cast<int>(index / half) - 1;
+        const uint64_t sub = index - static_cast<size_t>(bucket) * half;
+        return (sub << bucket) + ((uint64_t(1) << bucket) - 1);
+    }
+
+    int subBucketBits_;
+    uint64_t subBucketMask_;
+    uint64_t maxValue_;
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+    double sum_ = 0;
+};
+
+#endif // BENCH_UTIL_HPP
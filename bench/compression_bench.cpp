@@ -0,0 +1,127 @@
+// Memory saved and CPU spent by ConcurrentHashMap value compression, on
+// JSON-like records of a few hundred bytes: off, LZ, and LZ with a dictionary
+// trained on a sample of the values. Also the raw codec speed.
+//
+//   compression_bench [numKeys] [numGets]
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "compression.hpp"
+#include "datastore.hpp"
+
+namespace {
+
+std::string makeRecord(std::mt19937_64 &rng, size_t id) {
+    static const char *kRegions[] = {"eu-west-1", "us-east-1", "ap-south-1"};
+    static const char *kPlans[] = {"free", "pro", "enterprise"};
+    return "{\"id\":" + std::to_string(id) +
+           ",\"name\":\"user" + std::to_string(rng() % 100000) +
+           "\",\"email\":\"user" + std::to_string(rng() % 100000) + "@example.com\"" +
+           ",\"region\":\"" + kRegions[rng() % 3] +
+           "\",\"plan\":\"" + kPlans[rng() % 3] +
+           "\",\"active\":" + (rng() % 2 ? "true" : "false") +
+           ",\"balance\":" + std::to_string(rng() % 1000000) +
+           ",\"createdAt\":\"2024-0" + std::to_string(1 + rng() % 9) + "-1" +
+           std::to_string(rng() % 10) + "T12:00:00Z\"" +
+           ",\"tags\":[\"newsletter\",\"beta\"],\"settings\":{\"theme\":\"dark\",\"locale\":\"en-US\"}}";
+}
+
+struct Result {
+    double bytesPerValue;  // memoryUsage() per key, overhead included
+    double putNs;
+    double getNs;
+};
+
+Result run(const std::vector<std::string> &values, size_t numGets, size_t minBytes,
+           std::shared_ptr<const CompressionDictionary> dict) {
+    ConcurrentHashMap::Options opts;
+    opts.compressMinBytes = minBytes;
+    opts.compressionDictionary = std::move(dict);
+    ConcurrentHashMap map(opts);
+
+    std::vector<std::string> keys;
+    keys.reserve(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        keys.push_back("user:" + std::to_string(i));
+    }
+    auto t0 = BenchClock::now();
+    for (size_t i = 0; i < values.size(); ++i) {
+        map.put(keys[i], values[i]);
+    }
+    const double putSec = secondsSince(t0);
+
+    std::mt19937_64 rng(7);
+    std::string out;
+    size_t checksum = 0;
+    t0 = BenchClock::now();
+    for (size_t i = 0; i < numGets; ++i) {
+        map.get(keys[rng() % keys.size()], out);
+        checksum += out.size();
+    }
+    const double getSec = secondsSince(t0);
+    if (checksum == 0) {
+        std::printf("no values read\n");
+    }
+    return {static_cast<double>(map.memoryUsage()) / values.size(),
+            putSec * 1e9 / values.size(), getSec * 1e9 / numGets};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t numKeys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    const size_t numGets = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+
+    std::mt19937_64 rng(42);
+    std::vector<std::string> values;
+    size_t rawBytes = 0;
+    for (size_t i = 0; i < numKeys; ++i) {
+        values.push_back(makeRecord(rng, i));
+        rawBytes += values.back().size();
+    }
+    // Train on 1% of the data, as a deployment would on a sample
+    std::vector<std::string> samples(values.begin(), values.begin() + std::min<size_t>(numKeys, 2000));
+    auto t0 = BenchClock::now();
+    auto dict = CompressionDictionary::train(samples);
+    std::printf("%zu values, %.0f bytes avg; dictionary %zu bytes, trained in %.1f ms\n\n",
+                numKeys, static_cast<double>(rawBytes) / numKeys, dict->bytes().size(),
+                secondsSince(t0) * 1e3);
+
+    // Codec alone: ratio and speed over every value
+    for (const CompressionDictionary *d : {static_cast<const CompressionDictionary*>(nullptr), dict.get()}) {
+        std::string packed, plain;
+        size_t packedBytes = 0;
+        t0 = BenchClock::now();
+        for (const auto &v : values) {
+            packedBytes += lzCompress(v, packed, d) ? packed.size() : v.size();
+        }
+        const double compSec = secondsSince(t0);
+        lzCompress(values[0], packed, d);
+        t0 = BenchClock::now();
+        for (size_t i = 0; i < numKeys; ++i) {
+            lzDecompress(packed.data(), packed.size(), plain, d);
+        }
+        const double decompSec = secondsSince(t0);
+        std::printf("codec %-9s ratio %5.2f  compress %6.1f MB/s  decompress %7.1f MB/s\n",
+                    d ? "lz+dict" : "lz", static_cast<double>(rawBytes) / packedBytes,
+                    rawBytes / compSec / 1e6, values[0].size() * numKeys / decompSec / 1e6);
+    }
+
+    std::printf("\n%-10s %14s %10s %10s\n", "store", "bytes/value", "put ns", "get ns");
+    const struct { const char *name; size_t minBytes; bool useDict; } configs[] = {
+        {"off", 0, false},
+        {"lz", 64, false},
+        {"lz+dict", 64, true},
+    };
+    for (const auto &c : configs) {
+        Result r = run(values, numGets, c.minBytes, c.useDict ? dict : nullptr);
+        std::printf("%-10s %14.1f %10.0f %10.0f\n", c.name, r.bytesPerValue, r.putNs, r.getNs);
+    }
+    return 0;
+}
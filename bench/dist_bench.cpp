@@ -0,0 +1,300 @@
+// Google Benchmark microbenchmarks for the core building blocks, for tracking
+// regressions from run to run. Multi-threaded cases use Threads(); data size
+// is the benchmark argument. Shared fixtures are built in Setup(), once per
+// run and outside the timed region.
+//
+//   dist_bench [--benchmark_filter=regex] [--benchmark_out=f.json --benchmark_out_format=json]
+//
+// The dist_bench_json target runs everything and writes dist_bench.json.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrency.hpp"
+#include "datastore.hpp"
+#include "metrics.hpp"
+
+namespace {
+
+std::string keyFor(uint64_t i) {
+    return "key:" + std::to_string(i);
+}
+
+/******************************************************************************
+ * ConcurrentHashMap
+ *****************************************************************************/
+std::unique_ptr<ConcurrentHashMap> gMap;
+
+void setupMap(const benchmark::State &state) {
+    ConcurrentHashMap::Options opts;
+    gMap.reset(new ConcurrentHashMap(opts));
+    const std::string value(100, 'v');
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        gMap->put(keyFor(i), value);
+    }
+}
+
+void teardownMap(const benchmark::State &) {
+    gMap.reset();
+}
+
+void BM_MapGet(benchmark::State &state) {
+    std::mt19937_64 rng(state.thread_index());
+    const uint64_t keys = static_cast<uint64_t>(state.range(0));
+    std::string out;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gMap->get(keyFor(rng() % keys), out));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MapGet)->Setup(setupMap)->Teardown(teardownMap)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_MapPut(benchmark::State &state) {
+    std::mt19937_64 rng(state.thread_index());
+    const uint64_t keys = static_cast<uint64_t>(state.range(0));
+    const std::string value(100, 'w');
+    for (auto _ : state) {
+        gMap->put(keyFor(rng() % keys), value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MapPut)->Setup(setupMap)->Teardown(teardownMap)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)->ThreadRange(1, 8)->UseRealTime();
+
+/******************************************************************************
+ * ConsistentHashRing
+ *****************************************************************************/
+std::unique_ptr<ConsistentHashRing> gRing;
+
+void setupRing(const benchmark::State &state) {
+    gRing.reset(new ConsistentHashRing());
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        gRing->addNode("node" + std::to_string(i));
+    }
+}
+
+void teardownRing(const benchmark::State &) {
+    gRing.reset();
+}
+
+void BM_RingGetNode(benchmark::State &state) {
+    std::mt19937_64 rng(state.thread_index());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gRing->getNode(keyFor(rng() % 100000)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// Argument: node count (each with 100 virtual nodes)
+BENCHMARK(BM_RingGetNode)->Setup(setupRing)->Teardown(teardownRing)
+    ->Arg(3)->Arg(16)->Arg(128)->ThreadRange(1, 8)->UseRealTime();
+
+/******************************************************************************
+ * LockFreeRingBuffer (single producer, single consumer)
+ *****************************************************************************/
+using Ring = LockFreeRingBuffer<uint64_t, 1024>;
+std::unique_ptr<Ring> gRingBuffer;
+
+void setupRingBuffer(const benchmark::State &) {
+    gRingBuffer.reset(new Ring());
+}
+
+void teardownRingBuffer(const benchmark::State &) {
+    gRingBuffer.reset();
+}
+
+// Argument: items pushed, then popped, per iteration
+void BM_RingBufferBurst(benchmark::State &state) {
+    const int64_t burst = state.range(0);
+    uint64_t item = 0;
+    for (auto _ : state) {
+        for (int64_t i = 0; i < burst; ++i) {
+            gRingBuffer->push(static_cast<uint64_t>(i));
+        }
+        for (int64_t i = 0; i < burst; ++i) {
+            gRingBuffer->pop(item);
+        }
+        benchmark::DoNotOptimize(item);
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_RingBufferBurst)->Setup(setupRingBuffer)->Teardown(teardownRingBuffer)
+    ->Arg(1)->Arg(64)->Arg(1024);
+
+// Thread 0 produces and thread 1 consumes, one item per iteration each
+void BM_RingBufferHandoff(benchmark::State &state) {
+    const bool producer = state.thread_index() == 0;
+    uint64_t item = 0;
+    for (auto _ : state) {
+        while (producer ? !gRingBuffer->push(item) : !gRingBuffer->pop(item)) {
+            std::this_thread::yield();
+        }
+    }
+    benchmark::DoNotOptimize(item);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RingBufferHandoff)->Setup(setupRingBuffer)->Teardown(teardownRingBuffer)
+    ->Threads(2)->UseRealTime();
+
+/******************************************************************************
+ * ThreadPool
+ *****************************************************************************/
+std::unique_ptr<ThreadPool> gPool;
+
+void setupPool(const benchmark::State &state) {
+    gPool.reset(new ThreadPool(static_cast<size_t>(state.range(0))));
+}
+
+void teardownPool(const benchmark::State &) {
+    gPool.reset();
+}
+
+// Enqueue-to-completion cost of a trivial task; futures are collected in
+// batches of 64 so the queue stays short. Argument: worker count
+void BM_ThreadPoolEnqueue(benchmark::State &state) {
+    std::vector<std::future<int>> pending;
+    pending.reserve(64);
+    for (auto _ : state) {
+        pending.push_back(gPool->enqueue([]() { return 1; }));
+        if (pending.size() == 64) {
+            for (auto &f : pending) {
+                benchmark::DoNotOptimize(f.get());
+            }
+            pending.clear();
+        }
+    }
+    for (auto &f : pending) {
+        f.get();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPoolEnqueue)->Setup(setupPool)->Teardown(teardownPool)
+    ->Arg(1)->Arg(4)->ThreadRange(1, 4)->UseRealTime();
+
+/******************************************************************************
+ * WriteAheadLog
+ *****************************************************************************/
+const char *kWalFile = "dist_bench_wal.log";
+std::unique_ptr<WriteAheadLog> gWal;
+
+void setupWal(const benchmark::State &) {
+    std::remove(kWalFile);
+    gWal.reset(new WriteAheadLog(kWalFile));
+}
+
+void teardownWal(const benchmark::State &) {
+    gWal.reset();
+    std::remove(kWalFile);
+}
+
+// Each record is written and flushed under the log's lock. Argument: value bytes
+void BM_WalLogPut(benchmark::State &state) {
+    const std::string value(static_cast<size_t>(state.range(0)), 'v');
+    uint64_t i = static_cast<uint64_t>(state.thread_index()) << 40;
+    for (auto _ : state) {
+        gWal->logPut(keyFor(i++), value);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WalLogPut)->Setup(setupWal)->Teardown(teardownWal)
+    ->Arg(16)->Arg(256)->Arg(4096)->ThreadRange(1, 4)->UseRealTime();
+
+void setupWalFile(const benchmark::State &state) {
+    setupWal(state);
+    const std::string value(100, 'v');
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        gWal->logPut(keyFor(static_cast<uint64_t>(i)), value);
+    }
+}
+
+// Recovery of a log of N 100-byte puts into an empty map. Argument: records
+void BM_WalReplay(benchmark::State &state) {
+    for (auto _ : state) {
+        ConcurrentHashMap map;
+        gWal->replay(map);
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WalReplay)->Setup(setupWalFile)->Teardown(teardownWal)
+    ->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+
+/******************************************************************************
+ * ColumnarTable
+ *****************************************************************************/
+std::unique_ptr<ColumnarTable> gTable;
+
+void setupTable(const benchmark::State &state) {
+    gTable.reset(new ColumnarTable());
+    std::mt19937 rng(1);
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        gTable->addRow({static_cast<int>(rng() % 1000), static_cast<int>(i)});
+    }
+}
+
+void setupIndexedTable(const benchmark::State &state) {
+    setupTable(state);
+    gTable->createIndex(0);
+}
+
+void teardownTable(const benchmark::State &) {
+    gTable.reset();
+}
+
+// Full column scan. Argument: rows
+void BM_ColumnarScan(benchmark::State &state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gTable->filterLessThan(0, 500));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(int));
+}
+BENCHMARK(BM_ColumnarScan)->Setup(setupTable)->Teardown(teardownTable)
+    ->RangeMultiplier(16)->Range(1 << 12, 1 << 20)->ThreadRange(1, 4)->UseRealTime();
+
+// Range count through the sorted index: two binary searches per run
+void BM_ColumnarIndexedRange(benchmark::State &state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gTable->countInRange(0, 250, 750));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ColumnarIndexedRange)->Setup(setupIndexedTable)->Teardown(teardownTable)
+    ->RangeMultiplier(16)->Range(1 << 12, 1 << 20)->ThreadRange(1, 4)->UseRealTime();
+
+/******************************************************************************
+ * Metrics (the cost instrumentation adds to every operation)
+ *****************************************************************************/
+MetricsRegistry gMetrics;
+
+void BM_CounterAdd(benchmark::State &state) {
+    Counter &counter = gMetrics.counter("bench_ops_total", "Benchmark operations");
+    for (auto _ : state) {
+        counter.add();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CounterAdd)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_HistogramRecord(benchmark::State &state) {
+    LatencyHistogram &histogram = gMetrics.histogram("bench_seconds", "Benchmark latency");
+    uint64_t nanos = 1000;
+    for (auto _ : state) {
+        histogram.record(nanos);
+        nanos = nanos * 7 % 1000003;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HistogramRecord)->ThreadRange(1, 8)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,100 @@
+// Compares ConcurrentHashMap storage engines on a dense, prefix-sharing key
+// space: heap bytes per key, point lookup latency and prefix scan throughput.
+//
+//   engine_bench [numKeys]
+
+#include <malloc.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "datastore.hpp"
+
+namespace {
+
+size_t heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+// "tenant:<t>/user:<u>/field:<f>" -- long shared prefixes, like real key spaces
+std::vector<std::string> makeKeys(size_t n) {
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back("tenant:" + std::to_string(i % 64) + "/user:" +
+                       std::to_string(i / 64 % 4096) + "/field:" + std::to_string(i / (64 * 4096)));
+    }
+    return keys;
+}
+
+void run(const char *name, const ConcurrentHashMap::Options &opts,
+         const std::vector<std::string> &keys) {
+    const size_t before = heapInUse();
+    ConcurrentHashMap map(opts);
+    for (const auto &k : keys) {
+        map.put(k, "v");
+    }
+    const double bytesPerKey = static_cast<double>(heapInUse() - before) / keys.size();
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, keys.size() - 1);
+    const size_t lookups = 1000000;
+    std::vector<size_t> order(lookups);
+    for (auto &i : order) {
+        i = pick(rng);
+    }
+    std::string value;
+    size_t found = 0;
+    auto t0 = BenchClock::now();
+    for (size_t i : order) {
+        found += map.get(keys[i], value);
+    }
+    const double lookupNs = secondsSince(t0) * 1e9 / lookups;
+
+    // Each scan pages through one tenant's keys
+    double scanKeysPerSec = 0;
+    std::vector<std::pair<std::string, std::string>> page;
+    std::string cursor;
+    if (map.scan("", "", 0, page, cursor)) {
+        size_t scanned = 0;
+        t0 = BenchClock::now();
+        for (int t = 0; t < 64; ++t) {
+            const std::string prefix = "tenant:" + std::to_string(t) + "/";
+            const std::string end = ConcurrentHashMap::prefixEnd(prefix);
+            cursor = prefix;
+            do {
+                page.clear();
+                map.scan(cursor, end, 1000, page, cursor);
+                scanned += page.size();
+            } while (!cursor.empty());
+        }
+        scanKeysPerSec = scanned / secondsSince(t0);
+    }
+
+    std::printf("%-12s %10.1f %12.1f %16.0f   (%zu hits)\n",
+                name, bytesPerKey, lookupNs, scanKeysPerSec, found);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t numKeys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const std::vector<std::string> keys = makeKeys(numKeys);
+
+    std::printf("%-12s %10s %12s %16s\n", "engine", "bytes/key", "lookup ns", "scan keys/s");
+    ConcurrentHashMap::Options hash;
+    run("hash", hash, keys);
+
+    ConcurrentHashMap::Options hashIndexed;
+    hashIndexed.orderedIndex = true;
+    run("hash+index", hashIndexed, keys);
+
+    ConcurrentHashMap::Options art;
+    art.engine = ConcurrentHashMap::Engine::ART;
+    run("art", art, keys);
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Hit ratio and throughput of ConcurrentHashMap eviction policies on Zipfian
+// traces, used as a look-aside cache: get, and put on a miss.
+//
+//   eviction_bench [numKeys] [numOps] [threads]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "datastore.hpp"
+
+namespace {
+
+struct Result {
+    double hitRatio;
+    double opsPerSec;
+};
+
+Result run(EvictionKind kind, size_t cacheBytes, size_t numKeys, size_t numOps,
+           double theta, size_t threads) {
+    ConcurrentHashMap::Options opts;
+    opts.maxMemoryBytes = cacheBytes;
+    opts.eviction = kind;
+    ConcurrentHashMap map(opts);
+
+    std::vector<size_t> hits(threads, 0);
+    std::vector<std::thread> workers;
+    const std::string value(100, 'v');
+    auto t0 = BenchClock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            ZipfGenerator zipf(numKeys, theta, 1000 + t);
+            std::string out;
+            for (size_t i = 0; i < numOps / threads; ++i) {
+                const std::string key = "key:" + std::to_string(scrambleRank(zipf.next(), numKeys));
+                if (map.get(key, out)) {
+                    ++hits[t];
+                } else {
+                    map.put(key, value);
+                }
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const double elapsed = secondsSince(t0);
+    size_t total = 0;
+    for (size_t h : hits) {
+        total += h;
+    }
+    const size_t ops = numOps / threads * threads;
+    return {static_cast<double>(total) / ops, ops / elapsed};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t numKeys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const size_t numOps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4000000;
+    const size_t threads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 4;
+
+    // Approximate charged size of one entry: key + 100-byte value + overhead
+    const size_t entryBytes = 12 + 100 + 64;
+    const struct { EvictionKind kind; const char *name; } policies[] = {
+        {EvictionKind::SampledLRU, "sampled-lru"},
+        {EvictionKind::Clock, "clock"},
+        {EvictionKind::TinyLFU, "w-tinylfu"},
+    };
+    std::printf("%-12s %6s %8s %10s %12s\n", "policy", "theta", "cache%", "hit ratio", "ops/s");
+    for (double theta : {0.8, 0.99}) {
+        for (double fraction : {0.01, 0.1}) {
+            const size_t cacheBytes = static_cast<size_t>(numKeys * fraction) * entryBytes;
+            for (const auto &p : policies) {
+                Result r = run(p.kind, cacheBytes, numKeys, numOps, theta, threads);
+                std::printf("%-12s %6.2f %7.0f%% %10.4f %12.0f\n",
+                            p.name, theta, fraction * 100, r.hitRatio, r.opsPerSec);
+            }
+        }
+    }
+    return 0;
+}
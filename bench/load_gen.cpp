@@ -0,0 +1,245 @@
+// End-to-end load generator: drives a GET/PUT mix at DistributedNodes over
+// many concurrent connections and reports latency percentiles.
+//
+//   load_gen [--flag=value ...]
+//
+//   --nodes=name=host:port,...  target an existing cluster (names as given to
+//                               each node, since the client hashes by name);
+//                               default: start --local nodes in this process
+//   --local=N          in-process nodes on ports 7201.. (default 1)
+//   --connections=N    concurrent requests in flight (default 16)
+//   --mode=closed|open closed: each connection sends its next request when the
+//                      previous one completes; open: requests are due at a
+//                      fixed total --rate whether or not earlier ones are done
+//   --rate=N           open loop arrival rate, requests/s (default 10000)
+//   --duration=S       measured seconds (default 10), after --warmup=S (1)
+//   --keys=N           key space, preloaded before the run (default 100000)
+//   --dist=zipf|uniform key popularity (default zipf), --theta=F (0.99)
+//   --read=F           fraction of GETs (default 0.95)
+//   --value-size=N     PUT value bytes (default 100)
+//
+// Open loop avoids coordinated omission: each request's latency is measured
+// from the time it was due, not from when a free connection got to send it,
+// so a stalled server is charged for the requests that queued behind the
+// stall. The separate "service" row is the send-to-reply time alone.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "client.hpp"
+#include "distributed_node.hpp"
+
+namespace {
+
+struct Config {
+    std::vector<NodeAddress> nodes;
+    size_t localNodes = 1;
+    size_t connections = 16;
+    bool openLoop = false;
+    double rate = 10000;
+    double durationSec = 10;
+    double warmupSec = 1;
+    size_t keys = 100000;
+    bool zipf = true;
+    double theta = 0.99;
+    double readFraction = 0.95;
+    size_t valueSize = 100;
+};
+
+struct WorkerStats {
+    HdrHistogram latency;
+    HdrHistogram service;
+    uint64_t gets = 0;
+    uint64_t puts = 0;
+    uint64_t errors = 0;
+};
+
+bool parseArgs(int argc, char **argv, Config &cfg) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *eq = std::strchr(arg, '=');
+        if (std::strncmp(arg, "--", 2) != 0 || eq == nullptr) {
+            return false;
+        }
+        const std::string name(arg + 2, eq);
+        const char *value = eq + 1;
+        if (name == "nodes") {
+            if (!parseNodeList(value, cfg.nodes)) {
+                return false;
+            }
+        } else if (name == "local") {
+            cfg.localNodes = std::strtoull(value, nullptr, 10);
+        } else if (name == "connections") {
+            cfg.connections = std::strtoull(value, nullptr, 10);
+        } else if (name == "mode") {
+            cfg.openLoop = std::strcmp(value, "open") == 0;
+            if (!cfg.openLoop && std::strcmp(value, "closed") != 0) {
+                return false;
+            }
+        } else if (name == "rate") {
+            cfg.rate = std::strtod(value, nullptr);
+        } else if (name == "duration") {
+            cfg.durationSec = std::strtod(value, nullptr);
+        } else if (name == "warmup") {
+            cfg.warmupSec = std::strtod(value, nullptr);
+        } else if (name == "keys") {
+            cfg.keys = std::strtoull(value, nullptr, 10);
+        } else if (name == "dist") {
+            cfg.zipf = std::strcmp(value, "zipf") == 0;
+            if (!cfg.zipf && std::strcmp(value, "uniform") != 0) {
+                return false;
+            }
+        } else if (name == "theta") {
+            cfg.theta = std::strtod(value, nullptr);
+        } else if (name == "read") {
+            cfg.readFraction = std::strtod(value, nullptr);
+        } else if (name == "value-size") {
+            cfg.valueSize = std::strtoull(value, nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return cfg.connections > 0 && cfg.keys > 0 && cfg.rate > 0 && cfg.localNodes > 0;
+}
+
+uint64_t nanosSince(BenchClock::time_point t0, BenchClock::time_point t1) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+}
+
+void runWorker(const Config &cfg, DataStoreClient &client, size_t id,
+               BenchClock::time_point start, BenchClock::time_point measureFrom,
+               BenchClock::time_point end, WorkerStats &stats) {
+    std::mt19937_64 rng(1000 + id);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::unique_ptr<ZipfGenerator> zipf;
+    if (cfg.zipf) {
+        zipf.reset(new ZipfGenerator(cfg.keys, cfg.theta, 2000 + id));
+    }
+    const std::string value(cfg.valueSize, 'v');
+    // Open loop: connection id owns arrivals id, id + connections, ...
+    const std::chrono::duration<double> interval(cfg.connections / cfg.rate);
+    auto due = start + std::chrono::duration_cast<BenchClock::duration>(interval * (id / double(cfg.connections)));
+    std::string out;
+    while (true) {
+        if (cfg.openLoop) {
+            // Timer wakeups overshoot by tens of µs; sleep short, yield the rest
+            std::this_thread::sleep_until(due - std::chrono::microseconds(100));
+            while (BenchClock::now() < due) {
+                std::this_thread::yield();
+            }
+        }
+        const auto sent = BenchClock::now();
+        const auto issued = cfg.openLoop ? due : sent;
+        if (issued >= end) {
+            break;
+        }
+        const uint64_t rank = cfg.zipf ? zipf->next() : rng() % cfg.keys;
+        const std::string key = "key:" + std::to_string(scrambleRank(rank, cfg.keys));
+        const bool isGet = coin(rng) < cfg.readFraction;
+        const bool ok = isGet ? client.get(key, out) : client.putAcked(key, value);
+        const auto done = BenchClock::now();
+        if (issued >= measureFrom) {
+            stats.latency.record(nanosSince(issued, done));
+            stats.service.record(nanosSince(sent, done));
+            ++(isGet ? stats.gets : stats.puts);
+            stats.errors += ok ? 0 : 1;
+        }
+        due += std::chrono::duration_cast<BenchClock::duration>(interval);
+    }
+}
+
+void printRow(const char *name, const HdrHistogram &h) {
+    std::printf("%-8s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name,
+                h.mean() / 1e3, h.percentile(50) / 1e3, h.percentile(90) / 1e3,
+                h.percentile(99) / 1e3, h.percentile(99.9) / 1e3, h.percentile(99.99) / 1e3,
+                h.max() / 1e3);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Config cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr, "usage: see the comment at the top of bench/load_gen.cpp\n");
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<DistributedNode>> local;
+    if (cfg.nodes.empty()) {
+        for (size_t i = 0; i < cfg.localNodes; ++i) {
+            cfg.nodes.push_back({"Load" + std::to_string(i), "127.0.0.1", 7201 + static_cast<int>(i)});
+        }
+        for (const auto &addr : cfg.nodes) {
+            const std::string wal = "/tmp/load_gen_" + addr.name + ".log";
+            std::ofstream(wal, std::ios::trunc);
+            local.push_back(std::make_unique<DistributedNode>(addr.name, wal, addr.port));
+            local.back()->setCluster(cfg.nodes, 1);
+        }
+    }
+
+    DataStoreClient client(cfg.nodes);
+    const std::string value(cfg.valueSize, 'v');
+    for (size_t i = 0; i < cfg.keys; ++i) {
+        if (!client.putAcked("key:" + std::to_string(i), value)) {
+            std::fprintf(stderr, "preload failed at key %zu\n", i);
+            return 1;
+        }
+    }
+
+    std::printf("%s loop, %zu connections, %zu nodes, %zu keys (%s), %.0f%% GET",
+                cfg.openLoop ? "open" : "closed", cfg.connections, cfg.nodes.size(), cfg.keys,
+                cfg.zipf ? ("zipf " + std::to_string(cfg.theta).substr(0, 4)).c_str() : "uniform",
+                cfg.readFraction * 100);
+    if (cfg.openLoop) {
+        std::printf(", target %.0f req/s", cfg.rate);
+    }
+    std::printf("\n");
+
+    std::vector<WorkerStats> stats(cfg.connections);
+    std::vector<std::thread> workers;
+    const auto start = BenchClock::now();
+    const auto measureFrom = start + std::chrono::duration_cast<BenchClock::duration>(
+                                         std::chrono::duration<double>(cfg.warmupSec));
+    const auto end = measureFrom + std::chrono::duration_cast<BenchClock::duration>(
+                                       std::chrono::duration<double>(cfg.durationSec));
+    for (size_t i = 0; i < cfg.connections; ++i) {
+        workers.emplace_back(runWorker, std::cref(cfg), std::ref(client), i, start,
+                             measureFrom, end, std::ref(stats[i]));
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    // Requests still in flight at the end finish late; count the full span
+    const double elapsed = std::max(cfg.durationSec, secondsSince(measureFrom));
+
+    WorkerStats total;
+    for (const auto &s : stats) {
+        total.latency.merge(s.latency);
+        total.service.merge(s.service);
+        total.gets += s.gets;
+        total.puts += s.puts;
+        total.errors += s.errors;
+    }
+    std::printf("%llu requests (%llu GET, %llu PUT), %llu failed, %.0f req/s\n\n",
+                static_cast<unsigned long long>(total.gets + total.puts),
+                static_cast<unsigned long long>(total.gets),
+                static_cast<unsigned long long>(total.puts),
+                static_cast<unsigned long long>(total.errors),
+                (total.gets + total.puts) / elapsed);
+    std::printf("%-8s %9s %9s %9s %9s %9s %9s %9s\n", "us", "mean", "p50", "p90", "p99",
+                "p99.9", "p99.99", "max");
+    printRow(cfg.openLoop ? "latency" : "service", cfg.openLoop ? total.latency : total.service);
+    if (cfg.openLoop) {
+        printRow("service", total.service);
+    }
+    return 0;
+}
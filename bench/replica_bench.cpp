@@ -0,0 +1,178 @@
+// GET latency under Zipfian key skew against a local three-node cluster
+// (replication factor 3), reading from the owner only versus spreading
+// reads over the replica set with power-of-two-choices. Every key read is
+// owned by the same node, the hot spot that replica reads exist for, and
+// that node also serves background traffic: `busyThreads` connections that
+// each deliver a GET in two halves `busyUs` apart, holding the owner's
+// accept loop without using CPU (as a slow or distant client would). Owner
+// reads queue behind it; P2C steers toward the idle replicas.
+//
+//   replica_bench [numKeys] [opsPerThread] [threads] [theta] [busyThreads] [busyUs]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_util.hpp"
+#include "client.hpp"
+#include "distributed_node.hpp"
+#include "net_util.hpp"
+
+namespace {
+
+struct Result {
+    double p50Us;
+    double p99Us;
+    double p999Us;
+    double opsPerSec;
+    std::vector<size_t> readsPerNode;
+};
+
+double percentile(const std::vector<double> &sorted, double p) {
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+Result run(const std::vector<NodeAddress> &cluster, size_t readReplicas,
+           const std::vector<std::string> &keys, size_t opsPerThread, size_t threads,
+           double theta) {
+    DataStoreClient::Options opts;
+    opts.readReplicas = readReplicas;
+    DataStoreClient client(cluster, opts);
+
+    std::vector<std::vector<double>> latencies(threads);
+    std::vector<std::thread> workers;
+    auto t0 = BenchClock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            ZipfGenerator zipf(keys.size(), theta, 2000 + t);
+            std::string out;
+            latencies[t].reserve(opsPerThread);
+            for (size_t i = 0; i < opsPerThread; ++i) {
+                const std::string &key = keys[zipf.next()];
+                auto start = BenchClock::now();
+                client.get(key, out);
+                latencies[t].push_back(secondsSince(start) * 1e6);
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const double elapsed = secondsSince(t0);
+    std::vector<double> all;
+    for (const auto &l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    return {percentile(all, 0.5), percentile(all, 0.99), percentile(all, 0.999),
+            all.size() / elapsed, client.readsPerNode()};
+}
+
+// Until stop: GETs to addr sent in two halves, busyUs apart
+void occupy(const NodeAddress &addr, const std::string &key, size_t busyUs,
+            const std::atomic<bool> &stop) {
+    const std::string request = "GET " + key + "\n";
+    while (!stop.load()) {
+        int sock = connectTo(addr.host, addr.port);
+        if (sock < 0) {
+            continue;
+        }
+        sendAll(sock, request.substr(0, 2));
+        std::this_thread::sleep_for(std::chrono::microseconds(busyUs));
+        sendAll(sock, request.substr(2));
+        char buf[128];
+        recv(sock, buf, sizeof(buf), 0);
+        close(sock);
+    }
+}
+
+// The first numKeys of "key:0", "key:1", ... that the client's ring assigns
+// to `owner`
+std::vector<std::string> keysOwnedBy(const std::vector<NodeAddress> &cluster,
+                                     const std::string &owner, size_t numKeys) {
+    ConsistentHashRing ring;
+    for (const auto &addr : cluster) {
+        ring.addNode(addr.name);
+    }
+    std::vector<std::string> keys;
+    for (size_t i = 0; keys.size() < numKeys; ++i) {
+        std::string key = "key:" + std::to_string(i);
+        if (ring.getNode(key) == owner) {
+            keys.push_back(std::move(key));
+        }
+    }
+    return keys;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t numKeys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100;
+    const size_t opsPerThread = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5000;
+    const size_t threads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 4;
+    const double theta = argc > 4 ? std::strtod(argv[4], nullptr) : 0.99;
+    const size_t busyThreads = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 2;
+    const size_t busyUs = argc > 6 ? std::strtoull(argv[6], nullptr, 10) : 2000;
+
+    const std::vector<NodeAddress> cluster = {
+        {"BenchA", "127.0.0.1", 7101},
+        {"BenchB", "127.0.0.1", 7102},
+        {"BenchC", "127.0.0.1", 7103},
+    };
+    std::vector<std::unique_ptr<DistributedNode>> nodes;
+    for (const auto &addr : cluster) {
+        const std::string wal = "/tmp/replica_bench_" + addr.name + ".log";
+        std::ofstream(wal, std::ios::trunc);
+        nodes.push_back(std::make_unique<DistributedNode>(addr.name, wal, addr.port));
+        nodes.back()->setCluster(cluster, 3);
+    }
+
+    const std::vector<std::string> keys = keysOwnedBy(cluster, cluster[0].name, numKeys);
+    DataStoreClient loader(cluster);
+    for (const auto &key : keys) {
+        loader.put(key, std::string(32, 'v'));
+    }
+    // Wait until every replica has applied the owner's forwarded writes
+    std::string out;
+    for (auto &node : nodes) {
+        for (const auto &key : keys) {
+            while (!node->get(key, out)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> busy;
+    for (size_t i = 0; i < busyThreads; ++i) {
+        busy.emplace_back(occupy, std::cref(cluster[0]), keys[0], busyUs, std::cref(stop));
+    }
+
+    std::printf("%-10s %9s %9s %9s %10s  %s\n", "reads", "p50 us", "p99 us", "p99.9 us",
+                "ops/s", "reads per node");
+    for (size_t replicas : {1, 3}) {
+        Result r = run(cluster, replicas, keys, opsPerThread, threads, theta);
+        std::string perNode;
+        for (size_t n : r.readsPerNode) {
+            perNode += std::to_string(n) + " ";
+        }
+        std::printf("%-10s %9.1f %9.1f %9.1f %10.0f  %s\n",
+                    replicas == 1 ? "owner" : "p2c x3", r.p50Us, r.p99Us, r.p999Us,
+                    r.opsPerSec, perNode.c_str());
+    }
+    stop = true;
+    for (auto &t : busy) {
+        t.join();
+    }
+    return 0;
+}
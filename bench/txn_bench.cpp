@@ -0,0 +1,79 @@
+// Abort rate and throughput of optimistic transactions under contention:
+// each transaction moves one unit between two random accounts (two reads,
+// two writes) and retries until it commits. Fewer accounts = more conflicts.
+//
+//   txn_bench [txnsPerThread] [threads]
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "transaction.hpp"
+
+namespace {
+
+struct Result {
+    double abortRate;
+    double commitsPerSec;
+};
+
+Result run(size_t accounts, size_t txnsPerThread, size_t threads) {
+    ConcurrentHashMap::Options opts;
+    ConcurrentHashMap map(opts);
+    for (size_t i = 0; i < accounts; ++i) {
+        map.put("acct:" + std::to_string(i), "1000");
+    }
+
+    std::atomic<size_t> aborts{0};
+    std::vector<std::thread> workers;
+    auto t0 = BenchClock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937_64 rng(3000 + t);
+            std::uniform_int_distribution<size_t> pick(0, accounts - 1);
+            for (size_t i = 0; i < txnsPerThread; ++i) {
+                const size_t a = pick(rng);
+                const size_t b = (a + 1 + pick(rng) % (accounts - 1)) % accounts;
+                const std::string from = "acct:" + std::to_string(a);
+                const std::string to = "acct:" + std::to_string(b);
+                while (true) {
+                    Transaction txn(map);
+                    std::string x, y;
+                    txn.get(from, x);
+                    txn.get(to, y);
+                    txn.put(from, std::to_string(std::stoll(x) - 1));
+                    txn.put(to, std::to_string(std::stoll(y) + 1));
+                    if (txn.commit()) {
+                        break;
+                    }
+                    aborts.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const double elapsed = secondsSince(t0);
+    const size_t commits = txnsPerThread * threads;
+    return {static_cast<double>(aborts) / (commits + aborts), commits / elapsed};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t txnsPerThread = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    const size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4;
+
+    std::printf("%10s %12s %14s\n", "accounts", "abort rate", "commits/s");
+    for (size_t accounts : {2, 8, 64, 1024, 65536}) {
+        Result r = run(accounts, txnsPerThread, threads);
+        std::printf("%10zu %11.4f%% %14.0f\n", accounts, r.abortRate * 100, r.commitsPerSec);
+    }
+    return 0;
+}
@@ -0,0 +1,487 @@
+// YCSB core workloads against the store, in-process (ConcurrentHashMap) or
+// over the network protocol (DataStoreClient). Workload files and property
+// names follow YCSB's CoreWorkload, and results are printed in YCSB's
+// "[SECTION], metric, value" format so existing tooling can parse them.
+//
+//   ycsb -db map|node [-workload a..f] [-P workloadfile] [-p name=value ...]
+//        [-threads N]
+//
+// Properties (YCSB names and meaning): recordcount, operationcount,
+// fieldcount, fieldlength, readproportion, updateproportion,
+// insertproportion, scanproportion, readmodifywriteproportion,
+// requestdistribution (zipfian|uniform|latest), zipfianconstant,
+// maxscanlength, threadcount. With -db node: nodes=name=host:port,...
+// targets a running cluster, otherwise localnodes=N (default 1) are started
+// in-process on ports 7301...
+//
+// Each record is one value: fieldcount fields of fieldlength random letters
+// as "field0=...;field1=...". An update rewrites the whole record (a plain
+// key-value store has no per-field update), and a scan reads up to
+// maxscanlength records in key order from the chosen key.
+//
+//   Workload A  50% read, 50% update               zipfian
+//   Workload B  95% read,  5% update               zipfian
+//   Workload C  100% read                          zipfian
+//   Workload D  95% read,  5% insert               latest
+//   Workload E  95% scan,  5% insert               zipfian, scans up to 100
+//   Workload F  50% read, 50% read-modify-write    zipfian
+//
+// The load phase inserts recordcount records before the run phase starts.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "client.hpp"
+#include "distributed_node.hpp"
+
+namespace {
+
+using Properties = std::map<std::string, std::string>;
+
+// YCSB's core workload presets
+bool applyPreset(char workload, Properties &props) {
+    for (const char *name : {"readproportion", "updateproportion", "insertproportion",
+                             "scanproportion", "readmodifywriteproportion", "maxscanlength"}) {
+        props.erase(name);
+    }
+    props["requestdistribution"] = "zipfian";
+    switch (workload) {
+    case 'a':
+        props["readproportion"] = "0.5";
+        props["updateproportion"] = "0.5";
+        return true;
+    case 'b':
+        props["readproportion"] = "0.95";
+        props["updateproportion"] = "0.05";
+        return true;
+    case 'c':
+        props["readproportion"] = "1";
+        return true;
+    case 'd':
+        props["readproportion"] = "0.95";
+        props["insertproportion"] = "0.05";
+        props["requestdistribution"] = "latest";
+        return true;
+    case 'e':
+        props["scanproportion"] = "0.95";
+        props["insertproportion"] = "0.05";
+        props["maxscanlength"] = "100";
+        return true;
+    case 'f':
+        props["readproportion"] = "0.5";
+        props["readmodifywriteproportion"] = "0.5";
+        return true;
+    default:
+        return false;
+    }
+}
+
+// "name=value" lines; '#' starts a comment
+bool loadPropertiesFile(const std::string &path, Properties &props) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        const size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        auto trim = [](std::string s) {
+            const size_t b = s.find_first_not_of(" \t\r");
+            const size_t e = s.find_last_not_of(" \t\r");
+            return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+        };
+        props[trim(line.substr(0, eq))] = trim(line.substr(eq + 1));
+    }
+    return true;
+}
+
+double numberOr(const Properties &props, const std::string &name, double fallback) {
+    auto it = props.find(name);
+    return it == props.end() ? fallback : std::strtod(it->second.c_str(), nullptr);
+}
+
+std::string stringOr(const Properties &props, const std::string &name, const std::string &fallback) {
+    auto it = props.find(name);
+    return it == props.end() ? fallback : it->second;
+}
+
+/******************************************************************************
+ * Backends
+ *****************************************************************************/
+class Store {
+public:
+    virtual ~Store() = default;
+    virtual bool read(const std::string &key, std::string &out) = 0;
+    virtual bool write(const std::string &key, const std::string &value) = 0;
+    // Records in key order from start; false on error
+    virtual bool scan(const std::string &start, size_t count, size_t &found) = 0;
+};
+
+class MapStore : public Store {
+public:
+    explicit MapStore(const ConcurrentHashMap::Options &opts) : map_(opts) {}
+    bool read(const std::string &key, std::string &out) override {
+        return map_.get(key, out);
+    }
+    bool write(const std::string &key, const std::string &value) override {
+        map_.put(key, value);
+        return true;
+    }
+    bool scan(const std::string &start, size_t count, size_t &found) override {
+        std::vector<std::pair<std::string, std::string>> page;
+        std::string cursor;
+        const bool ok = map_.scan(start, "", count, page, cursor);
+        found = page.size();
+        return ok;
+    }
+
+private:
+    ConcurrentHashMap map_;
+};
+
+class NodeStore : public Store {
+public:
+    explicit NodeStore(const std::vector<NodeAddress> &nodes) : client_(nodes) {}
+    bool read(const std::string &key, std::string &out) override {
+        return client_.get(key, out);
+    }
+    bool write(const std::string &key, const std::string &value) override {
+        // Acknowledged, so write latency covers the store and the WAL flush
+        return client_.putAcked(key, value);
+    }
+    bool scan(const std::string &start, size_t count, size_t &found) override {
+        std::vector<std::pair<std::string, std::string>> page;
+        const bool ok = client_.scan(start, "", count, page);
+        found = page.size();
+        return ok;
+    }
+
+private:
+    DataStoreClient client_;
+};
+
+/******************************************************************************
+ * Workload
+ *****************************************************************************/
+enum Op { kRead, kUpdate, kInsert, kScan, kReadModifyWrite, kNumOps };
+const char *kOpNames[kNumOps] = {"READ", "UPDATE", "INSERT", "SCAN", "READ-MODIFY-WRITE"};
+
+struct Workload {
+    uint64_t recordCount;
+    uint64_t operationCount;
+    size_t fieldCount;
+    size_t fieldLength;
+    double proportions[kNumOps];
+    std::string distribution;
+    double zipfConstant;
+    size_t maxScanLength;
+    size_t threads;
+};
+
+struct OpStats {
+    HdrHistogram latency;
+    uint64_t ok = 0;
+    uint64_t failed = 0;
+};
+
+struct ThreadStats {
+    OpStats ops[kNumOps];
+};
+
+// YCSB hashes key numbers (FNV-1a 64) so inserts are not clustered
+std::string keyFor(uint64_t keynum) {
+    return "user" + std::to_string(scrambleRank(keynum, ~uint64_t(0)));
+}
+
+std::string makeRecord(const Workload &w, std::mt19937_64 &rng) {
+    std::string value;
+    value.reserve(w.fieldCount * (w.fieldLength + 8));
+    for (size_t f = 0; f < w.fieldCount; ++f) {
+        value += "field" + std::to_string(f) + "=";
+        for (size_t i = 0; i < w.fieldLength; ++i) {
+            value += static_cast<char>('a' + rng() % 26);
+        }
+        value += ';';
+    }
+    return value;
+}
+
+class Driver {
+public:
+    Driver(const Workload &w, Store &store)
+        : w_(w), store_(store), nextInsert_(w.recordCount), acked_(w.recordCount),
+          ackedLimit_(w.recordCount) {}
+
+    // Inserts records [from, to)
+    void load(uint64_t from, uint64_t to, size_t id, ThreadStats &stats) {
+        std::mt19937_64 rng(500 + id);
+        for (uint64_t k = from; k < to; ++k) {
+            timed(stats.ops[kInsert], [&]() { return store_.write(keyFor(k), makeRecord(w_, rng)); });
+        }
+    }
+
+    void run(uint64_t ops, size_t id, ThreadStats &stats) {
+        std::mt19937_64 rng(1000 + id);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        ZipfGenerator zipf(w_.recordCount, w_.zipfConstant, 2000 + id);
+        std::string out;
+        size_t found = 0;
+        for (uint64_t i = 0; i < ops; ++i) {
+            const Op op = chooseOp(coin(rng));
+            OpStats &s = stats.ops[op];
+            if (op == kInsert) {
+                const uint64_t k = nextInsert_.fetch_add(1);
+                timed(s, [&]() { return store_.write(keyFor(k), makeRecord(w_, rng)); });
+                acknowledge(k);
+                continue;
+            }
+            const std::string key = keyFor(chooseKey(zipf, rng));
+            switch (op) {
+            case kRead:
+                timed(s, [&]() { return store_.read(key, out); });
+                break;
+            case kUpdate: {
+                const std::string value = makeRecord(w_, rng);
+                timed(s, [&]() { return store_.write(key, value); });
+                break;
+            }
+            case kScan: {
+                const size_t len = 1 + rng() % w_.maxScanLength;
+                timed(s, [&]() { return store_.scan(key, len, found) && found > 0; });
+                break;
+            }
+            default: {
+                const std::string value = makeRecord(w_, rng);
+                timed(s, [&]() { return store_.read(key, out) && store_.write(key, value); });
+                break;
+            }
+            }
+        }
+    }
+
+private:
+    template <class F>
+    static void timed(OpStats &s, F &&f) {
+        const auto t0 = BenchClock::now();
+        const bool ok = f();
+        s.latency.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - t0).count()));
+        ++(ok ? s.ok : s.failed);
+    }
+
+    // Inserts finish out of order; readers may only pick keys below the
+    // first one still in flight (YCSB's acknowledged counter)
+    void acknowledge(uint64_t keynum) {
+        std::lock_guard<std::mutex> lock(ackMtx_);
+        ackedOutOfOrder_.insert(keynum);
+        while (ackedOutOfOrder_.erase(acked_) != 0) {
+            ++acked_;
+        }
+        ackedLimit_.store(acked_, std::memory_order_relaxed);
+    }
+
+    Op chooseOp(double r) const {
+        double total = 0;
+        for (double p : w_.proportions) {
+            total += p;
+        }
+        r *= total;
+        for (int op = 0; op < kNumOps; ++op) {
+            if (r < w_.proportions[op]) {
+                return static_cast<Op>(op);
+            }
+            r -= w_.proportions[op];
+        }
+        return kRead;
+    }
+
+    uint64_t chooseKey(ZipfGenerator &zipf, std::mt19937_64 &rng) {
+        const uint64_t count = ackedLimit_.load(std::memory_order_relaxed);
+        if (w_.distribution == "uniform") {
+            return rng() % count;
+        }
+        if (w_.distribution == "latest") {
+            // Zipfian over recency: the newest record is the most popular
+            return count - 1 - std::min(zipf.next(), count - 1);
+        }
+        return scrambleRank(zipf.next(), w_.recordCount);
+    }
+
+    const Workload &w_;
+    Store &store_;
+    std::atomic<uint64_t> nextInsert_;
+    std::mutex ackMtx_;
+    std::set<uint64_t> ackedOutOfOrder_;
+    uint64_t acked_;
+    std::atomic<uint64_t> ackedLimit_;
+};
+
+// Runs fn(id, stats) on every thread, then reports the phase
+template <class F>
+void runPhase(const char *phase, const Workload &w, F &&fn) {
+    std::vector<ThreadStats> stats(w.threads);
+    std::vector<std::thread> workers;
+    const auto t0 = BenchClock::now();
+    for (size_t t = 0; t < w.threads; ++t) {
+        workers.emplace_back([&, t]() { fn(t, stats[t]); });
+    }
+    for (auto &th : workers) {
+        th.join();
+    }
+    const double elapsed = secondsSince(t0);
+
+    ThreadStats total;
+    uint64_t ops = 0;
+    for (const auto &s : stats) {
+        for (int op = 0; op < kNumOps; ++op) {
+            total.ops[op].latency.merge(s.ops[op].latency);
+            total.ops[op].ok += s.ops[op].ok;
+            total.ops[op].failed += s.ops[op].failed;
+        }
+    }
+    for (const auto &s : total.ops) {
+        ops += s.ok + s.failed;
+    }
+    std::printf("[%s], RunTime(ms), %.0f\n", phase, elapsed * 1e3);
+    std::printf("[%s], Throughput(ops/sec), %.1f\n", phase, ops / elapsed);
+    for (int op = 0; op < kNumOps; ++op) {
+        const OpStats &s = total.ops[op];
+        if (s.ok + s.failed == 0) {
+            continue;
+        }
+        const char *name = kOpNames[op];
+        std::printf("[%s], Operations, %llu\n", name, static_cast<unsigned long long>(s.ok + s.failed));
+        std::printf("[%s], AverageLatency(us), %.2f\n", name, s.latency.mean() / 1e3);
+        std::printf("[%s], MaxLatency(us), %.0f\n", name, s.latency.max() / 1e3);
+        std::printf("[%s], 50thPercentileLatency(us), %.0f\n", name, s.latency.percentile(50) / 1e3);
+        std::printf("[%s], 95thPercentileLatency(us), %.0f\n", name, s.latency.percentile(95) / 1e3);
+        std::printf("[%s], 99thPercentileLatency(us), %.0f\n", name, s.latency.percentile(99) / 1e3);
+        std::printf("[%s], 99.9thPercentileLatency(us), %.0f\n", name, s.latency.percentile(99.9) / 1e3);
+        std::printf("[%s], Return=OK, %llu\n", name, static_cast<unsigned long long>(s.ok));
+        if (s.failed > 0) {
+            std::printf("[%s], Return=ERROR, %llu\n", name, static_cast<unsigned long long>(s.failed));
+        }
+    }
+}
+
+int usage() {
+    std::fprintf(stderr, "usage: ycsb -db map|node [-workload a..f] [-P file] [-p name=value ...] "
+                         "[-threads N]\n");
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string db;
+    Properties props;
+    applyPreset('a', props);
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return usage();
+        }
+        const std::string value = argv[++i];
+        if (arg == "-db") {
+            db = value;
+        } else if (arg == "-workload") {
+            if (value.size() != 1 || !applyPreset(value[0], props)) {
+                return usage();
+            }
+        } else if (arg == "-P") {
+            if (!loadPropertiesFile(value, props)) {
+                std::fprintf(stderr, "cannot read %s\n", value.c_str());
+                return 1;
+            }
+        } else if (arg == "-p") {
+            const size_t eq = value.find('=');
+            if (eq == std::string::npos) {
+                return usage();
+            }
+            props[value.substr(0, eq)] = value.substr(eq + 1);
+        } else if (arg == "-threads") {
+            props["threadcount"] = value;
+        } else {
+            return usage();
+        }
+    }
+    if (db != "map" && db != "node") {
+        return usage();
+    }
+
+    Workload w;
+    w.recordCount = static_cast<uint64_t>(numberOr(props, "recordcount", 100000));
+    w.operationCount = static_cast<uint64_t>(numberOr(props, "operationcount", 100000));
+    w.fieldCount = static_cast<size_t>(numberOr(props, "fieldcount", 10));
+    w.fieldLength = static_cast<size_t>(numberOr(props, "fieldlength", 100));
+    w.proportions[kRead] = numberOr(props, "readproportion", 0);
+    w.proportions[kUpdate] = numberOr(props, "updateproportion", 0);
+    w.proportions[kInsert] = numberOr(props, "insertproportion", 0);
+    w.proportions[kScan] = numberOr(props, "scanproportion", 0);
+    w.proportions[kReadModifyWrite] = numberOr(props, "readmodifywriteproportion", 0);
+    w.distribution = stringOr(props, "requestdistribution", "zipfian");
+    w.zipfConstant = numberOr(props, "zipfianconstant", 0.99);
+    w.maxScanLength = static_cast<size_t>(numberOr(props, "maxscanlength", 1000));
+    w.threads = static_cast<size_t>(numberOr(props, "threadcount", 1));
+    if (w.recordCount == 0 || w.threads == 0 || w.maxScanLength == 0 ||
+        (w.distribution != "zipfian" && w.distribution != "uniform" && w.distribution != "latest")) {
+        return usage();
+    }
+
+    // Range scans need the ordered key index, which is off by default
+    ConcurrentHashMap::Options storeOptions;
+    storeOptions.orderedIndex = w.proportions[kScan] > 0;
+
+    std::vector<std::unique_ptr<DistributedNode>> local;
+    std::unique_ptr<Store> store;
+    if (db == "map") {
+        store.reset(new MapStore(storeOptions));
+    } else {
+        std::vector<NodeAddress> nodes;
+        if (props.count("nodes") != 0) {
+            if (!parseNodeList(props["nodes"], nodes)) {
+                return usage();
+            }
+        } else {
+            const size_t n = static_cast<size_t>(numberOr(props, "localnodes", 1));
+            for (size_t i = 0; i < n; ++i) {
+                nodes.push_back({"Ycsb" + std::to_string(i), "127.0.0.1", 7301 + static_cast<int>(i)});
+            }
+            for (const auto &addr : nodes) {
+                const std::string wal = "/tmp/ycsb_" + addr.name + ".log";
+                std::ofstream(wal, std::ios::trunc);
+                local.push_back(std::make_unique<DistributedNode>(addr.name, wal, addr.port, storeOptions));
+                local.back()->setCluster(nodes, 1);
+            }
+        }
+        store.reset(new NodeStore(nodes));
+    }
+
+    Driver driver(w, *store);
+    runPhase("LOAD", w, [&](size_t t, ThreadStats &s) {
+        driver.load(w.recordCount * t / w.threads, w.recordCount * (t + 1) / w.threads, t, s);
+    });
+    runPhase("OVERALL", w, [&](size_t t, ThreadStats &s) {
+        driver.run(w.operationCount * (t + 1) / w.threads - w.operationCount * t / w.threads, t, s);
+    });
+    return 0;
+}
@@ -0,0 +1,136 @@
+#ifndef ACCELERATOR_HPP
+#define ACCELERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "concurrency.hpp"
+
+/**
+ * Handle to a column buffer resident on an accelerator. 0 is never valid.
+ */
+using AcceleratorBuffer = uint64_t;
+
+/**
+ * One "count rows of `buffer` < `value`" request in a batched launch.
+ */
+struct LessThanPredicate {
+    AcceleratorBuffer buffer;
+    int value;
+};
+
+/**
+ * AnalyticsAccelerator: pluggable engine behind GPUAcceleratedAnalytics.
+ *
+ * Columns are uploaded once and stay resident across queries; countLessThan
+ * evaluates a whole batch of predicates, fusing those on the same buffer into
+ * one pass. Implementations must be safe to call from several threads at once.
+ */
+class AnalyticsAccelerator {
+public:
+    virtual ~AnalyticsAccelerator() = default;
+    virtual const char* name() const = 0;
+
+    // Copy a column into accelerator memory; returns 0 on failure
+    virtual AcceleratorBuffer upload(const int *data, size_t size) = 0;
+    // Grow a resident column in place (e.g. after ColumnarTable appends)
+    virtual bool append(AcceleratorBuffer buffer, const int *data, size_t size) = 0;
+    virtual void release(AcceleratorBuffer buffer) = 0;
+    virtual size_t bufferSize(AcceleratorBuffer buffer) const = 0;
+
+    // counts[i] = rows of preds[i].buffer < preds[i].value; false on an unknown buffer
+    virtual bool countLessThan(const std::vector<LessThanPredicate> &preds,
+                               std::vector<size_t> &counts) = 0;
+
+    // One-shot scan of host memory; defaults to upload + count + release
+    virtual size_t filterLessThan(const int *data, size_t size, int value);
+};
+
+/**
+ * CpuParallelAccelerator: host-memory implementation of the accelerator API.
+ * "Resident" buffers are owned host copies; each batch is split into slices
+ * across a worker pool, and every slice is walked in cache-sized tiles that
+ * run the SIMD kernel (ColumnarTable::countLessThan) once per predicate, so
+ * the tile is read from memory once no matter how many predicates share it.
+ */
+class CpuParallelAccelerator : public AnalyticsAccelerator {
+public:
+    // 0 threads = one per hardware thread
+    explicit CpuParallelAccelerator(size_t numThreads = 0);
+
+    const char* name() const override { return "cpu-parallel"; }
+
+    AcceleratorBuffer upload(const int *data, size_t size) override;
+    bool append(AcceleratorBuffer buffer, const int *data, size_t size) override;
+    void release(AcceleratorBuffer buffer) override;
+    size_t bufferSize(AcceleratorBuffer buffer) const override;
+    bool countLessThan(const std::vector<LessThanPredicate> &preds,
+                       std::vector<size_t> &counts) override;
+
+    // Host data is already "resident", so scan it in place
+    size_t filterLessThan(const int *data, size_t size, int value) override;
+
+    // Inputs smaller than this are scanned on the calling thread
+    static constexpr size_t kMinParallelRows = 256 * 1024;
+    // Rows per tile (16 KiB, comfortably inside L1)
+    static constexpr size_t kTileRows = 4096;
+
+private:
+    // Fused multi-threshold scan over one column
+    void scanColumn(const int *data, size_t size, const std::vector<int> &values,
+                    std::vector<size_t> &counts);
+
+    size_t numThreads_;
+    ThreadPool pool_;
+
+    mutable std::shared_mutex buffersMtx_;
+    std::unordered_map<AcceleratorBuffer, std::shared_ptr<std::vector<int>>> buffers_;
+    AcceleratorBuffer nextBuffer_ = 1;
+};
+
+#ifdef USE_CUDA
+/**
+ * CudaAccelerator: resident device buffers on the default CUDA device.
+ * Each launch evaluates up to kMaxPredicatesPerLaunch thresholds on one
+ * buffer; threads count in registers, warps reduce with shuffles, and each
+ * block issues a single atomicAdd per predicate.
+ */
+class CudaAccelerator : public AnalyticsAccelerator {
+public:
+    static constexpr int kMaxPredicatesPerLaunch = 16;
+
+    CudaAccelerator();
+    ~CudaAccelerator() override;
+
+    const char* name() const override { return "cuda"; }
+
+    AcceleratorBuffer upload(const int *data, size_t size) override;
+    bool append(AcceleratorBuffer buffer, const int *data, size_t size) override;
+    void release(AcceleratorBuffer buffer) override;
+    size_t bufferSize(AcceleratorBuffer buffer) const override;
+    bool countLessThan(const std::vector<LessThanPredicate> &preds,
+                       std::vector<size_t> &counts) override;
+
+    static bool deviceAvailable();
+
+private:
+    struct DeviceColumn {
+        int *data = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+    // Guards buffers_ and the launch scratch space (one launch at a time)
+    mutable std::mutex mtx_;
+    std::unordered_map<AcceleratorBuffer, DeviceColumn> buffers_;
+    AcceleratorBuffer nextBuffer_ = 1;
+    int *d_thresholds_ = nullptr;
+    unsigned long long *d_counts_ = nullptr;
+};
+#endif
+
+#endif // ACCELERATOR_HPP
@@ -0,0 +1,70 @@
+#ifndef ART_HPP
+#define ART_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "concurrency.hpp"
+
+/**
+ * ArtLeaf: one key stored in an AdaptiveRadixTree. Owners derive from it to
+ * keep their payload in the same allocation as the key.
+ */
+struct ArtLeaf {
+    explicit ArtLeaf(std::string k) : key(std::move(k)) {}
+    virtual ~ArtLeaf() = default;
+
+    const std::string key;
+};
+
+// Inner node types are private to art.cpp
+struct ArtInnerNode;
+
+/**
+ * AdaptiveRadixTree: ordered byte-string index (Leis et al.) with optimistic
+ * lock coupling.
+ *
+ * Inner nodes adapt between 4/16/48/256 children and carry an immutable
+ * compressed prefix; a key that ends inside the tree hangs off its node's
+ * terminal slot, so arbitrary bytes (including '\0') are allowed.
+ * Readers take no locks: each node has a version word that readers validate
+ * after reading it, and writers lock only the node (and, for structural
+ * changes, its parent) they modify. Replaced nodes and removed leaves are
+ * retired to an EpochManager. Emptied inner nodes are unlinked, but
+ * nodes are never shrunk to a smaller type.
+ */
+class AdaptiveRadixTree {
+public:
+    AdaptiveRadixTree();
+    ~AdaptiveRadixTree();
+
+    AdaptiveRadixTree(const AdaptiveRadixTree &) = delete;
+    AdaptiveRadixTree& operator=(const AdaptiveRadixTree &) = delete;
+
+    ArtLeaf* lookup(const std::string &key) const;
+    // Takes ownership of leaf on success; false (leaf untouched) if the key exists
+    bool insert(ArtLeaf *leaf);
+    // The removed leaf is freed once concurrent readers are done with it
+    bool remove(const std::string &key);
+
+    // Up to `limit` keys in [start, end); an empty `end` means unbounded
+    std::vector<std::string> scan(const std::string &start, const std::string &end,
+                                  size_t limit) const;
+
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+private:
+    enum class ScanStep { Continue, Stop, Restart };
+    ScanStep scanNode(const ArtInnerNode *node, std::string path, const std::string &from,
+                      const std::string &end, size_t limit,
+                      std::vector<std::string> &out) const;
+
+    ArtInnerNode *root_;
+    std::atomic<size_t> size_;
+    EpochManager epochs_;
+};
+
+#endif // ART_HPP
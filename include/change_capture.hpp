@@ -0,0 +1,93 @@
+#ifndef CHANGE_CAPTURE_HPP
+#define CHANGE_CAPTURE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "datastore.hpp"
+
+/**
+ * How one field of a captured value becomes a column cell.
+ * Int parses a plain integer; Fixed parses a decimal and keeps `scale`
+ * fractional digits (e.g. "179.33" with scale 2 -> 17933).
+ */
+enum class CaptureType { Int, Fixed };
+
+struct CaptureColumn {
+    std::string name;
+    size_t field = 0;           // index into the value split on the delimiter
+    CaptureType type = CaptureType::Int;
+    int scale = 0;
+};
+
+/**
+ * ChangeCaptureStream: feeds key-value writes into a ColumnarTable.
+ * publish() only appends to a pending batch; a background thread parses
+ * batches into rows and appends them to the table, so the write path never
+ * pays for parsing or for contention with analytic readers.
+ * Rows that fail to parse are dropped and counted in rejected(). If the worker
+ * falls behind (e.g. appends held off by long scans) and maxPending rows are
+ * already queued, publish() drops the row and counts it in dropped() rather
+ * than letting the queue grow without bound.
+ */
+class ChangeCaptureStream {
+public:
+    explicit ChangeCaptureStream(std::vector<CaptureColumn> columns,
+                                 char delimiter = ',',
+                                 size_t batchSize = 1024,
+                                 std::chrono::milliseconds flushInterval =
+                                     std::chrono::milliseconds(10),
+                                 size_t maxPending = 64 * 1024);
+    ~ChangeCaptureStream();
+
+    void publish(const std::string &key, const std::string &value);
+    // Synchronously apply everything published so far
+    void flush();
+
+    // Run f(const ColumnarTable&) while appends are held off
+    template <class F>
+    auto withTable(F &&f) const {
+        std::shared_lock<std::shared_mutex> lock(tableMtx_);
+        return f(static_cast<const ColumnarTable&>(table_));
+    }
+
+    // Column position for `name`, or -1
+    int columnIndex(const std::string &name) const;
+    const std::vector<CaptureColumn>& columns() const { return columns_; }
+    size_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+    size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void drainBatch();
+    bool parseRow(const std::string &value, std::vector<int> &row) const;
+
+    const std::vector<CaptureColumn> columns_;
+    const char delimiter_;
+    const size_t batchSize_;
+    const std::chrono::milliseconds flushInterval_;
+    const size_t maxPending_;
+
+    ColumnarTable table_;
+    mutable std::shared_mutex tableMtx_;
+
+    std::mutex queueMtx_;
+    std::condition_variable queueCv_;
+    std::vector<std::pair<std::string, std::string>> pending_;
+    bool stop_ = false;
+
+    // Serializes batch application so flush() and the worker keep order
+    std::mutex applyMtx_;
+    std::atomic<size_t> rejected_{0};
+    std::atomic<size_t> dropped_{0};
+    std::thread worker_;
+};
+
+#endif // CHANGE_CAPTURE_HPP
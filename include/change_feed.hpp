@@ -0,0 +1,120 @@
+#ifndef CHANGE_FEED_HPP
+#define CHANGE_FEED_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "push_sender.hpp"
+
+/**
+ * ChangeEvent: one logged mutation. seq is the record's ordinal in the WAL
+ * (1-based, a transaction contributes one per write), so it is stable across
+ * restarts and usable as a resume cursor.
+ */
+struct ChangeEvent {
+    enum class Op { Put, Remove };
+
+    uint64_t seq = 0;
+    Op op = Op::Put;
+    std::string key;
+    std::string value;
+    uint64_t expireAtMs = 0;
+
+    // "CHANGE seq PUT key expireAtMs value" or "CHANGE seq REMOVE key". A
+    // value with line breaks is sent as "CHANGE seq BLOB key expireAtMs len",
+    // then len raw bytes and a newline.
+    std::string format() const;
+    // For a BLOB line, *blobLen is set and the caller reads the payload
+    static bool parse(const std::string &line, ChangeEvent &out, size_t *blobLen = nullptr);
+};
+
+/**
+ * ChangeFeed: change data capture over the WAL.
+ *
+ * WriteAheadLog::attachFeed() makes the log append every record it writes
+ * (and every record it replays) here, in log order. The feed keeps the most
+ * recent events in memory, at most retainEvents of them and retainBytes of
+ * keys and values, so any number of consumers tail the same buffer by
+ * sequence number without touching the WAL file. Events are shared, not
+ * copied, between the window and its readers, and readers copy them only
+ * after releasing the lock that append() (under the WAL's lock) needs.
+ *
+ * In-process readers use read()/waitFor(). Network consumers (the CDC
+ * command) are handed to subscribe(): the feed's PushSender thread streams
+ * each of them batches of up to batchEvents lines from their own cursor,
+ * without blocking on slow sockets. A consumer whose cursor falls out of the
+ * retained window gets "ERROR TRUNCATED <firstSeq>" and is disconnected; it
+ * has to resync from a snapshot. To resume, reconnect with the last seen
+ * seq + 1.
+ */
+class ChangeFeed : private PushSender {
+public:
+    static constexpr size_t kDefaultRetainBytes = size_t(64) << 20;
+
+    explicit ChangeFeed(size_t retainEvents = 65536, size_t batchEvents = 256,
+                        size_t retainBytes = kDefaultRetainBytes);
+    ~ChangeFeed() override;
+
+    ChangeFeed(const ChangeFeed &) = delete;
+    ChangeFeed& operator=(const ChangeFeed &) = delete;
+
+    // Appends events whose seqs continue the log; all become visible at once
+    void append(std::vector<ChangeEvent> events);
+
+    // 0 if nothing has been logged
+    uint64_t lastSequence() const;
+    // Oldest retained seq; lastSequence() + 1 when the window is empty
+    uint64_t firstSequence() const;
+    // Up to max events with seq >= from. False if from is older than the window
+    bool read(uint64_t from, size_t max, std::vector<ChangeEvent> &out) const;
+    // Waits until an event with seq >= from exists; false on timeout
+    bool waitFor(uint64_t from, std::chrono::milliseconds timeout) const;
+    // Approximate bytes held by the retained window
+    size_t retainedBytes() const;
+
+    // Takes ownership of sock and streams events from seq 'from' onwards
+    void subscribe(int sock, uint64_t from);
+    size_t consumers() const { return consumerCount_.load(std::memory_order_relaxed); }
+
+private:
+    using EventPtr = std::shared_ptr<const ChangeEvent>;
+
+    struct Consumer : Connection {
+        Consumer(int s, uint64_t from) : Connection(s), cursor(from) {}
+        uint64_t cursor;
+    };
+
+    // read() without copying the events
+    bool readShared(uint64_t from, size_t max, std::vector<EventPtr> &out) const;
+    static size_t eventBytes(const ChangeEvent &e);
+    void collect(std::vector<Connection*> &out) override;
+    bool backlog(const Connection &conn) const override;
+    void fill(Connection &conn) override;
+    void drop(const std::vector<Connection*> &conns) override;
+
+    const size_t retainEvents_;
+    const size_t batchEvents_;
+    const size_t retainBytes_;
+
+    mutable std::mutex mtx_;
+    mutable std::condition_variable appended_;
+    std::deque<EventPtr> events_;
+    size_t bytes_ = 0;
+    uint64_t nextSeq_ = 1;
+
+    std::mutex consumersMtx_;
+    std::vector<Consumer*> consumers_;
+    std::atomic<size_t> consumerCount_{0};
+    // Sender thread only: lastSequence() when the current round was collected
+    uint64_t polledLast_ = 0;
+};
+
+#endif // CHANGE_FEED_HPP
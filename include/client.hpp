@@ -0,0 +1,170 @@
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "change_feed.hpp"
+#include "datastore.hpp"
+#include "hot_keys.hpp"
+#include "net_util.hpp"
+
+/**
+ * DataStoreClient: routes requests to the owning DistributedNode with the
+ * same ConsistentHashRing the cluster uses.
+ *
+ * With the near-cache enabled, the client keeps a TRACK connection to every
+ * node. Values the node marks cacheable (its hot keys) are served locally
+ * until the node pushes INVALIDATE for them. If a tracking connection drops,
+ * everything cached from that node is discarded and caching from it pauses
+ * until the connection is re-established.
+ *
+ * With readReplicas > 1, GETs are spread over the first readReplicas nodes
+ * on the key's ring walk (the nodes a DistributedNode::setCluster owner
+ * replicates to) by power-of-two-choices: two random candidates are compared
+ * on smoothed latency scaled by requests in flight, and the lighter one is
+ * asked. Replica reads are eventually consistent; writes still go to the
+ * owner.
+ */
+class DataStoreClient {
+public:
+    struct Options {
+        bool nearCache = false;
+        size_t nearCacheCapacity = 10000;
+        // Replica set size used for reads; 1 reads from the owner only
+        size_t readReplicas = 1;
+        // 0 spreads every read; otherwise only keys this client has read
+        // at least this often (per HotKeyTracker decay) go to replicas
+        uint64_t replicaReadMinCount = 0;
+    };
+
+    explicit DataStoreClient(const std::vector<NodeAddress> &nodes);
+    DataStoreClient(const std::vector<NodeAddress> &nodes, const Options &opts);
+    ~DataStoreClient();
+
+    DataStoreClient(const DataStoreClient &) = delete;
+    DataStoreClient& operator=(const DataStoreClient &) = delete;
+
+    // put() only sends the write; putAcked() returns once the owner has
+    // stored and logged it (PUT ... ACK)
+    bool put(const std::string &key, const std::string &value, uint64_t ttlMs = 0);
+    bool putAcked(const std::string &key, const std::string &value, uint64_t ttlMs = 0);
+    bool get(const std::string &key, std::string &outVal);
+    bool remove(const std::string &key);
+    // Values of any size or content (PUTBLOB/GETBLOB), sent length-prefixed
+    // instead of on a text line; putBlob returns once the owner stored it
+    bool putBlob(const std::string &key, const std::string &value, uint64_t ttlMs = 0);
+    bool getBlob(const std::string &key, std::string &outVal);
+
+    // Server-side atomic operations, always at the owner (GETS/CAS/INCR/APPEND).
+    // compareAndSwap returns false on a version conflict or network error.
+    bool getWithVersion(const std::string &key, std::string &outVal, uint64_t &version);
+    bool compareAndSwap(const std::string &key, uint64_t expectedVersion,
+                        const std::string &value, uint64_t *newVersion = nullptr);
+    bool increment(const std::string &key, int64_t delta, int64_t &result);
+    bool append(const std::string &key, const std::string &suffix, size_t *newLength = nullptr);
+    // Up to limit entries in [start, end) across the cluster (empty end =
+    // unbounded), in key order: SCAN on every node, merged. Replicated keys
+    // appear once. False if a node cannot be reached or has no ordered index
+    bool scan(const std::string &start, const std::string &end, size_t limit,
+              std::vector<std::pair<std::string, std::string>> &out);
+    // STATS HOTKEYS from one node; false if it cannot be reached
+    bool hotKeys(const std::string &nodeName, size_t n, std::vector<HotKey> &out);
+    // STATS from one node as (series, value); false if it cannot be reached
+    bool stats(const std::string &nodeName, std::vector<std::pair<std::string, double>> &out);
+
+    const NodeAddress& ownerOf(const std::string &key) const;
+    // GETs answered by each node, indexed like the constructor's node list
+    std::vector<size_t> readsPerNode() const;
+    size_t nearCacheHits() const { return nearCacheHits_.load(std::memory_order_relaxed); }
+    size_t nearCacheSize() const;
+    // True once every node's tracking connection is up
+    bool nearCacheReady() const;
+
+private:
+    struct Tracker {
+        std::atomic<bool> up{false};
+        // Bumped on every invalidation; a GET caches its reply only if this
+        // did not move while the request was in flight
+        uint64_t invalidations = 0;
+        int sock = -1;
+        std::thread thread;
+    };
+    struct CachedValue {
+        std::string value;
+        size_t node;
+    };
+    // Observed load used for replica selection
+    struct NodeLoad {
+        std::atomic<uint32_t> inflight{0};
+        std::atomic<uint64_t> latencyNs{0};  // EWMA, alpha = 1/8
+        std::atomic<size_t> reads{0};
+    };
+
+    size_t nodeIndex(const std::string &key) const;
+    // Node to send a GET for key to
+    size_t pickReadNode(const std::string &key);
+    // roundTrip() that also feeds the node's NodeLoad
+    bool timedRoundTrip(size_t node, const std::string &request, std::string &reply);
+    // Sends one command line and reads one reply line
+    bool roundTrip(size_t node, const std::string &request, std::string &reply);
+    void runTracker(size_t node);
+    void dropCachedFrom(size_t node);
+
+    std::vector<NodeAddress> nodes_;
+    std::unordered_map<std::string, size_t> byName_;
+    ConsistentHashRing ring_;
+    Options opts_;
+    std::vector<std::unique_ptr<NodeLoad>> load_;
+    HotKeyTracker readCounts_;
+
+    mutable std::mutex cacheMtx_;
+    std::unordered_map<std::string, CachedValue> cache_;
+    std::atomic<size_t> nearCacheHits_{0};
+
+    std::vector<std::unique_ptr<Tracker>> trackers_;
+    std::atomic<bool> stop_{false};
+    std::mutex stopMtx_;
+    std::condition_variable stopCv_;
+};
+
+/**
+ * ChangeFeedReader: consumes one node's CDC stream. cursor() is the next
+ * sequence number wanted; persist it and hand it to a new reader to resume
+ * after a disconnect or restart without gaps or repeats.
+ */
+class ChangeFeedReader {
+public:
+    // fromSeq 0 starts at the oldest event the node still retains
+    ChangeFeedReader(const NodeAddress &node, uint64_t fromSeq);
+    ~ChangeFeedReader();
+
+    ChangeFeedReader(const ChangeFeedReader &) = delete;
+    ChangeFeedReader& operator=(const ChangeFeedReader &) = delete;
+
+    // Blocks for the next event, reconnecting once from cursor() if the
+    // stream drops. False if the node is unreachable or the cursor has
+    // fallen out of its retained window (see truncated()).
+    bool next(ChangeEvent &out);
+    uint64_t cursor() const { return cursor_; }
+    bool truncated() const { return truncated_; }
+
+private:
+    bool connect();
+    void disconnect();
+
+    NodeAddress node_;
+    uint64_t cursor_;
+    int sock_ = -1;
+    std::unique_ptr<SocketReader> reader_;
+    bool truncated_ = false;
+};
+
+#endif // CLIENT_HPP
@@ -0,0 +1,83 @@
+#ifndef COLUMN_FILE_HPP
+#define COLUMN_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * On-disk column file layout (native little-endian):
+ *
+ *   [0, 4096)              ColumnFileHeader, zero padded to one page
+ *   [4096, 4096 + 4*rows)  int32 values, chunked every `chunkRows` rows
+ *   [.., ..)               ZoneMap per chunk (min/max)
+ *   last 24 bytes          ColumnFileTail (footer offset, chunk count, magic)
+ *
+ * The data region starts on a page boundary and chunkRows is kept a multiple
+ * of 1024, so every chunk is page aligned and can be paged in independently.
+ */
+struct ZoneMap {
+    int32_t min;
+    int32_t max;
+};
+
+struct ColumnFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunkRows;
+    uint64_t numRows;
+    uint64_t numChunks;
+};
+
+struct ColumnFileTail {
+    uint64_t footerOffset;
+    uint64_t numChunks;
+    char magic[8];
+};
+
+class ColumnFile {
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kDataOffset = 4096;
+    static constexpr size_t kChunkAlignRows = 1024;
+    static constexpr size_t kDefaultChunkRows = 64 * 1024;
+
+    // Write `numRows` values to `path`, computing one zone map per chunk.
+    static bool write(const std::string &path, const int *data, size_t numRows,
+                      size_t chunkRows = kDefaultChunkRows);
+};
+
+/**
+ * MappedColumn: read-only mmap of a column file.
+ * Opening only touches the header and footer; data pages are faulted in by
+ * the scan and shared through the OS page cache.
+ */
+class MappedColumn {
+public:
+    MappedColumn() = default;
+    ~MappedColumn();
+
+    MappedColumn(const MappedColumn &) = delete;
+    MappedColumn& operator=(const MappedColumn &) = delete;
+    MappedColumn(MappedColumn &&other) noexcept;
+    MappedColumn& operator=(MappedColumn &&other) noexcept;
+
+    bool open(const std::string &path);
+    void close();
+
+    const int* data() const { return data_; }
+    size_t size() const { return numRows_; }
+    size_t chunkRows() const { return chunkRows_; }
+    const std::vector<ZoneMap>& zoneMaps() const { return zoneMaps_; }
+
+private:
+    void *base_ = nullptr;
+    size_t mappedBytes_ = 0;
+    const int *data_ = nullptr;
+    size_t numRows_ = 0;
+    size_t chunkRows_ = 0;
+    std::vector<ZoneMap> zoneMaps_;
+};
+
+#endif // COLUMN_FILE_HPP
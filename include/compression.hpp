@@ -0,0 +1,65 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Stored with every value so readers know how to decode it
+enum class Codec : uint8_t {
+    None = 0,
+    LZ = 1,      // lzCompress without a dictionary
+    LZDict = 2,  // lzCompress against the map's CompressionDictionary
+};
+
+/**
+ * CompressionDictionary: bytes that LZ matches may reference as if they
+ * preceded every value. Small values that share field names and common
+ * fragments (JSON records, for instance) compress well against it even when
+ * they are too short to repeat anything themselves.
+ *
+ * train() builds one from sample values: it scores fixed-size segments of
+ * the samples by how often their 8-byte substrings recur across all samples,
+ * and keeps the best distinct segments, the most useful ones last.
+ */
+class CompressionDictionary {
+public:
+    // Matches encode 16-bit offsets, so only the last 64 KiB can be used
+    static constexpr size_t kMaxBytes = 32 * 1024;
+
+    explicit CompressionDictionary(std::string bytes);
+
+    static std::shared_ptr<const CompressionDictionary> train(
+        const std::vector<std::string> &samples, size_t maxBytes = 16 * 1024);
+
+    const std::string& bytes() const { return bytes_; }
+    // FNV-1a of bytes(); lets a peer check it holds the same dictionary
+    uint64_t id() const { return id_; }
+
+private:
+    friend bool lzCompress(const std::string &, std::string &, const CompressionDictionary *);
+
+    std::string bytes_;
+    uint64_t id_;
+    // Hash of 4 bytes -> last position + 1 in bytes_ (0 = empty)
+    std::vector<uint32_t> table_;
+};
+
+/**
+ * LZ77 block codec in the LZ4 mould: a varint of the decoded size, then
+ * sequences of (token, literals, 16-bit offset, match length) with a greedy
+ * hash-table match finder. Fast to decode, and byte-oriented, so it suits
+ * short values.
+ *
+ * lzCompress returns false, leaving out unspecified, if the encoding would
+ * not be smaller than the input. lzDecompress returns false on malformed
+ * input or if the value needs a dictionary that was not supplied.
+ */
+bool lzCompress(const std::string &in, std::string &out,
+                const CompressionDictionary *dict = nullptr);
+bool lzDecompress(const char *data, size_t len, std::string &out,
+                  const CompressionDictionary *dict = nullptr);
+
+#endif // COMPRESSION_HPP
@@ -2,16 +2,23 @@
 #define CONCURRENCY_HPP
 
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <array>
 #include <thread>
 #include <mutex>
 #include <list>
+#include <memory>
 #include <functional>
 #include <future>
+#include <chrono>
 #include <condition_variable>
 #include <stdexcept>
 #include <iostream>
 #include <type_traits>  // <-- for std::invoke_result_t
+#include <vector>
+
+#include "metrics.hpp"
 
 /**
  * Macro to handle fatal errors
@@ -72,15 +79,97 @@ private:
     std::atomic<size_t> tail_;
 };
 
+/**
+ * BoundedMpmcQueue: fixed-capacity lock-free queue for any number of
+ * producers and consumers (Vyukov). Each cell carries a sequence number that
+ * tells a producer or consumer whether it is its turn, so neither side ever
+ * waits: tryPush fails when full, tryPop when empty.
+ */
+template <typename T>
+class BoundedMpmcQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit BoundedMpmcQueue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        mask_ = n - 1;
+        cells_.reset(new Cell[n]);
+        for (size_t i = 0; i < n; ++i) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(T item) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells_[pos & mask_];
+            const size_t seq = cell.seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = std::move(item);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &item) {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells_[pos & mask_];
+            const size_t seq = cell.seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    item = std::move(cell.data);
+                    cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    // Separate cache lines so producers and consumers do not false-share
+    alignas(64) std::atomic<size_t> enqueuePos_{0};
+    alignas(64) std::atomic<size_t> dequeuePos_{0};
+};
+
 /**
  * ThreadPool: Thread pool with a queue of tasks for concurrency.
  * Using std::invoke_result_t to avoid deprecated std::result_of.
+ * With a queueWait histogram, records how long each task waited between
+ * enqueue and the start of its execution.
  */
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t numThreads);
+    explicit ThreadPool(size_t numThreads, LatencyHistogram *queueWait = nullptr);
     ~ThreadPool();
 
+    // Tasks queued but not yet picked up by a worker
+    size_t pending() const;
+
     template <class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::invoke_result_t<F, Args...>>
@@ -97,7 +186,16 @@ public:
             if (stop_) {
                 throw std::runtime_error("enqueue on stopped ThreadPool");
             }
-            tasks_.emplace_back([taskPtr]() { (*taskPtr)(); });
+            if (queueWait_ != nullptr) {
+                const auto queued = std::chrono::steady_clock::now();
+                tasks_.emplace_back([taskPtr, queued, wait = queueWait_]() {
+                    wait->record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - queued).count()));
+                    (*taskPtr)();
+                });
+            } else {
+                tasks_.emplace_back([taskPtr]() { (*taskPtr)(); });
+            }
         }
         condition_.notify_one();
         return res;
@@ -106,9 +204,89 @@ public:
 private:
     std::vector<std::thread> workers_;
     std::list<std::function<void()>> tasks_;
-    std::mutex queueMutex_;
+    mutable std::mutex queueMutex_;
     std::condition_variable condition_;
     bool stop_;
+    LatencyHistogram *queueWait_;
+};
+
+/**
+ * EpochManager: epoch-based memory reclamation (Fraser) for structures with
+ * lock-free readers.
+ *
+ * Readers hold a Guard while they may dereference shared nodes; a Guard
+ * announces the global epoch it started in. Objects unlinked and then
+ * retired during epoch e are freed once the epoch reaches e + 2, i.e. after
+ * every reader active at the time has left its Guard. The epoch advances
+ * only when all active readers have seen the current one, so a steady
+ * stream of short reads never holds back reclamation; only a reader stuck
+ * inside a Guard does.
+ *
+ * Threads register implicitly on their first Guard and are unregistered when
+ * they exit. Guards nest. Retiring triggers a reclaim attempt whenever more
+ * than `collectThreshold` objects are waiting.
+ */
+class EpochManager {
+public:
+    class Guard {
+    public:
+        explicit Guard(const EpochManager &epochs);
+        ~Guard();
+        Guard(const Guard &) = delete;
+        Guard& operator=(const Guard &) = delete;
+    private:
+        void *self_;
+    };
+
+    explicit EpochManager(size_t collectThreshold = 256);
+    // No Guard may be held and no thread may use it concurrently
+    ~EpochManager();
+    EpochManager(const EpochManager &) = delete;
+    EpochManager& operator=(const EpochManager &) = delete;
+
+    // p must already be unreachable for new readers
+    template <class T>
+    void retire(T *p) {
+        retire(p, [](void *q) { delete static_cast<T*>(q); });
+    }
+    void retire(void *p, void (*deleter)(void *));
+
+    // Advances the epoch if every active reader has caught up, then frees
+    // whatever is no longer reachable by any reader
+    void tryReclaim();
+    // Retired objects not freed yet
+    size_t pending() const;
+    uint64_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+
+private:
+    struct Participant {
+        // (epoch << 1) | 1 while inside a Guard, 0 outside
+        std::atomic<uint64_t> state{0};
+        std::atomic<bool> inUse{true};
+        // Guard nesting; touched only by the owning thread
+        unsigned depth = 0;
+        Participant *next = nullptr;
+    };
+    struct Retired {
+        void *ptr;
+        void (*deleter)(void *);
+    };
+
+    // This thread's record, registering it on first use
+    Participant* self() const;
+    bool tryAdvance();
+    static void release(std::vector<Retired> &batch);
+
+    const uint64_t id_;
+    const size_t threshold_;
+    std::atomic<uint64_t> epoch_{2};
+    mutable std::atomic<Participant*> participants_{nullptr};
+
+    mutable std::mutex limboMtx_;
+    // Bucket e % 3 holds objects retired in epoch limboEpoch_[e % 3]
+    std::vector<Retired> limbo_[3];
+    uint64_t limboEpoch_[3] = {0, 0, 0};
+    size_t limboCount_ = 0;
 };
 
 #endif // CONCURRENCY_HPP
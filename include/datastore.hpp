@@ -1,8 +1,10 @@
 #ifndef DATASTORE_HPP
 #define DATASTORE_HPP
 
+#include <atomic>
 #include <map>
 #include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <fstream>
@@ -11,6 +13,16 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <memory>
+
+#include "art.hpp"
+#include "compression.hpp"
+#include "column_file.hpp"
+#include "eviction.hpp"
+#include "metrics.hpp"
+#include "ordered_index.hpp"
+#include "timing_wheel.hpp"
 
 // If you want GPU, compile with -DUSE_CUDA
 #ifdef USE_CUDA
@@ -35,6 +47,8 @@ public:
     void addNode(const std::string& nodeName);
     void removeNode(const std::string& nodeName);
     std::string getNode(const std::string& key) const;
+    // Up to n distinct nodes clockwise from key; the owner comes first
+    std::vector<std::string> getNodes(const std::string& key, size_t n) const;
 private:
     std::map<size_t, std::string> ring_;
     int numReplicas_;
@@ -42,57 +56,460 @@ private:
 
 /**
  * ConcurrentHashMap
+ * Keys are spread over independently locked shards. Two storage engines:
+ *  - Hash: one unordered_map per shard, optionally with an OrderedKeyIndex
+ *    beside it for range scans (touched only when a key is created/removed).
+ *  - ART:  one AdaptiveRadixTree holds every entry, ordered and
+ *    prefix-compressed; shard locks serialize writers per key and guard the
+ *    entry contents.
+ * Entries may carry an absolute expiry. Reads treat expired entries as
+ * absent; expire() removes them using a per-shard TimingWheel.
+ * With maxMemoryBytes set, each shard keeps an equal share of the budget and
+ * evicts through its own EvictionPolicy, so no lock spans shards.
  */
 class ConcurrentHashMap {
 public:
-    void put(const std::string &key, const std::string &value);
+    enum class Engine { Hash, ART };
+
+    struct Options {
+        Engine engine = Engine::Hash;
+        // Hash engine only; the ART engine is always ordered
+        bool orderedIndex = false;
+        size_t numShards = 16;
+        // Approximate bytes of keys + values + per-entry overhead; 0 = unbounded
+        size_t maxMemoryBytes = 0;
+        EvictionKind eviction = EvictionKind::SampledLRU;
+        // Custom per-shard policy; overrides `eviction` when set
+        std::function<std::unique_ptr<EvictionPolicy>()> evictionFactory;
+        // Values at least this long are stored LZ-compressed when that makes
+        // them smaller; 0 = off
+        size_t compressMinBytes = 0;
+        // Shared dictionary for compression (CompressionDictionary::train)
+        std::shared_ptr<const CompressionDictionary> compressionDictionary;
+        // Per-operation counters (kv_ops_total{op=...}, kv_get_misses_total,
+        // kv_conflicts_total, kv_expired_total) are registered here when set;
+        // must outlive the map
+        MetricsRegistry *metrics = nullptr;
+        // Called for every key that expire() or eviction removes, under the
+        // key's shard lock (like the write hooks below); must not block or
+        // call back into the map
+        std::function<void(const std::string &key)> onErase;
+    };
+
+    ConcurrentHashMap();
+    explicit ConcurrentHashMap(const Options &opts);
+
+    /**
+     * Write hooks run under the key's shard lock, right after the write is
+     * applied, so a WAL record or replica forward issued from one is ordered
+     * with every other hooked write to that key.
+     */
+    using WriteHook = std::function<void(const std::string &key, const std::string &value,
+                                         uint64_t expireAtMs)>;
+    using RemoveHook = std::function<void(const std::string &key)>;
+
+    // expireAtMs: wall-clock ms since the epoch (see nowMs()), 0 = never.
+    // Overwriting a key replaces its expiry; an already past expiry removes it,
+    // and then onRemove runs instead of onWrite.
+    void put(const std::string &key, const std::string &value, uint64_t expireAtMs = 0,
+             const WriteHook &onWrite = nullptr, const RemoveHook &onRemove = nullptr);
     bool get(const std::string &key, std::string &outVal) const;
-    bool remove(const std::string &key);
+    // onRemove runs whether or not the key was present
+    bool remove(const std::string &key, const RemoveHook &onRemove = nullptr);
+    // The value as stored, compressed or not, for callers that can decode
+    // it themselves (see lzDecompress and compressionDictionary())
+    bool getStored(const std::string &key, std::string &bytes, Codec &codec) const;
+    const CompressionDictionary* compressionDictionary() const {
+        return opts_.compressionDictionary.get();
+    }
+
+    /**
+     * Atomic read-modify-write operations, each run under the key's shard
+     * lock. They keep the key's current expiry. onWrite is called under the
+     * same lock with the stored result.
+     */
+    // version changes on every write to the key (never reused while running)
+    bool get(const std::string &key, std::string &outVal, uint64_t &version) const;
+    // Stores value only if the key is still at expectedVersion (0 = absent)
+    bool compareAndSwap(const std::string &key, uint64_t expectedVersion,
+                        const std::string &value, uint64_t &newVersion,
+                        const WriteHook &onWrite = nullptr);
+    // Adds delta to a base-10 int64 value (missing = 0); false, leaving the
+    // value unchanged, if it is not an integer or the result would overflow
+    bool increment(const std::string &key, int64_t delta, int64_t &result,
+                   const WriteHook &onWrite = nullptr);
+    // Appends to the value (missing = ""); returns the new length
+    size_t append(const std::string &key, const std::string &suffix,
+                  const WriteHook &onWrite = nullptr);
+
+    /**
+     * Optimistic multi-key commit: locks every involved shard (in index
+     * order), checks that each read key is still at the version it was read
+     * at (0 = absent), then applies all writes before unlocking. onCommit
+     * runs under those locks with the applied writes (skipped when there are
+     * none); a write whose expiry has already passed is applied, and passed
+     * to onCommit, as a remove. Returns false, with
+     * nothing applied, if any read was invalidated.
+     */
+    struct BatchWrite {
+        std::string key;
+        std::string value;
+        uint64_t expireAtMs = 0;
+        bool remove = false;
+    };
+    using ReadSet = std::vector<std::pair<std::string, uint64_t>>;
+    using CommitHook = std::function<void(const std::vector<BatchWrite> &writes)>;
+    bool commitBatch(const ReadSet &reads, const std::vector<BatchWrite> &writes,
+                     const CommitHook &onCommit = nullptr);
+
+    /**
+     * Snapshot: consistent read-only view of the map as of the moment it was
+     * taken. Writers never wait for it. While any snapshot is open, they keep
+     * the versions they supersede (and leave tombstones for removed keys), and
+     * collectVersions() frees them once no open snapshot can read them.
+     * Evicted keys disappear from snapshots too.
+     */
+    class Snapshot {
+    public:
+        ~Snapshot();
+        Snapshot(const Snapshot &) = delete;
+        Snapshot& operator=(const Snapshot &) = delete;
+
+        bool get(const std::string &key, std::string &outVal) const;
+        // Same contract as ConcurrentHashMap::scan
+        bool scan(const std::string &start, const std::string &end, size_t limit,
+                  std::vector<std::pair<std::string, std::string>> &out,
+                  std::string &nextCursor) const;
+        // Every visible entry; in key order if the map is ordered. Unordered
+        // maps are copied one shard at a time under that shard's lock.
+        void forEach(const std::function<void(const std::string &key,
+                                              const std::string &value)> &fn) const;
+        uint64_t version() const { return version_; }
+
+    private:
+        friend class ConcurrentHashMap;
+        Snapshot(const ConcurrentHashMap &map, uint64_t version, uint64_t wallMs)
+            : map_(map), version_(version), wallMs_(wallMs) {}
+
+        const ConcurrentHashMap &map_;
+        uint64_t version_;
+        uint64_t wallMs_;
+    };
+    std::unique_ptr<Snapshot> snapshot() const;
+    // Frees superseded versions and tombstones that no open snapshot can
+    // read; returns how many. Owners call this periodically.
+    size_t collectVersions();
+    // Superseded versions currently kept for snapshots
+    size_t retainedVersions() const;
+
+    // Includes expired entries that expire() has not removed yet
+    size_t size() const;
+    // Bytes charged against maxMemoryBytes
+    size_t memoryUsage() const;
+    size_t evictions() const;
+
+    // Removes every entry whose expiry has passed and returns how many. Shards
+    // are processed one at a time in small batches, so readers never stall.
+    size_t expire();
+
+    static uint64_t nowMs();
+    Engine engine() const { return opts_.engine; }
+
+    /**
+     * Cursor-paginated range scan over [start, end) (empty end = unbounded).
+     * Appends up to `limit` entries to `out` and sets `nextCursor` to the key
+     * to resume from, or "" when the range is exhausted. No lock is held
+     * across the scan; keys removed concurrently are skipped.
+     * Returns false if the map has no ordering (Hash without orderedIndex).
+     */
+    bool scan(const std::string &start, const std::string &end, size_t limit,
+              std::vector<std::pair<std::string, std::string>> &out,
+              std::string &nextCursor) const;
+
+    // Smallest key greater than every key starting with prefix ("" if none)
+    static std::string prefixEnd(const std::string &prefix);
+
 private:
-    mutable std::mutex mtx_;
-    std::unordered_map<std::string, std::string> kvStore_;
+    // A superseded version, newest first, kept while a snapshot may read it
+    struct Version {
+        std::string value;
+        Codec codec = Codec::None;
+        uint64_t expireAtMs = 0;
+        uint64_t version = 0;
+        // Version of the write that replaced or removed this one
+        uint64_t supersededAt = 0;
+        bool deleted = false;
+        std::unique_ptr<Version> older;
+
+        // Unlinks iteratively so long chains cannot overflow the stack
+        ~Version() {
+            std::unique_ptr<Version> next = std::move(older);
+            while (next) {
+                next = std::move(next->older);
+            }
+        }
+    };
+    struct Entry {
+        std::string value;
+        // Global commit order of the last write (see clock_)
+        uint64_t version = 0;
+        EvictionMeta meta;
+        // Tombstone: removed while a snapshot was open; invisible to reads
+        bool deleted = false;
+        // In the shard's versioned list, awaiting collectVersions()
+        bool listed = false;
+        // How value is encoded; reads decode it
+        Codec codec = Codec::None;
+        std::unique_ptr<Version> history;
+        // Pending expiry in the shard's wheel, and the only copy of the
+        // deadline; null for keys without a TTL and for tombstones. Linking
+        // entries into the wheel directly would put the links, slot and
+        // deadline (32 bytes) in every entry; a separate 48-byte timer behind
+        // this pointer costs less until over half the keys carry a TTL.
+        TimingWheel::Timer *timer = nullptr;
+
+        uint64_t expireAtMs() const { return timer == nullptr ? 0 : timer->expireAtMs; }
+        bool expired(uint64_t now) const { return timer != nullptr && timer->expireAtMs <= now; }
+    };
+    struct ArtEntry : ArtLeaf {
+        ArtEntry(const std::string &k, Entry e) : ArtLeaf(k), entry(std::move(e)) {}
+        Entry entry;
+    };
+    struct Shard {
+        mutable std::mutex mtx;
+        std::unordered_map<std::string, Entry> map;
+        TimingWheel wheel;
+        size_t bytes = 0;
+        size_t evictions = 0;
+        size_t tombstones = 0;
+        size_t retained = 0;
+        // Keys with history or a tombstone
+        std::vector<std::string> versioned;
+        // Only with a memory cap
+        std::unique_ptr<EvictionPolicy> policy;
+        std::vector<Resident> residents;
+    };
+
+    // Hash node / ART leaf and allocator overhead charged per entry
+    static constexpr size_t kEntryOverhead = 64;
+    static size_t entryBytes(const std::string &key, const Entry &entry);
+
+    size_t shardIndex(const std::string &key) const;
+    Shard& shardFor(const std::string &key) const;
+    // Callers hold the key's shard lock
+    // storedKey, if given, receives the map's own copy of the key
+    Entry* findEntry(Shard &shard, const std::string &key,
+                     const std::string **storedKey = nullptr) const;
+    Entry& upsertEntry(Shard &shard, const std::string &key, bool &created,
+                       const std::string **storedKey = nullptr);
+    // Keeps the entry's single wheel timer in step with expireAtMs
+    void setExpiry(Shard &shard, const std::string &storedKey, Entry &entry, uint64_t expireAtMs);
+    // nullptr if absent or already expired
+    Entry* liveEntry(Shard &shard, const std::string &key) const;
+    // A value in stored form. Writers encode before taking the shard lock
+    // where they can, and readers decode after releasing it.
+    struct StoredValue {
+        std::string bytes;
+        Codec codec = Codec::None;
+    };
+    StoredValue encode(const std::string &value) const;
+    void decode(const std::string &bytes, Codec codec, std::string &out) const;
+    // Stores value at the given version, then enforces the memory cap
+    Entry& storeEntry(Shard &shard, const std::string &key, StoredValue value,
+                      uint64_t expireAtMs, uint64_t version);
+    // version 0 erases outright; otherwise an open snapshot may turn the
+    // entry into a tombstone written at that version. Cancels the entry's
+    // timer, fired or not.
+    bool eraseEntry(Shard &shard, const std::string &key, uint64_t version);
+    // Called under the shard lock, before the clock is read by the write
+    uint64_t nextVersion() { return clock_.fetch_add(1) + 1; }
+    // Before entry is overwritten or removed at `version`: moves its current
+    // state into history if an open snapshot can read it, and drops history
+    // no snapshot can read any more
+    void preserve(Shard &shard, const std::string &key, Entry &entry, uint64_t version);
+    // Frees history superseded at or before `oldest`; returns how many
+    static size_t trimHistory(Entry &entry, uint64_t oldest);
+    // Snapshot read of one entry at `version`, as of wall time wallMs
+    bool visibleAt(const Entry &entry, uint64_t version, uint64_t wallMs,
+                   std::string &outVal) const;
+    using ReadFn = std::function<bool(const std::string &key, std::string &value)>;
+    bool scanWith(const std::string &start, const std::string &end, size_t limit,
+                  std::vector<std::pair<std::string, std::string>> &out,
+                  std::string &nextCursor, const ReadFn &read) const;
+    // Open snapshot versions; false if none is registered yet
+    bool snapshotBounds(uint64_t &oldest, uint64_t &newest) const;
+    void closeSnapshot(uint64_t version) const;
+    void track(Shard &shard, const std::string &storedKey, Entry &entry);
+    void untrack(Shard &shard, const std::string &storedKey, Entry &entry);
+    void evictIfOverBudget(Shard &shard, Entry &justWritten);
+
+    // Null without Options::metrics
+    struct OpCounters {
+        Counter *gets = nullptr;
+        Counter *getMisses = nullptr;
+        Counter *puts = nullptr;
+        Counter *removes = nullptr;
+        Counter *cas = nullptr;
+        Counter *increments = nullptr;
+        Counter *appends = nullptr;
+        Counter *commits = nullptr;
+        Counter *conflicts = nullptr;
+        Counter *expired = nullptr;
+    };
+    static void bump(Counter *counter) {
+        if (counter != nullptr) {
+            counter->add();
+        }
+    }
+
+    Options opts_;
+    OpCounters counters_;
+    std::unique_ptr<Shard[]> shards_;
+    size_t shardBudget_;
+    std::unique_ptr<AdaptiveRadixTree> art_;
+    std::unique_ptr<OrderedKeyIndex> index_;
+
+    // Last assigned version; bumped under the written key's shard lock
+    std::atomic<uint64_t> clock_{0};
+    // Counted before a snapshot reads clock_, so a writer that misses the
+    // count wrote at a version the snapshot already covers
+    mutable std::atomic<size_t> openSnapshots_{0};
+    mutable std::mutex snapshotMtx_;
+    mutable std::multiset<uint64_t> snapshotVersions_;
 };
 
+class ChangeFeed;
+
 /**
  * Write-Ahead Log (WAL)
+ * Every PUT/PUTEX/PUTBLOB/REMOVE record, including each write inside a TXN batch,
+ * has a sequence number: its 1-based ordinal in the file. replay() restores
+ * the counter, so sequence numbers stay stable across restarts.
  */
 class WriteAheadLog {
 public:
-    explicit WriteAheadLog(const std::string &filename);
+    // With metrics set, counts records (wal_records_total) and times each
+    // flush to the OS (wal_flush_seconds)
+    explicit WriteAheadLog(const std::string &filename, MetricsRegistry *metrics = nullptr);
     ~WriteAheadLog();
 
-    void logPut(const std::string &key, const std::string &value);
+    // A non-zero expireAtMs is logged as "PUTEX key expireAtMs value". Values
+    // that are empty or contain whitespace (binary blobs) are logged as
+    // "PUTBLOB key expireAtMs len" followed by the raw bytes.
+    void logPut(const std::string &key, const std::string &value, uint64_t expireAtMs = 0);
     void logRemove(const std::string &key);
+    // One "TXN n" record: n PUT/PUTEX/PUTBLOB/REMOVE records then "COMMIT", written
+    // with a single flush. Replay skips a batch whose COMMIT is missing.
+    void logBatch(const std::vector<ConcurrentHashMap::BatchWrite> &writes);
     void replay(ConcurrentHashMap &store);
 
+    // Records written or replayed from now on are also appended to feed, in
+    // log order. Attach before replay() to retain the log's tail.
+    void attachFeed(ChangeFeed *feed);
+    uint64_t lastSequence() const;
+
 private:
-    std::mutex mtx_;
+    // Caller holds mtx_ (or is replaying)
+    void publish(const std::vector<ConcurrentHashMap::BatchWrite> &writes);
+    // Caller holds mtx_; flushes the stream after writing `records` records
+    void flush(size_t records);
+
+    mutable std::mutex mtx_;
     std::ofstream walStream_;
     std::string filename_;
+    uint64_t seq_ = 0;
+    ChangeFeed *feed_ = nullptr;
+    Counter *records_ = nullptr;
+    LatencyHistogram *flushLatency_ = nullptr;
 };
 
 /**
- * ColumnarTable for analytics
+ * SortedColumnIndex: value-ordered permutation of one column.
+ * A large sorted main run plus a small sorted delta run absorb appends;
+ * the delta is merged into the main run once it outgrows max(1024, sqrt(n)),
+ * so appends stay cheap and range counts are two binary searches per run.
+ */
+class SortedColumnIndex {
+public:
+    void build(const int *data, size_t size);
+    void append(int value, size_t row);
+
+    size_t size() const { return values_.size() + deltaValues_.size(); }
+    // Rows with lo <= value < hi
+    size_t countInRange(int lo, int hi) const;
+    size_t countLessThan(int value) const;
+    // Matching row ids in ascending row order
+    std::vector<size_t> rowsInRange(int lo, int hi) const;
+
+private:
+    void mergeDelta();
+
+    std::vector<int> values_;
+    std::vector<size_t> rows_;
+    std::vector<int> deltaValues_;
+    std::vector<size_t> deltaRows_;
+};
+
+/**
+ * ColumnarTable for analytics.
+ * Columns live either in memory or in read-only memory-mapped column files
+ * (see column_file.hpp); both are scanned with the same kernel.
  */
 class ColumnarTable {
 public:
+    // Throws std::logic_error on a memory-mapped table (files are immutable)
     void addRow(const std::vector<int> &row);
     size_t filterLessThan(size_t colIndex, int value) const;
+    // In-memory columns only; throws std::out_of_range on a mapped table
     const std::vector<int>& getColumn(size_t colIndex) const;
+    // Raw cells for either storage mode; nullptr if colIndex is out of range
+    const int* columnData(size_t colIndex) const;
 
     // Optional: get total number of rows
     size_t getNumRows() const;
+    size_t getNumColumns() const;
+
+    // Persist each column to <dir>/col_<i>.dcol
+    bool saveColumns(const std::string &dir,
+                     size_t chunkRows = ColumnFile::kDefaultChunkRows) const;
+    // Replace the contents with the column files found in dir, mapped read-only
+    bool openMapped(const std::string &dir);
+    bool isMapped() const;
+
+    // Optional sorted index per column, kept up to date by addRow();
+    // filterLessThan and the range helpers below use it when present
+    bool createIndex(size_t colIndex);
+    void dropIndex(size_t colIndex);
+    bool hasIndex(size_t colIndex) const;
+    // Rows with lo <= value < hi (index lookup, or a scan without one)
+    size_t countInRange(size_t colIndex, int lo, int hi) const;
+    std::vector<size_t> rowsInRange(size_t colIndex, int lo, int hi) const;
+
+    // Scan kernel shared by in-memory, mapped and CPU-fallback paths
+    static size_t countLessThan(const int *data, size_t size, int value);
 
 private:
+    size_t columnSize(size_t colIndex) const;
+
     std::vector<std::vector<int>> columns_;
+    std::vector<MappedColumn> mapped_;
+    std::vector<std::unique_ptr<SortedColumnIndex>> indexes_;
 };
 
+class AnalyticsAccelerator;
+
 /**
- * GPUAcceleratedAnalytics (stub)
+ * GPUAcceleratedAnalytics: routes scans to the best available engine
+ * (see accelerator.hpp) - CUDA when compiled in and a device is present,
+ * otherwise the multi-threaded SIMD CPU backend.
  */
 class GPUAcceleratedAnalytics {
 public:
     static size_t filterLessThanGPU(const std::vector<int> &col, int value);
+
+    static std::shared_ptr<AnalyticsAccelerator> accelerator();
+    // Override the engine (e.g. a custom backend); nullptr restores the default
+    static void setAccelerator(std::shared_ptr<AnalyticsAccelerator> accel);
 };
 
 #endif // DATASTORE_HPP
@@ -9,36 +9,170 @@
 #include <cstring>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "change_capture.hpp"
+#include "change_feed.hpp"
 #include "concurrency.hpp"
 #include "datastore.hpp"
+#include "hot_keys.hpp"
+#include "metrics.hpp"
+#include "net_util.hpp"
+#include "query.hpp"
+#include "trace.hpp"
+#include "transaction.hpp"
+#include "watch.hpp"
 
 class DistributedNode {
 public:
+    // storeOptions configures the local store (compression, memory limit...)
     DistributedNode(const std::string &nodeName,
                     const std::string &walFile,
-                    int port);
+                    int port,
+                    const ConcurrentHashMap::Options &storeOptions = ConcurrentHashMap::Options());
     ~DistributedNode();
 
-    void put(const std::string &key, const std::string &value);
+    // ttlMs > 0 expires the key that many milliseconds from now
+    void put(const std::string &key, const std::string &value, uint64_t ttlMs = 0);
     bool get(const std::string &key, std::string &outVal);
     void removeKey(const std::string &key);
+
+    // Atomic operations; see ConcurrentHashMap. Each write is logged as one
+    // WAL record and queued for replicas while the key's shard lock is held.
+    bool get(const std::string &key, std::string &outVal, uint64_t &version);
+    bool compareAndSwap(const std::string &key, uint64_t expectedVersion,
+                        const std::string &value, uint64_t &newVersion);
+    bool increment(const std::string &key, int64_t delta, int64_t &result);
+    size_t append(const std::string &key, const std::string &suffix);
+
+    // Optimistic multi-key transaction on this node's store. A commit is
+    // logged as one WAL batch record, so recovery sees all of it or none.
+    // Replicas receive the writes individually (not atomically).
+    Transaction beginTransaction();
+    // Range scan page over [start, end); see ConcurrentHashMap::scan
+    bool scan(const std::string &start, const std::string &end, size_t limit,
+              std::vector<std::pair<std::string, std::string>> &out,
+              std::string &nextCursor) const;
     std::string getName() const;
+    // Consistent view for long scans and checkpoints; writers keep going
+    std::unique_ptr<ConcurrentHashMap::Snapshot> snapshot() const;
 
     // Replicate a key/value to another node
     void replicateTo(const std::string &targetHost, int targetPort,
                      const std::string &key, const std::string &value);
 
+    // Cluster membership for owner-driven replication. Writes this node
+    // owns are forwarded, in order and asynchronously, to the next
+    // replicationFactor - 1 nodes on the ring, so replicas are eventually
+    // consistent with the owner. nodes must include this node.
+    void setCluster(const std::vector<NodeAddress> &nodes, size_t replicationFactor);
+
+    // Start feeding every put() into a ColumnarTable; returns false if
+    // capture is already enabled. Removes are not reflected (append-only).
+    bool enableChangeCapture(std::vector<CaptureColumn> columns,
+                             char delimiter = ',');
+    // nullptr until enableChangeCapture() succeeds
+    ChangeCaptureStream* changeCapture() const;
+
+    // Most-read keys, most frequent first (also served as STATS HOTKEYS)
+    std::vector<HotKey> hotKeys(size_t n) const;
+    // Reads (per decay period) before a key may be leased to near-caches
+    void setHotKeyThreshold(uint64_t minCount);
+
+    // Every logged mutation by WAL sequence number (also served as CDC)
+    const ChangeFeed& changeFeed() const { return changeFeed_; }
+    // Connections currently subscribed with WATCH
+    size_t watchers() const { return watchHub_.subscribers(); }
+    // Store, WAL, pool and request metrics (also served as STATS and
+    // STATS PROMETHEUS)
+    MetricsRegistry& metrics() { return metrics_; }
+
 private:
     void runServer();
+    void runMaintenance();
     void handleClient(int clientSock);
+    void handleQuery(int clientSock, const std::string &request);
+    void handleScan(int clientSock, std::istringstream &args);
+    bool handleChangeFeed(int clientSock, std::istringstream &args);
+    void handleBlob(int clientSock, SocketReader &reader, const std::string &request);
+    void handleStats(int clientSock, std::istringstream &args);
+    // Registers gauges and per-command metrics; called once by the constructor
+    void registerMetrics();
+    void handleAtomic(int clientSock, const std::string &cmd, std::istringstream &args);
+
+    // Near-cache invalidation: hot keys read with "GET key TRACKED" are
+    // "leased"; the next write to a leased key notifies every tracker
+    bool leaseIfHot(const std::string &key);
+    void invalidate(const std::string &key);
+    // Queues msg for the key's other replicas if this node owns the key
+    void forwardToReplicas(const std::string &key, const std::string &msg);
+    // Hooks for every map write: WAL record, replica forward and publish,
+    // issued under the key's shard lock so all of them follow the map's
+    // order of writes to a key
+    ConcurrentHashMap::WriteHook writeHook();
+    ConcurrentHashMap::RemoveHook removeHook();
+    // Near-cache invalidation, change capture and WATCH pushes for a stored
+    // write or removal; never block, as they run under shard locks
+    void publishWrite(const std::string &key, const std::string &value);
+    void publishRemove(const std::string &key);
 
     std::string nodeName_;
+    // Declared before everything it instruments, including the pools whose
+    // tasks record into it
+    MetricsRegistry metrics_;
+    // node_requests_total and node_request_seconds per command; read-only
+    // after construction, unknown commands count as "other"
+    struct CommandMetrics {
+        const char *name;  // also the command's trace event name
+        Counter *requests;
+        LatencyHistogram *latency;
+    };
+    std::unordered_map<std::string, CommandMetrics> commandMetrics_;
+    const CommandMetrics& commandMetrics(const std::string &cmd) const;
+    LatencyHistogram *replicationLag_;
+    Counter *replicationFailures_;
     ConcurrentHashMap dataStore_;
+    // Fed by wal_ in log order; owns CDC consumer sockets
+    ChangeFeed changeFeed_;
     WriteAheadLog wal_;
     int port_;
+    int serverSock_;
     std::atomic<bool> stop_;
     std::thread serverThread_;
+    // Expires keys, frees snapshot versions and ages hot-key counts
+    std::thread maintenanceThread_;
+
+    // Workers for analytics scans issued over the wire
+    ThreadPool queryPool_;
+
+    std::unique_ptr<ChangeCaptureStream> captureOwner_;
+    std::atomic<ChangeCaptureStream*> capture_;
+    std::mutex captureMtx_;
+
+    HotKeyTracker hotKeys_;
+    std::atomic<uint64_t> hotKeyThreshold_;
+    std::mutex trackingMtx_;
+    std::vector<int> trackers_;
+    std::unordered_set<std::string> leasedKeys_;
+
+    // WATCH subscribers; owns their sockets
+    WatchHub watchHub_;
+
+    std::mutex clusterMtx_;
+    ConsistentHashRing ring_;
+    std::unordered_map<std::string, NodeAddress> peers_;
+    size_t replicationFactor_;
+    // Single worker so replicas apply writes in the owner's order; declared
+    // after the state above so queued forwards drain before it is destroyed
+    ThreadPool replicationPool_;
+    // PUTBLOB/GETBLOB transfers; declared after replicationPool_, which
+    // they write through
+    ThreadPool transferPool_;
+    // Streams QUERY replies; declared last because they scan on queryPool_
+    ThreadPool queryReplyPool_;
 
     // Helper to forcibly unblock accept()
     void forceDisconnect();
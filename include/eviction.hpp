@@ -0,0 +1,120 @@
+#ifndef EVICTION_HPP
+#define EVICTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * EvictionMeta: per-entry bookkeeping shared by all eviction policies
+ * (12 bytes, stored inline in the map entry).
+ */
+struct EvictionMeta {
+    // Position in the shard's resident table (maintained by the map)
+    uint32_t slot = 0;
+    // Logical access time or insert sequence, policy-defined
+    uint32_t stamp = 0;
+    // Policy-defined bits (CLOCK reference bit, TinyLFU window flag)
+    uint32_t flags = 0;
+};
+
+/** Resident: one evictable entry as seen by a policy. */
+struct Resident {
+    const std::string *key;
+    EvictionMeta *meta;
+};
+
+enum class EvictionKind { SampledLRU, Clock, TinyLFU };
+
+/**
+ * EvictionPolicy: chooses victims for one ConcurrentHashMap shard.
+ * Every call happens under that shard's lock, so policies need no locking of
+ * their own and reads never touch a map-wide structure.
+ */
+class EvictionPolicy {
+public:
+    virtual ~EvictionPolicy() = default;
+
+    virtual void onInsert(const std::string &key, EvictionMeta &meta) = 0;
+    virtual void onAccess(const std::string &key, EvictionMeta &meta) = 0;
+    virtual void onRemove(EvictionMeta &) {}
+    // Index into `residents` (non-empty) of the entry to evict
+    virtual size_t selectVictim(const std::vector<Resident> &residents) = 0;
+
+    // expectedEntries sizes the TinyLFU frequency sketch
+    static std::unique_ptr<EvictionPolicy> create(EvictionKind kind, size_t expectedEntries);
+};
+
+/** SampledLRU: evicts the least recently used of a few random residents. */
+class SampledLruPolicy : public EvictionPolicy {
+public:
+    explicit SampledLruPolicy(size_t samples = 5);
+
+    void onInsert(const std::string &key, EvictionMeta &meta) override;
+    void onAccess(const std::string &key, EvictionMeta &meta) override;
+    size_t selectVictim(const std::vector<Resident> &residents) override;
+
+protected:
+    size_t sample(size_t n) { return rng_() % n; }
+
+    size_t samples_;
+    uint32_t clock_;
+    std::minstd_rand rng_;
+};
+
+/** ClockPolicy: second-chance sweep over the resident table. */
+class ClockPolicy : public EvictionPolicy {
+public:
+    void onInsert(const std::string &key, EvictionMeta &meta) override;
+    void onAccess(const std::string &key, EvictionMeta &meta) override;
+    size_t selectVictim(const std::vector<Resident> &residents) override;
+
+private:
+    size_t hand_ = 0;
+};
+
+/**
+ * FrequencySketch: count-min sketch of 4-bit counters (4 rows, 16 counters
+ * per 64-bit word) with periodic halving, so old popularity fades.
+ */
+class FrequencySketch {
+public:
+    explicit FrequencySketch(size_t expectedEntries);
+    void increment(const std::string &key);
+    uint32_t estimate(const std::string &key) const;
+
+private:
+    uint32_t counter(size_t row, uint64_t hash) const;
+    size_t index(size_t row, uint64_t hash) const;
+    void halve();
+
+    std::vector<uint64_t> table_;
+    size_t mask_;
+    size_t additions_;
+    size_t resetAt_;
+};
+
+/**
+ * TinyLfuPolicy: sampled W-TinyLFU. New keys enter an admission window (~1%
+ * of residents, by insert sequence) and are never evicted while in it. A
+ * sampled key that has left the window must beat the sampled LRU victim of
+ * the main region on estimated frequency to be admitted; otherwise it is
+ * the one evicted. This keeps one-hit wonders from flushing popular keys.
+ */
+class TinyLfuPolicy : public SampledLruPolicy {
+public:
+    explicit TinyLfuPolicy(size_t expectedEntries);
+
+    void onInsert(const std::string &key, EvictionMeta &meta) override;
+    void onAccess(const std::string &key, EvictionMeta &meta) override;
+    size_t selectVictim(const std::vector<Resident> &residents) override;
+
+private:
+    FrequencySketch sketch_;
+    uint32_t inserts_;
+};
+
+#endif // EVICTION_HPP
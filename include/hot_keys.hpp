@@ -0,0 +1,47 @@
+#ifndef HOT_KEYS_HPP
+#define HOT_KEYS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct HotKey {
+    std::string key;
+    uint64_t count;
+    // count overestimates the true frequency by at most this much
+    uint64_t error;
+};
+
+/**
+ * HotKeyTracker: streaming top-K of accessed keys (Space-Saving, Metwally et
+ * al.) in O(K) memory. Counters sit in a min-heap, so an unseen key replaces
+ * the least-counted one in O(log K). decay() halves all counts so the view
+ * follows shifting load. record() only try-locks: under contention a sample
+ * is dropped rather than making a read wait.
+ */
+class HotKeyTracker {
+public:
+    explicit HotKeyTracker(size_t capacity = 128);
+
+    void record(const std::string &key);
+    // Tracked and counted at least minCount (after decays)
+    bool isHot(const std::string &key, uint64_t minCount) const;
+    // Up to n keys, most frequent first
+    std::vector<HotKey> top(size_t n) const;
+    void decay();
+
+private:
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+    void swapSlots(size_t a, size_t b);
+
+    size_t capacity_;
+    mutable std::mutex mtx_;
+    std::vector<HotKey> heap_;
+    std::unordered_map<std::string, size_t> pos_;
+};
+
+#endif // HOT_KEYS_HPP
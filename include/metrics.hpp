@@ -0,0 +1,159 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace metrics_detail {
+
+// Counters and histograms keep one slot per stripe. Threads take stripes
+// round robin on first use, so up to kStripes threads update without ever
+// sharing a cache line; more threads share stripes but stay correct.
+constexpr size_t kStripes = 8;
+
+inline size_t threadStripe() {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t stripe = next.fetch_add(1, std::memory_order_relaxed) % kStripes;
+    return stripe;
+}
+
+} // namespace metrics_detail
+
+/**
+ * Counter: monotonically increasing total. add() is one relaxed atomic add
+ * on the calling thread's stripe; value() sums the stripes.
+ */
+class Counter {
+public:
+    void add(uint64_t n = 1) {
+        stripes_[metrics_detail::threadStripe()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Stripe, metrics_detail::kStripes> stripes_;
+};
+
+/**
+ * LatencyHistogram: log-linear histogram of durations in nanoseconds. Every
+ * power of two from 128 ns to ~137 s is split into 4 linear buckets (at most
+ * 25% relative error), plus an underflow and an overflow bucket. record() is
+ * two relaxed adds on the caller's stripe; stripes are merged when read.
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned kMinExp = 7;   // 128 ns
+    static constexpr unsigned kMaxExp = 37;  // ~137 s
+    static constexpr size_t kSubBuckets = 4;
+    static constexpr size_t kBuckets = (kMaxExp - kMinExp) * kSubBuckets + 2;
+
+    // Merged view of the stripes
+    struct Snapshot {
+        std::array<uint64_t, kBuckets> counts{};
+        uint64_t count = 0;
+        uint64_t sumNanos = 0;
+        // Upper bound of the bucket holding the p-th percentile (p in [0, 100])
+        uint64_t percentile(double p) const;
+    };
+
+    void record(uint64_t nanos) {
+        Stripe &s = stripes_[metrics_detail::threadStripe()];
+        s.counts[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+        s.sumNanos.fetch_add(nanos, std::memory_order_relaxed);
+    }
+    Snapshot snapshot() const;
+
+    static size_t bucketOf(uint64_t nanos);
+    // Largest value counted in bucket i (UINT64_MAX for the overflow bucket)
+    static uint64_t upperBound(size_t i);
+
+    /**
+     * Timer: records the time from construction to destruction. A null
+     * histogram makes it a no-op, so optional instrumentation needs no branch
+     * at the call site.
+     */
+    class Timer {
+    public:
+        explicit Timer(LatencyHistogram *histogram)
+            : histogram_(histogram),
+              start_(histogram ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+        ~Timer() {
+            if (histogram_ != nullptr) {
+                histogram_->record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start_).count()));
+            }
+        }
+        Timer(const Timer &) = delete;
+        Timer& operator=(const Timer &) = delete;
+
+    private:
+        LatencyHistogram *histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+private:
+    struct alignas(64) Stripe {
+        std::array<std::atomic<uint64_t>, kBuckets> counts{};
+        std::atomic<uint64_t> sumNanos{0};
+    };
+    std::array<Stripe, metrics_detail::kStripes> stripes_;
+};
+
+/**
+ * MetricsRegistry: named counters, gauges and latency histograms.
+ *
+ * Names follow Prometheus conventions and may carry labels, e.g.
+ * kv_ops_total{op="get"}; series sharing the name before '{' form one
+ * family. Asking for an existing name returns the same metric, so callers
+ * look metrics up once and keep the reference (references stay valid for the
+ * registry's lifetime). Callback metrics read a value the owner already
+ * keeps; the owner must outlive every read of the registry.
+ *
+ * Nothing is aggregated on update: reads (snapshot(), prometheusText()) walk
+ * the stripes.
+ */
+class MetricsRegistry {
+public:
+    Counter& counter(const std::string &name, const std::string &help);
+    LatencyHistogram& histogram(const std::string &name, const std::string &help);
+    // Monotonic value read from fn, e.g. a total the owner already counts
+    void counter(const std::string &name, const std::string &help, std::function<double()> fn);
+    // Point-in-time value read from fn, e.g. a queue depth
+    void gauge(const std::string &name, const std::string &help, std::function<double()> fn);
+
+    // One (series, value) per counter and gauge. Histograms (in seconds)
+    // contribute _count, _sum, _p50, _p90, _p99 and _p999 series.
+    std::vector<std::pair<std::string, double>> snapshot() const;
+    // Prometheus text exposition format (version 0.0.4)
+    std::string prometheusText() const;
+
+private:
+    enum class Kind { Counter, Gauge, Histogram };
+    struct Metric {
+        Kind kind;
+        std::string help;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<LatencyHistogram> histogram;
+        std::function<double()> read;
+    };
+
+    Metric& add(const std::string &name, Kind kind, const std::string &help);
+
+    mutable std::mutex mtx_;
+    std::map<std::string, Metric> metrics_;
+};
+
+#endif // METRICS_HPP
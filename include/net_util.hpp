@@ -0,0 +1,56 @@
+#ifndef NET_UTIL_HPP
+#define NET_UTIL_HPP
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Small blocking-socket helpers shared by the node server and its clients.
+ */
+
+struct NodeAddress {
+    std::string name;
+    std::string host;
+    int port;
+};
+
+// True if value can travel as the rest of a text line (no CR or LF); other
+// values need length-prefixed framing
+bool lineSafe(const std::string &value);
+// True if value can travel as one whitespace-delimited token (non-empty, no
+// whitespace), as replies with fields after the value need
+bool tokenSafe(const std::string &value);
+
+// Connect a TCP socket to host:port; returns the fd or -1
+int connectTo(const std::string &host, int port);
+
+// Loop until all bytes are written; false on error or peer close
+bool sendAll(int sock, const void *data, size_t len);
+bool sendAll(int sock, const std::string &data);
+// Header then body in gather writes (sendmsg), without joining them first
+bool sendAll(int sock, const std::string &header, const void *body, size_t len);
+
+/**
+ * SocketReader: buffered reads of newline-terminated lines and exact-length
+ * binary payloads from one socket.
+ */
+class SocketReader {
+public:
+    explicit SocketReader(int sock) : sock_(sock) {}
+
+    // Reads up to '\n' (stripped, along with a trailing '\r'). At EOF a final
+    // unterminated line is still returned. False on error, EOF or overlong line.
+    bool readLine(std::string &line, size_t maxLen = 64 * 1024);
+    // Reads exactly len bytes; large reads go straight into out
+    bool readExact(void *out, size_t len);
+
+private:
+    bool fill();
+
+    int sock_;
+    char buf_[4096];
+    size_t pos_ = 0;
+    size_t end_ = 0;
+};
+
+#endif // NET_UTIL_HPP
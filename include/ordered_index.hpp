@@ -0,0 +1,65 @@
+#ifndef ORDERED_INDEX_HPP
+#define ORDERED_INDEX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "concurrency.hpp"
+
+/**
+ * OrderedKeyIndex: skip list of keys supporting range scans.
+ *
+ * Readers never lock: writers (serialized by writeMtx_) link new nodes with
+ * release stores and unlink removed ones without touching their forward
+ * pointers, so a reader standing on a removed node can still walk on.
+ * Removed nodes are retired to an EpochManager.
+ */
+class OrderedKeyIndex {
+public:
+    OrderedKeyIndex();
+    ~OrderedKeyIndex();
+
+    OrderedKeyIndex(const OrderedKeyIndex &) = delete;
+    OrderedKeyIndex& operator=(const OrderedKeyIndex &) = delete;
+
+    // False if the key is already present / absent
+    bool insert(const std::string &key);
+    bool remove(const std::string &key);
+    bool contains(const std::string &key) const;
+
+    // Up to `limit` keys in [start, end); an empty `end` means unbounded
+    std::vector<std::string> scan(const std::string &start, const std::string &end,
+                                  size_t limit) const;
+
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+    static constexpr int kMaxHeight = 24;
+
+private:
+    struct Node {
+        std::string key;
+        int height;
+        std::unique_ptr<std::atomic<Node*>[]> next;
+
+        Node(const std::string &k, int h);
+    };
+
+    // First node with key >= target; fills preds when non-null
+    Node* findGreaterOrEqual(const std::string &target, Node **preds) const;
+    int randomHeight();
+
+    Node *head_;
+    std::atomic<int> height_;
+    std::atomic<size_t> size_;
+
+    std::mutex writeMtx_;
+    std::mt19937 rng_;
+    EpochManager epochs_;
+};
+
+#endif // ORDERED_INDEX_HPP
@@ -0,0 +1,68 @@
+#ifndef PUSH_SENDER_HPP
+#define PUSH_SENDER_HPP
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * PushSender: the sending side of connections the node pushes to after the
+ * request that opened them (WATCH, CDC).
+ *
+ * One thread polls every connection, woken through an eventfd by wake() when
+ * there is something new to send. For each connection it detects hang-ups
+ * (peers send nothing once subscribed, so readable means EOF or error), lets
+ * the owner fill() its outbox, and sends as much as the socket takes without
+ * blocking. Connections that hung up, failed, or were marked closing and have
+ * sent everything are passed to drop().
+ *
+ * Subclasses keep their own connection list and call stopSender() first in
+ * their destructor, so the thread never calls into a half-destroyed object.
+ */
+class PushSender {
+public:
+    PushSender();
+    virtual ~PushSender();
+
+    PushSender(const PushSender &) = delete;
+    PushSender& operator=(const PushSender &) = delete;
+
+protected:
+    struct Connection {
+        explicit Connection(int s) : sock(s) {}
+        virtual ~Connection() = default;
+
+        int sock;
+        std::string outbox;
+        // Drop once the outbox has been sent
+        bool closing = false;
+    };
+
+    // Starts the thread on first use; callers serialize
+    void startSender();
+    void stopSender();
+    // Callable from any thread; cheap when a wake is already pending
+    void wake();
+
+    // Sender thread: the connections to poll this round
+    virtual void collect(std::vector<Connection*> &out) = 0;
+    // Sender thread: true if conn has something to send
+    virtual bool backlog(const Connection &conn) const = 0;
+    // Sender thread: appends to conn.outbox (or sets closing)
+    virtual void fill(Connection &conn) = 0;
+    // Sender thread: forget, close and free these connections
+    virtual void drop(const std::vector<Connection*> &conns) = 0;
+
+private:
+    void run();
+    // False if the connection failed
+    static bool sendOutbox(Connection &conn);
+
+    int wakeFd_;
+    std::atomic<bool> wakePending_{false};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+#endif // PUSH_SENDER_HPP
@@ -0,0 +1,109 @@
+#ifndef QUERY_HPP
+#define QUERY_HPP
+
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "concurrency.hpp"
+#include "datastore.hpp"
+
+/**
+ * Analytics queries over named ColumnarTable columns.
+ *
+ * Wire form (one line):
+ *   QUERY <COUNT|SUM|MIN|MAX|AVG|SELECT> <column> [WHERE <col> <op> <int> [AND ...]]
+ * with op one of LT LE GT GE EQ NE.
+ *
+ * Response, after a "RESULT <AGG>\n" line (all integers little-endian):
+ *   zero or more batches: uint32 n, then n x int32   (SELECT values only)
+ *   uint32 0                                         end of batches
+ *   int64 count, int64 sum, int64 min, int64 max     partial aggregate
+ * or a single "ERROR <reason>\n" line.
+ */
+enum class QueryAgg { Count, Sum, Min, Max, Avg, Select };
+enum class CompareOp { LT, LE, GT, GE, EQ, NE };
+
+struct QueryPredicate {
+    std::string column;
+    CompareOp op;
+    int value;
+};
+
+struct AnalyticsQuery {
+    QueryAgg agg = QueryAgg::Count;
+    std::string column;
+    std::vector<QueryPredicate> where;
+
+    // Parses the full "QUERY ..." line
+    static bool parse(const std::string &line, AnalyticsQuery &out);
+    std::string toString() const;
+};
+
+/**
+ * QueryResult: mergeable partial aggregate (plus selected values for SELECT).
+ */
+struct QueryResult {
+    uint64_t count = 0;
+    int64_t sum = 0;
+    int min = INT_MAX;
+    int max = INT_MIN;
+    std::vector<int> values;
+
+    void merge(const QueryResult &other);
+    double avg() const { return count ? static_cast<double>(sum) / count : 0.0; }
+};
+
+using ColumnResolver = std::function<int(const std::string &)>;
+
+/**
+ * Runs a query against one table. Row ranges are scanned as tasks on `pool`
+ * (inline when pool is null) and merged into out; returns false on an unknown
+ * column. `onBatch`, if set, receives SELECT values range by range instead of
+ * them being collected into out.values. Only rows in [beginRow, endRow) are
+ * scanned.
+ */
+bool executeQuery(const ColumnarTable &table, const AnalyticsQuery &query,
+                  const ColumnResolver &resolve, ThreadPool *pool,
+                  QueryResult &out,
+                  const std::function<void(const std::vector<int> &)> &onBatch = nullptr,
+                  size_t beginRow = 0, size_t endRow = SIZE_MAX);
+
+// Runs f(const ColumnarTable&) with the table locked against appends
+using TableAccess = std::function<void(const std::function<void(const ColumnarTable &)> &)>;
+
+/**
+ * Node side: streams the response to `emit`: the RESULT line (or an ERROR
+ * line), the SELECT batches, then the partial aggregate. The rows present
+ * when the query starts are scanned a window at a time, each window under
+ * one withTable call; its encoded batches are emitted after that call
+ * returns, so a slow reader never holds the table lock. Once emit returns
+ * false nothing more is scanned or emitted.
+ */
+void queryResponse(const TableAccess &withTable, const AnalyticsQuery &query,
+                   const ColumnResolver &resolve, ThreadPool *pool,
+                   const std::function<bool(const std::string &)> &emit);
+
+/**
+ * QueryCoordinator: scatter-gather over a set of nodes. The query is sent to
+ * every node in parallel and partial aggregates are merged.
+ */
+class QueryCoordinator {
+public:
+    explicit QueryCoordinator(std::vector<std::pair<std::string, int>> nodes);
+
+    // False if any node failed; `out` still holds what did arrive
+    bool execute(const AnalyticsQuery &query, QueryResult &out) const;
+
+    // Single-node request over the wire
+    static bool queryNode(const std::string &host, int port,
+                          const AnalyticsQuery &query, QueryResult &out);
+
+private:
+    std::vector<std::pair<std::string, int>> nodes_;
+};
+
+#endif // QUERY_HPP
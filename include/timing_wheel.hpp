@@ -0,0 +1,82 @@
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/**
+ * TimingWheel: hierarchical timing wheel of key expiries at 1 ms resolution.
+ *
+ * Four levels of 256 slots cover 2^32 ms (~49 days); later deadlines park in
+ * the top level and are re-placed when it comes around. Scheduling,
+ * rescheduling and cancelling are O(1), and each timer is moved at most once
+ * per level before it fires, so expiring n keys costs O(n) no matter how they
+ * are spread over time.
+ *
+ * Slots are intrusive lists of Timer nodes owned by the wheel. A timer points
+ * at its owner's copy of the key instead of holding one, and is the only place
+ * the deadline is kept, so the owner keeps at most one timer per key and must
+ * cancel it before that key is freed. Not thread-safe.
+ */
+class TimingWheel {
+public:
+    struct Timer {
+        const std::string *key;
+        uint64_t expireAtMs;
+
+    private:
+        friend class TimingWheel;
+        Timer *prev = nullptr;
+        Timer *next = nullptr;
+        uint32_t level = 0;
+        uint32_t slot = 0;
+    };
+    // Heap bytes per scheduled timer (node plus allocator overhead), for owners
+    // that account for memory
+    static constexpr size_t kTimerBytes = 48;
+
+    explicit TimingWheel(uint64_t nowMs = 0);
+    ~TimingWheel();
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel& operator=(const TimingWheel &) = delete;
+    // Timers stay where they are, so handles remain valid across a move
+    TimingWheel(TimingWheel &&other) noexcept;
+    TimingWheel& operator=(TimingWheel &&other) noexcept;
+
+    // key must stay valid until the timer fires or is cancelled
+    Timer* schedule(const std::string *key, uint64_t expireAtMs);
+    void reschedule(Timer *timer, uint64_t expireAtMs);
+    // Frees the timer, scheduled or fired
+    void cancel(Timer *timer);
+    // Moves timers due at or before nowMs out of the wheel into `due`. They
+    // stay allocated, deadline and key intact, until passed to cancel().
+    // Stops early, between ticks, once `due` holds at least `limit` timers;
+    // call again to go on.
+    void advance(uint64_t nowMs, std::vector<Timer*> &due,
+                 size_t limit = std::numeric_limits<size_t>::max());
+    size_t size() const { return count_; }
+
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 8;
+    static constexpr size_t kSlots = size_t(1) << kSlotBits;
+
+private:
+    // Timer::level of a timer advance() has handed out
+    static constexpr uint32_t kFired = kLevels;
+
+    // Timers due before `earliest` are placed to fire at `earliest`
+    void place(Timer *timer, uint64_t earliest);
+    void unlink(Timer *timer);
+    void release();
+
+    Timer *slots_[kLevels][kSlots];
+    // Last tick processed; every timer is due strictly after it
+    uint64_t current_;
+    size_t count_;
+    size_t levelCount_[kLevels];
+};
+
+#endif // TIMING_WHEEL_HPP
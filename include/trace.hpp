@@ -0,0 +1,79 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Hot-path tracing. TRACE_SCOPE("name") records a complete event (start and
+ * end timestamp) for the enclosing scope into the calling thread's own
+ * lock-free ring buffer, which keeps the most recent events (flight
+ * recorder); traceChromeJson() drains every buffer into Chrome trace /
+ * Perfetto JSON.
+ *
+ * Trace points are compiled in only with -DENABLE_TRACING (CMake option
+ * ENABLE_TRACING); otherwise TRACE_SCOPE expands to nothing and its argument
+ * is never evaluated. Names must be string literals (or otherwise outlive the
+ * dump): events keep the pointer, not a copy.
+ */
+
+#ifdef ENABLE_TRACING
+constexpr bool kTracingEnabled = true;
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+constexpr bool kTracingEnabled = false;
+#define TRACE_SCOPE(name) static_cast<void>(0)
+#endif
+
+// Raw timestamp: the TSC on x86, steady_clock nanoseconds elsewhere. Ticks
+// are converted to wall time when the trace is dumped.
+inline uint64_t traceTimestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+struct TraceEvent {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Appends to the calling thread's buffer, overwriting its oldest event when full
+void traceRecord(const char *name, uint64_t start, uint64_t end);
+
+// Drains every thread's buffer into {"traceEvents": [...]} with one "X"
+// (complete) event per record, timestamps in microseconds. Events are
+// consumed: the next call returns only what was recorded since.
+std::string traceChromeJson();
+
+// Events overwritten before a dump could read them, since start
+uint64_t traceDropped();
+
+/**
+ * TraceScope: records one event from construction to destruction. Used
+ * through TRACE_SCOPE so that disabled builds carry no trace code.
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char *name) : name_(name), start_(traceTimestamp()) {}
+    ~TraceScope() { traceRecord(name_, start_, traceTimestamp()); }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope& operator=(const TraceScope &) = delete;
+
+private:
+    const char *name_;
+    uint64_t start_;
+};
+
+#endif // TRACE_HPP
@@ -0,0 +1,40 @@
+#ifndef TRANSACTION_HPP
+#define TRANSACTION_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "datastore.hpp"
+
+/**
+ * Transaction: optimistic multi-key transaction over one ConcurrentHashMap.
+ * Reads go straight to the map and record the version they saw; writes are
+ * buffered. commit() hands both to ConcurrentHashMap::commitBatch, which
+ * applies every write or none. A failed commit means another writer changed
+ * something this transaction read: start a new transaction and retry.
+ */
+class Transaction {
+public:
+    explicit Transaction(ConcurrentHashMap &map,
+                         ConcurrentHashMap::CommitHook onCommit = nullptr);
+
+    // Sees this transaction's own buffered writes
+    bool get(const std::string &key, std::string &outVal);
+    void put(const std::string &key, const std::string &value, uint64_t expireAtMs = 0);
+    void remove(const std::string &key);
+
+    // Single use; false if a read was invalidated (nothing is applied)
+    bool commit();
+
+private:
+    const ConcurrentHashMap::BatchWrite* findWrite(const std::string &key) const;
+
+    ConcurrentHashMap *map_;
+    ConcurrentHashMap::CommitHook onCommit_;
+    ConcurrentHashMap::ReadSet reads_;
+    std::vector<ConcurrentHashMap::BatchWrite> writes_;
+    bool done_ = false;
+};
+
+#endif // TRANSACTION_HPP
@@ -0,0 +1,90 @@
+#ifndef WATCH_HPP
+#define WATCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "concurrency.hpp"
+#include "push_sender.hpp"
+
+struct WatchEvent {
+    std::string key;
+    std::string value;
+    bool removed = false;
+};
+
+/**
+ * WatchHub: pushes key changes to WATCH subscribers over their persistent
+ * connections.
+ *
+ * publish() never blocks: it offers the event to each matching subscriber's
+ * BoundedMpmcQueue and wakes the hub's PushSender thread. The
+ * subscriber list is swapped copy-on-write and read under an EpochManager
+ * Guard. The sender drains each queue into a per-subscriber pending map
+ * keyed by key, so a subscriber that reads slowly receives only the latest
+ * change per key. If a queue fills up, or too many distinct keys are waiting,
+ * events are dropped and the subscriber is sent "OVERFLOW" so it can re-read.
+ *
+ * Wire format: "OK" once registered, so every change after it is delivered,
+ * then "UPDATE key value", "DELETE key" and "OVERFLOW" lines. A value with
+ * line breaks is sent as "UPDATEBLOB key len", len raw bytes and a newline.
+ */
+class WatchHub : private PushSender {
+public:
+    explicit WatchHub(size_t queueCapacity = 1024, size_t maxPendingKeys = 4096);
+    ~WatchHub() override;
+
+    WatchHub(const WatchHub &) = delete;
+    WatchHub& operator=(const WatchHub &) = delete;
+
+    // Takes ownership of sock. pattern is an exact key, or a prefix ending in '*'
+    void subscribe(int sock, const std::string &pattern);
+    void publish(const std::string &key, const std::string &value, bool removed);
+
+    size_t subscribers() const { return count_.load(std::memory_order_relaxed); }
+    // Events discarded for full queues or too many pending keys
+    size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Subscriber : Connection {
+        Subscriber(int s, const std::string &pattern, size_t capacity);
+        bool matches(const std::string &key) const;
+
+        std::string pattern;
+        bool prefix;
+        BoundedMpmcQueue<WatchEvent> queue;
+        std::atomic<bool> overflowed{false};
+
+        // Sender thread only: latest event per key, in first-change order
+        std::unordered_map<std::string, WatchEvent> pending;
+        std::vector<std::string> order;
+    };
+    struct SubscriberList {
+        std::vector<Subscriber*> subs;
+    };
+
+    void collect(std::vector<Connection*> &out) override;
+    bool backlog(const Connection &conn) const override;
+    void fill(Connection &conn) override;
+    void drop(const std::vector<Connection*> &conns) override;
+    // Sender thread only: moves queued events into the pending map
+    void drain(Subscriber &sub);
+
+    const size_t queueCapacity_;
+    const size_t maxPendingKeys_;
+    std::atomic<size_t> count_{0};
+    std::atomic<size_t> dropped_{0};
+
+    EpochManager epochs_;
+    std::atomic<SubscriberList*> list_;
+    // Serializes list swaps and starting the sender
+    std::mutex regMtx_;
+};
+
+#endif // WATCH_HPP
@@ -0,0 +1,134 @@
+#include "accelerator.hpp"
+#include "datastore.hpp"
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+static size_t resolveThreadCount(size_t requested) {
+    if (requested != 0) {
+        return requested;
+    }
+    size_t n = std::thread::hardware_concurrency();
+    return n == 0 ? 2 : n;
+}
+
+/******************************************************************************
+ * AnalyticsAccelerator
+ *****************************************************************************/
+size_t AnalyticsAccelerator::filterLessThan(const int *data, size_t size, int value) {
+    AcceleratorBuffer buffer = upload(data, size);
+    if (buffer == 0) {
+        return ColumnarTable::countLessThan(data, size, value);
+    }
+    std::vector<size_t> counts;
+    countLessThan({{buffer, value}}, counts);
+    release(buffer);
+    return counts.empty() ? 0 : counts[0];
+}
+
+/******************************************************************************
+ * CpuParallelAccelerator
+ *****************************************************************************/
+CpuParallelAccelerator::CpuParallelAccelerator(size_t numThreads)
+    : numThreads_(resolveThreadCount(numThreads)), pool_(numThreads_) {}
+
+AcceleratorBuffer CpuParallelAccelerator::upload(const int *data, size_t size) {
+    auto column = std::make_shared<std::vector<int>>(data, data + size);
+    std::unique_lock<std::shared_mutex> lock(buffersMtx_);
+    AcceleratorBuffer id = nextBuffer_++;
+    buffers_.emplace(id, std::move(column));
+    return id;
+}
+
+bool CpuParallelAccelerator::append(AcceleratorBuffer buffer, const int *data, size_t size) {
+    std::unique_lock<std::shared_mutex> lock(buffersMtx_);
+    auto it = buffers_.find(buffer);
+    if (it == buffers_.end()) {
+        return false;
+    }
+    it->second->insert(it->second->end(), data, data + size);
+    return true;
+}
+
+void CpuParallelAccelerator::release(AcceleratorBuffer buffer) {
+    std::unique_lock<std::shared_mutex> lock(buffersMtx_);
+    buffers_.erase(buffer);
+}
+
+size_t CpuParallelAccelerator::bufferSize(AcceleratorBuffer buffer) const {
+    std::shared_lock<std::shared_mutex> lock(buffersMtx_);
+    auto it = buffers_.find(buffer);
+    return it == buffers_.end() ? 0 : it->second->size();
+}
+
+bool CpuParallelAccelerator::countLessThan(const std::vector<LessThanPredicate> &preds,
+                                           std::vector<size_t> &counts) {
+    counts.assign(preds.size(), 0);
+    // Appends take the exclusive lock, so buffers cannot move under the scan
+    std::shared_lock<std::shared_mutex> lock(buffersMtx_);
+
+    // Group predicates by buffer so each column is walked once per batch
+    std::unordered_map<AcceleratorBuffer, std::vector<size_t>> byBuffer;
+    for (size_t i = 0; i < preds.size(); ++i) {
+        if (buffers_.find(preds[i].buffer) == buffers_.end()) {
+            return false;
+        }
+        byBuffer[preds[i].buffer].push_back(i);
+    }
+    for (const auto &group : byBuffer) {
+        const std::vector<int> &column = *buffers_.at(group.first);
+        std::vector<int> values;
+        for (size_t i : group.second) {
+            values.push_back(preds[i].value);
+        }
+        std::vector<size_t> groupCounts;
+        scanColumn(column.data(), column.size(), values, groupCounts);
+        for (size_t j = 0; j < group.second.size(); ++j) {
+            counts[group.second[j]] = groupCounts[j];
+        }
+    }
+    return true;
+}
+
+size_t CpuParallelAccelerator::filterLessThan(const int *data, size_t size, int value) {
+    std::vector<size_t> counts;
+    scanColumn(data, size, {value}, counts);
+    return counts[0];
+}
+
+void CpuParallelAccelerator::scanColumn(const int *data, size_t size,
+                                        const std::vector<int> &values,
+                                        std::vector<size_t> &counts) {
+    auto scanSlice = [data, &values](size_t begin, size_t end) {
+        std::vector<size_t> local(values.size(), 0);
+        for (size_t t = begin; t < end; t += kTileRows) {
+            const size_t n = std::min(kTileRows, end - t);
+            for (size_t p = 0; p < values.size(); ++p) {
+                local[p] += ColumnarTable::countLessThan(data + t, n, values[p]);
+            }
+        }
+        return local;
+    };
+
+    if (size < kMinParallelRows || numThreads_ == 1) {
+        counts = scanSlice(0, size);
+        return;
+    }
+    // One contiguous slice per worker, rounded to whole tiles
+    size_t slice = (size + numThreads_ - 1) / numThreads_;
+    slice = (slice + kTileRows - 1) / kTileRows * kTileRows;
+    std::vector<std::future<std::vector<size_t>>> parts;
+    parts.reserve(numThreads_);
+    for (size_t begin = 0; begin < size; begin += slice) {
+        const size_t end = std::min(size, begin + slice);
+        parts.push_back(pool_.enqueue(scanSlice, begin, end));
+    }
+    counts.assign(values.size(), 0);
+    for (auto &f : parts) {
+        std::vector<size_t> local = f.get();
+        for (size_t p = 0; p < local.size(); ++p) {
+            counts[p] += local[p];
+        }
+    }
+}
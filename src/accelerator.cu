@@ -0,0 +1,163 @@
+// Built only with -DUSE_CUDA=ON (see CMakeLists.txt)
+#include "accelerator.hpp"
+
+#include <algorithm>
+#include <cuda_runtime.h>
+
+/******************************************************************************
+ * CudaAccelerator
+ *****************************************************************************/
+__global__ void countLessThanKernel(const int *col, size_t size,
+                                    const int *thresholds, int numPreds,
+                                    unsigned long long *counts) {
+    __shared__ unsigned int blockCounts[CudaAccelerator::kMaxPredicatesPerLaunch];
+    for (int p = threadIdx.x; p < numPreds; p += blockDim.x) {
+        blockCounts[p] = 0;
+    }
+    __syncthreads();
+
+    // Grid-stride loop; per-thread counts stay in registers
+    unsigned int local[CudaAccelerator::kMaxPredicatesPerLaunch] = {0};
+    const size_t stride = static_cast<size_t>(gridDim.x) * blockDim.x;
+    for (size_t i = static_cast<size_t>(blockIdx.x) * blockDim.x + threadIdx.x; i < size; i += stride) {
+        const int v = col[i];
+        for (int p = 0; p < numPreds; ++p) {
+            local[p] += v < thresholds[p];
+        }
+    }
+
+    // Warp shuffle reduction, one shared-memory atomic per warp
+    const int lane = threadIdx.x & 31;
+    for (int p = 0; p < numPreds; ++p) {
+        unsigned int v = local[p];
+        for (int offset = 16; offset > 0; offset >>= 1) {
+            v += __shfl_down_sync(0xffffffff, v, offset);
+        }
+        if (lane == 0) {
+            atomicAdd(&blockCounts[p], v);
+        }
+    }
+    __syncthreads();
+
+    // One global atomic per block per predicate
+    for (int p = threadIdx.x; p < numPreds; p += blockDim.x) {
+        atomicAdd(&counts[p], static_cast<unsigned long long>(blockCounts[p]));
+    }
+}
+
+bool CudaAccelerator::deviceAvailable() {
+    int devices = 0;
+    return cudaGetDeviceCount(&devices) == cudaSuccess && devices > 0;
+}
+
+CudaAccelerator::CudaAccelerator() {
+    cudaMalloc(&d_thresholds_, kMaxPredicatesPerLaunch * sizeof(int));
+    cudaMalloc(&d_counts_, kMaxPredicatesPerLaunch * sizeof(unsigned long long));
+}
+
+CudaAccelerator::~CudaAccelerator() {
+    for (auto &kv : buffers_) {
+        cudaFree(kv.second.data);
+    }
+    cudaFree(d_thresholds_);
+    cudaFree(d_counts_);
+}
+
+AcceleratorBuffer CudaAccelerator::upload(const int *data, size_t size) {
+    DeviceColumn column;
+    column.capacity = std::max<size_t>(size, 1);
+    if (cudaMalloc(&column.data, column.capacity * sizeof(int)) != cudaSuccess) {
+        return 0;
+    }
+    cudaMemcpy(column.data, data, size * sizeof(int), cudaMemcpyHostToDevice);
+    column.size = size;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    AcceleratorBuffer id = nextBuffer_++;
+    buffers_.emplace(id, column);
+    return id;
+}
+
+bool CudaAccelerator::append(AcceleratorBuffer buffer, const int *data, size_t size) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = buffers_.find(buffer);
+    if (it == buffers_.end()) {
+        return false;
+    }
+    DeviceColumn &column = it->second;
+    if (column.size + size > column.capacity) {
+        // Geometric growth keeps repeated appends amortized O(1) device copies
+        size_t capacity = std::max(column.capacity * 2, column.size + size);
+        int *grown = nullptr;
+        if (cudaMalloc(&grown, capacity * sizeof(int)) != cudaSuccess) {
+            return false;
+        }
+        cudaMemcpy(grown, column.data, column.size * sizeof(int), cudaMemcpyDeviceToDevice);
+        cudaFree(column.data);
+        column.data = grown;
+        column.capacity = capacity;
+    }
+    cudaMemcpy(column.data + column.size, data, size * sizeof(int), cudaMemcpyHostToDevice);
+    column.size += size;
+    return true;
+}
+
+void CudaAccelerator::release(AcceleratorBuffer buffer) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = buffers_.find(buffer);
+    if (it != buffers_.end()) {
+        cudaFree(it->second.data);
+        buffers_.erase(it);
+    }
+}
+
+size_t CudaAccelerator::bufferSize(AcceleratorBuffer buffer) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = buffers_.find(buffer);
+    return it == buffers_.end() ? 0 : it->second.size;
+}
+
+bool CudaAccelerator::countLessThan(const std::vector<LessThanPredicate> &preds,
+                                    std::vector<size_t> &counts) {
+    counts.assign(preds.size(), 0);
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    std::unordered_map<AcceleratorBuffer, std::vector<size_t>> byBuffer;
+    for (size_t i = 0; i < preds.size(); ++i) {
+        if (buffers_.find(preds[i].buffer) == buffers_.end()) {
+            return false;
+        }
+        byBuffer[preds[i].buffer].push_back(i);
+    }
+
+    const int blockSize = 256;
+    for (const auto &group : byBuffer) {
+        const DeviceColumn &column = buffers_.at(group.first);
+        const auto &members = group.second;
+        for (size_t first = 0; first < members.size(); first += kMaxPredicatesPerLaunch) {
+            const int numPreds = static_cast<int>(
+                std::min<size_t>(kMaxPredicatesPerLaunch, members.size() - first));
+            int thresholds[kMaxPredicatesPerLaunch];
+            for (int p = 0; p < numPreds; ++p) {
+                thresholds[p] = preds[members[first + p]].value;
+            }
+            cudaMemcpy(d_thresholds_, thresholds, numPreds * sizeof(int), cudaMemcpyHostToDevice);
+            cudaMemset(d_counts_, 0, numPreds * sizeof(unsigned long long));
+
+            // Enough blocks to fill the device; the grid-stride loop covers the rest
+            const int gridSize = static_cast<int>(std::min<size_t>(
+                (column.size + blockSize - 1) / blockSize, 1024));
+            if (gridSize > 0) {
+                countLessThanKernel<<<gridSize, blockSize>>>(column.data, column.size,
+                                                             d_thresholds_, numPreds, d_counts_);
+            }
+            unsigned long long h_counts[kMaxPredicatesPerLaunch];
+            cudaMemcpy(h_counts, d_counts_, numPreds * sizeof(unsigned long long),
+                       cudaMemcpyDeviceToHost);
+            for (int p = 0; p < numPreds; ++p) {
+                counts[members[first + p]] = static_cast<size_t>(h_counts[p]);
+            }
+        }
+    }
+    return true;
+}
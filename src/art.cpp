@@ -0,0 +1,696 @@
+#include "art.hpp"
+
+#include <algorithm>
+#include <thread>
+
+/******************************************************************************
+ * Node layout
+ *****************************************************************************/
+namespace {
+
+// Child slots hold either an inner node or a tagged ArtLeaf pointer
+using Child = uintptr_t;
+constexpr Child kLeafTag = 1;
+
+// Version word: bit 0 = obsolete, bit 1 = write-locked, rest = counter
+constexpr uint64_t kObsolete = 1;
+constexpr uint64_t kLocked = 2;
+
+enum NodeKind : uint8_t { kNode4, kNode16, kNode48, kNode256 };
+
+} // namespace
+
+struct ArtInnerNode {
+    std::atomic<uint64_t> version{0};
+    const uint8_t kind;
+    std::atomic<uint16_t> count{0};
+    // Immutable: a node whose prefix must change is replaced by a copy
+    const std::string prefix;
+    std::atomic<Child> terminal{0};
+
+    ArtInnerNode(uint8_t k, std::string p) : kind(k), prefix(std::move(p)) {}
+};
+
+namespace {
+
+template <size_t N>
+void clearSlots(std::atomic<Child> (&slots)[N]) {
+    for (auto &s : slots) {
+        s.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Node4 and Node16 keep their key bytes sorted
+template <uint8_t Kind, size_t Capacity>
+struct SortedNode : ArtInnerNode {
+    std::atomic<uint8_t> keys[Capacity];
+    std::atomic<Child> children[Capacity];
+
+    explicit SortedNode(std::string p) : ArtInnerNode(Kind, std::move(p)) {
+        for (auto &k : keys) {
+            k.store(0, std::memory_order_relaxed);
+        }
+        clearSlots(children);
+    }
+};
+using Node4 = SortedNode<kNode4, 4>;
+using Node16 = SortedNode<kNode16, 16>;
+
+struct Node48 : ArtInnerNode {
+    // 0 = no child, otherwise slot + 1
+    std::atomic<uint8_t> index[256];
+    std::atomic<Child> children[48];
+
+    explicit Node48(std::string p) : ArtInnerNode(kNode48, std::move(p)) {
+        for (auto &i : index) {
+            i.store(0, std::memory_order_relaxed);
+        }
+        clearSlots(children);
+    }
+};
+
+struct Node256 : ArtInnerNode {
+    std::atomic<Child> children[256];
+
+    explicit Node256(std::string p) : ArtInnerNode(kNode256, std::move(p)) {
+        clearSlots(children);
+    }
+};
+
+inline bool isLeaf(Child c) { return (c & kLeafTag) != 0; }
+inline ArtLeaf* asLeaf(Child c) { return reinterpret_cast<ArtLeaf*>(c & ~kLeafTag); }
+inline Child tagLeaf(ArtLeaf *l) { return reinterpret_cast<Child>(l) | kLeafTag; }
+inline ArtInnerNode* asInner(Child c) { return reinterpret_cast<ArtInnerNode*>(c); }
+inline Child tagInner(ArtInnerNode *n) { return reinterpret_cast<Child>(n); }
+
+inline uint8_t byteAt(const std::string &s, size_t i) {
+    return static_cast<uint8_t>(s[i]);
+}
+
+size_t commonPrefix(const std::string &a, size_t aFrom, const std::string &b, size_t bFrom) {
+    size_t n = 0;
+    while (aFrom + n < a.size() && bFrom + n < b.size() && a[aFrom + n] == b[bFrom + n]) {
+        ++n;
+    }
+    return n;
+}
+
+ArtInnerNode* newNode(uint8_t kind, std::string prefix) {
+    switch (kind) {
+    case kNode4: return new Node4(std::move(prefix));
+    case kNode16: return new Node16(std::move(prefix));
+    case kNode48: return new Node48(std::move(prefix));
+    default: return new Node256(std::move(prefix));
+    }
+}
+
+void destroyNode(void *p) {
+    ArtInnerNode *n = static_cast<ArtInnerNode*>(p);
+    switch (n->kind) {
+    case kNode4: delete static_cast<Node4*>(n); break;
+    case kNode16: delete static_cast<Node16*>(n); break;
+    case kNode48: delete static_cast<Node48*>(n); break;
+    default: delete static_cast<Node256*>(n); break;
+    }
+}
+
+/******************************************************************************
+ * Optimistic lock coupling
+ *****************************************************************************/
+bool readLockOrRestart(const ArtInnerNode *n, uint64_t &v) {
+    int spins = 0;
+    while (true) {
+        v = n->version.load(std::memory_order_acquire);
+        if (v & kObsolete) {
+            return false;
+        }
+        if (!(v & kLocked)) {
+            return true;
+        }
+        if (++spins == 64) {
+            std::this_thread::yield();
+            spins = 0;
+        }
+    }
+}
+
+// Seqlock-style check that nothing read since readLock was modified
+bool validate(const ArtInnerNode *n, uint64_t v) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return n->version.load(std::memory_order_relaxed) == v;
+}
+
+bool upgradeToWriteLock(ArtInnerNode *n, uint64_t v) {
+    uint64_t expected = v;
+    if (!n->version.compare_exchange_strong(expected, v + kLocked,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+        return false;
+    }
+    // Order the lock before the node writes that follow, for optimistic readers
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+void writeUnlock(ArtInnerNode *n) {
+    n->version.fetch_add(kLocked, std::memory_order_release);
+}
+
+void writeUnlockObsolete(ArtInnerNode *n) {
+    n->version.fetch_add(kLocked + kObsolete, std::memory_order_release);
+}
+
+/******************************************************************************
+ * Per-kind child operations (callers hold the write lock, except for the
+ * optimistic readers findChild/forEachChild whose results are validated)
+ *****************************************************************************/
+template <class Node>
+Child findSorted(const Node *n, uint8_t b, size_t capacity) {
+    const size_t c = std::min<size_t>(n->count.load(std::memory_order_relaxed), capacity);
+    for (size_t i = 0; i < c; ++i) {
+        if (n->keys[i].load(std::memory_order_relaxed) == b) {
+            return n->children[i].load(std::memory_order_relaxed);
+        }
+    }
+    return 0;
+}
+
+Child findChild(const ArtInnerNode *n, uint8_t b) {
+    switch (n->kind) {
+    case kNode4: return findSorted(static_cast<const Node4*>(n), b, 4);
+    case kNode16: return findSorted(static_cast<const Node16*>(n), b, 16);
+    case kNode48: {
+        const Node48 *x = static_cast<const Node48*>(n);
+        const uint8_t slot = x->index[b].load(std::memory_order_relaxed);
+        return (slot == 0 || slot > 48) ? 0 : x->children[slot - 1].load(std::memory_order_relaxed);
+    }
+    default:
+        return static_cast<const Node256*>(n)->children[b].load(std::memory_order_relaxed);
+    }
+}
+
+// Visits children in key-byte order
+template <class F>
+void forEachChild(const ArtInnerNode *n, F &&f) {
+    switch (n->kind) {
+    case kNode4:
+    case kNode16: {
+        const size_t capacity = n->kind == kNode4 ? 4 : 16;
+        const size_t c = std::min<size_t>(n->count.load(std::memory_order_relaxed), capacity);
+        for (size_t i = 0; i < c; ++i) {
+            uint8_t key;
+            Child child;
+            if (n->kind == kNode4) {
+                key = static_cast<const Node4*>(n)->keys[i].load(std::memory_order_relaxed);
+                child = static_cast<const Node4*>(n)->children[i].load(std::memory_order_relaxed);
+            } else {
+                key = static_cast<const Node16*>(n)->keys[i].load(std::memory_order_relaxed);
+                child = static_cast<const Node16*>(n)->children[i].load(std::memory_order_relaxed);
+            }
+            if (child != 0) {
+                f(key, child);
+            }
+        }
+        break;
+    }
+    case kNode48: {
+        const Node48 *x = static_cast<const Node48*>(n);
+        for (int b = 0; b < 256; ++b) {
+            const uint8_t slot = x->index[b].load(std::memory_order_relaxed);
+            if (slot != 0 && slot <= 48) {
+                Child child = x->children[slot - 1].load(std::memory_order_relaxed);
+                if (child != 0) {
+                    f(static_cast<uint8_t>(b), child);
+                }
+            }
+        }
+        break;
+    }
+    default: {
+        const Node256 *x = static_cast<const Node256*>(n);
+        for (int b = 0; b < 256; ++b) {
+            Child child = x->children[b].load(std::memory_order_relaxed);
+            if (child != 0) {
+                f(static_cast<uint8_t>(b), child);
+            }
+        }
+        break;
+    }
+    }
+}
+
+bool isFull(const ArtInnerNode *n) {
+    const uint16_t c = n->count.load(std::memory_order_relaxed);
+    switch (n->kind) {
+    case kNode4: return c >= 4;
+    case kNode16: return c >= 16;
+    case kNode48: return c >= 48;
+    default: return false;
+    }
+}
+
+template <class Node>
+void addSorted(Node *n, uint8_t b, Child child) {
+    const uint16_t c = n->count.load(std::memory_order_relaxed);
+    uint16_t pos = 0;
+    while (pos < c && n->keys[pos].load(std::memory_order_relaxed) < b) {
+        ++pos;
+    }
+    for (uint16_t i = c; i > pos; --i) {
+        n->keys[i].store(n->keys[i - 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        n->children[i].store(n->children[i - 1].load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+    }
+    n->keys[pos].store(b, std::memory_order_relaxed);
+    n->children[pos].store(child, std::memory_order_relaxed);
+    n->count.store(c + 1, std::memory_order_relaxed);
+}
+
+void addChild(ArtInnerNode *n, uint8_t b, Child child) {
+    switch (n->kind) {
+    case kNode4: addSorted(static_cast<Node4*>(n), b, child); break;
+    case kNode16: addSorted(static_cast<Node16*>(n), b, child); break;
+    case kNode48: {
+        Node48 *x = static_cast<Node48*>(n);
+        uint8_t slot = 0;
+        while (x->children[slot].load(std::memory_order_relaxed) != 0) {
+            ++slot;
+        }
+        x->children[slot].store(child, std::memory_order_relaxed);
+        x->index[b].store(slot + 1, std::memory_order_relaxed);
+        x->count.fetch_add(1, std::memory_order_relaxed);
+        break;
+    }
+    default:
+        static_cast<Node256*>(n)->children[b].store(child, std::memory_order_relaxed);
+        n->count.fetch_add(1, std::memory_order_relaxed);
+        break;
+    }
+}
+
+template <class Node>
+std::atomic<Child>* sortedSlot(Node *n, uint8_t b) {
+    const uint16_t c = n->count.load(std::memory_order_relaxed);
+    for (uint16_t i = 0; i < c; ++i) {
+        if (n->keys[i].load(std::memory_order_relaxed) == b) {
+            return &n->children[i];
+        }
+    }
+    return nullptr;
+}
+
+std::atomic<Child>* childSlot(ArtInnerNode *n, uint8_t b) {
+    switch (n->kind) {
+    case kNode4: return sortedSlot(static_cast<Node4*>(n), b);
+    case kNode16: return sortedSlot(static_cast<Node16*>(n), b);
+    case kNode48: {
+        Node48 *x = static_cast<Node48*>(n);
+        const uint8_t slot = x->index[b].load(std::memory_order_relaxed);
+        return slot == 0 ? nullptr : &x->children[slot - 1];
+    }
+    default:
+        return &static_cast<Node256*>(n)->children[b];
+    }
+}
+
+void replaceChild(ArtInnerNode *n, uint8_t b, Child child) {
+    childSlot(n, b)->store(child, std::memory_order_relaxed);
+}
+
+template <class Node>
+void removeSorted(Node *n, uint8_t b) {
+    const uint16_t c = n->count.load(std::memory_order_relaxed);
+    uint16_t pos = 0;
+    while (pos < c && n->keys[pos].load(std::memory_order_relaxed) != b) {
+        ++pos;
+    }
+    if (pos == c) {
+        return;
+    }
+    for (uint16_t i = pos; i + 1 < c; ++i) {
+        n->keys[i].store(n->keys[i + 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        n->children[i].store(n->children[i + 1].load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+    }
+    n->children[c - 1].store(0, std::memory_order_relaxed);
+    n->count.store(c - 1, std::memory_order_relaxed);
+}
+
+void removeChild(ArtInnerNode *n, uint8_t b) {
+    switch (n->kind) {
+    case kNode4: removeSorted(static_cast<Node4*>(n), b); break;
+    case kNode16: removeSorted(static_cast<Node16*>(n), b); break;
+    case kNode48: {
+        Node48 *x = static_cast<Node48*>(n);
+        const uint8_t slot = x->index[b].load(std::memory_order_relaxed);
+        if (slot != 0) {
+            x->index[b].store(0, std::memory_order_relaxed);
+            x->children[slot - 1].store(0, std::memory_order_relaxed);
+            x->count.fetch_sub(1, std::memory_order_relaxed);
+        }
+        break;
+    }
+    default: {
+        Node256 *x = static_cast<Node256*>(n);
+        if (x->children[b].load(std::memory_order_relaxed) != 0) {
+            x->children[b].store(0, std::memory_order_relaxed);
+            x->count.fetch_sub(1, std::memory_order_relaxed);
+        }
+        break;
+    }
+    }
+}
+
+// Copy of n (same children and terminal) as `kind` with a new prefix
+ArtInnerNode* copyNode(const ArtInnerNode *n, uint8_t kind, std::string prefix) {
+    ArtInnerNode *copy = newNode(kind, std::move(prefix));
+    copy->terminal.store(n->terminal.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    forEachChild(n, [copy](uint8_t b, Child c) { addChild(copy, b, c); });
+    return copy;
+}
+
+void freeSubtree(Child c) {
+    if (isLeaf(c)) {
+        delete asLeaf(c);
+        return;
+    }
+    ArtInnerNode *n = asInner(c);
+    Child t = n->terminal.load(std::memory_order_relaxed);
+    if (t != 0) {
+        delete asLeaf(t);
+    }
+    forEachChild(n, [](uint8_t, Child child) { freeSubtree(child); });
+    destroyNode(n);
+}
+
+} // namespace
+
+/******************************************************************************
+ * AdaptiveRadixTree
+ *****************************************************************************/
+AdaptiveRadixTree::AdaptiveRadixTree()
+    : root_(new Node256(std::string())), size_(0) {}
+
+AdaptiveRadixTree::~AdaptiveRadixTree() {
+    freeSubtree(tagInner(root_));
+}
+
+ArtLeaf* AdaptiveRadixTree::lookup(const std::string &key) const {
+    EpochManager::Guard guard(epochs_);
+restart:
+    const ArtInnerNode *node = root_;
+    uint64_t v;
+    if (!readLockOrRestart(node, v)) goto restart;
+    size_t depth = 0;
+    while (true) {
+        const std::string &prefix = node->prefix;
+        if (commonPrefix(prefix, 0, key, depth) != prefix.size()) {
+            if (!validate(node, v)) goto restart;
+            return nullptr;
+        }
+        depth += prefix.size();
+        const Child child = depth == key.size()
+            ? node->terminal.load(std::memory_order_relaxed)
+            : findChild(node, byteAt(key, depth));
+        if (!validate(node, v)) goto restart;
+        if (child == 0) {
+            return nullptr;
+        }
+        if (isLeaf(child)) {
+            ArtLeaf *leaf = asLeaf(child);
+            return leaf->key == key ? leaf : nullptr;
+        }
+        const ArtInnerNode *next = asInner(child);
+        uint64_t nextV;
+        if (!readLockOrRestart(next, nextV)) goto restart;
+        if (!validate(node, v)) goto restart;
+        node = next;
+        v = nextV;
+        ++depth;
+    }
+}
+
+bool AdaptiveRadixTree::insert(ArtLeaf *leaf) {
+    const std::string &key = leaf->key;
+    EpochManager::Guard guard(epochs_);
+restart:
+    ArtInnerNode *parent = nullptr;
+    uint64_t parentV = 0;
+    uint8_t parentByte = 0;
+    ArtInnerNode *node = root_;
+    uint64_t v;
+    if (!readLockOrRestart(node, v)) goto restart;
+    size_t depth = 0;
+    while (true) {
+        const std::string &prefix = node->prefix;
+        const size_t match = commonPrefix(prefix, 0, key, depth);
+        if (match < prefix.size()) {
+            // Key diverges inside the compressed prefix: split it. The root has
+            // no prefix, so a parent always exists here.
+            if (!upgradeToWriteLock(parent, parentV)) goto restart;
+            if (!upgradeToWriteLock(node, v)) {
+                writeUnlock(parent);
+                goto restart;
+            }
+            ArtInnerNode *split = newNode(kNode4, prefix.substr(0, match));
+            addChild(split, byteAt(prefix, match),
+                     tagInner(copyNode(node, node->kind, prefix.substr(match + 1))));
+            if (depth + match == key.size()) {
+                split->terminal.store(tagLeaf(leaf), std::memory_order_relaxed);
+            } else {
+                addChild(split, byteAt(key, depth + match), tagLeaf(leaf));
+            }
+            replaceChild(parent, parentByte, tagInner(split));
+            writeUnlock(parent);
+            writeUnlockObsolete(node);
+            epochs_.retire(node, destroyNode);
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        depth += prefix.size();
+
+        if (depth == key.size()) {
+            const Child existing = node->terminal.load(std::memory_order_relaxed);
+            if (existing != 0) {
+                if (!validate(node, v)) goto restart;
+                return false;
+            }
+            if (!upgradeToWriteLock(node, v)) goto restart;
+            node->terminal.store(tagLeaf(leaf), std::memory_order_relaxed);
+            writeUnlock(node);
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        const uint8_t b = byteAt(key, depth);
+        const Child child = findChild(node, b);
+        if (!validate(node, v)) goto restart;
+
+        if (child == 0) {
+            if (isFull(node)) {
+                // Grow into the next node kind and swing the parent's pointer
+                if (!upgradeToWriteLock(parent, parentV)) goto restart;
+                if (!upgradeToWriteLock(node, v)) {
+                    writeUnlock(parent);
+                    goto restart;
+                }
+                ArtInnerNode *grown = copyNode(node, node->kind + 1, prefix);
+                addChild(grown, b, tagLeaf(leaf));
+                replaceChild(parent, parentByte, tagInner(grown));
+                writeUnlock(parent);
+                writeUnlockObsolete(node);
+                epochs_.retire(node, destroyNode);
+            } else {
+                if (!upgradeToWriteLock(node, v)) goto restart;
+                addChild(node, b, tagLeaf(leaf));
+                writeUnlock(node);
+            }
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        if (isLeaf(child)) {
+            ArtLeaf *other = asLeaf(child);
+            if (other->key == key) {
+                if (!validate(node, v)) goto restart;
+                return false;
+            }
+            // Two keys share this slot: push both one level down
+            const size_t d = depth + 1;
+            const size_t common = commonPrefix(other->key, d, key, d);
+            ArtInnerNode *expanded = newNode(kNode4, key.substr(d, common));
+            for (ArtLeaf *l : {other, leaf}) {
+                if (d + common == l->key.size()) {
+                    expanded->terminal.store(tagLeaf(l), std::memory_order_relaxed);
+                } else {
+                    addChild(expanded, byteAt(l->key, d + common), tagLeaf(l));
+                }
+            }
+            if (!upgradeToWriteLock(node, v)) {
+                destroyNode(expanded);
+                goto restart;
+            }
+            replaceChild(node, b, tagInner(expanded));
+            writeUnlock(node);
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        ArtInnerNode *next = asInner(child);
+        uint64_t nextV;
+        if (!readLockOrRestart(next, nextV)) goto restart;
+        if (!validate(node, v)) goto restart;
+        parent = node;
+        parentV = v;
+        parentByte = b;
+        node = next;
+        v = nextV;
+        ++depth;
+    }
+}
+
+bool AdaptiveRadixTree::remove(const std::string &key) {
+    ArtLeaf *removed = nullptr;
+    {
+        EpochManager::Guard guard(epochs_);
+    restart:
+        ArtInnerNode *parent = nullptr;
+        uint64_t parentV = 0;
+        uint8_t parentByte = 0;
+        ArtInnerNode *node = root_;
+        uint64_t v;
+        if (!readLockOrRestart(node, v)) goto restart;
+        size_t depth = 0;
+        while (true) {
+            const std::string &prefix = node->prefix;
+            if (commonPrefix(prefix, 0, key, depth) != prefix.size()) {
+                if (!validate(node, v)) goto restart;
+                return false;
+            }
+            depth += prefix.size();
+
+            const bool atTerminal = depth == key.size();
+            const uint8_t b = atTerminal ? 0 : byteAt(key, depth);
+            const Child child = atTerminal ? node->terminal.load(std::memory_order_relaxed)
+                                           : findChild(node, b);
+            const size_t slots = node->count.load(std::memory_order_relaxed) +
+                                 (node->terminal.load(std::memory_order_relaxed) != 0 ? 1 : 0);
+            if (!validate(node, v)) goto restart;
+            if (child == 0) {
+                return false;
+            }
+
+            if (isLeaf(child)) {
+                if (asLeaf(child)->key != key) {
+                    return false;
+                }
+                if (node != root_ && slots == 1) {
+                    // Last entry: unlink the whole node from its parent
+                    if (!upgradeToWriteLock(parent, parentV)) goto restart;
+                    if (!upgradeToWriteLock(node, v)) {
+                        writeUnlock(parent);
+                        goto restart;
+                    }
+                    removeChild(parent, parentByte);
+                    writeUnlock(parent);
+                    writeUnlockObsolete(node);
+                    epochs_.retire(node, destroyNode);
+                } else {
+                    if (!upgradeToWriteLock(node, v)) goto restart;
+                    if (atTerminal) {
+                        node->terminal.store(0, std::memory_order_relaxed);
+                    } else {
+                        removeChild(node, b);
+                    }
+                    writeUnlock(node);
+                }
+                removed = asLeaf(child);
+                break;
+            }
+
+            ArtInnerNode *next = asInner(child);
+            uint64_t nextV;
+            if (!readLockOrRestart(next, nextV)) goto restart;
+            if (!validate(node, v)) goto restart;
+            parent = node;
+            parentV = v;
+            parentByte = b;
+            node = next;
+            v = nextV;
+            ++depth;
+        }
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    epochs_.retire(removed);
+    return true;
+}
+
+AdaptiveRadixTree::ScanStep AdaptiveRadixTree::scanNode(const ArtInnerNode *node, std::string path,
+                                                        const std::string &from,
+                                                        const std::string &end, size_t limit,
+                                                        std::vector<std::string> &out) const {
+    uint64_t v;
+    if (!readLockOrRestart(node, v)) {
+        return ScanStep::Restart;
+    }
+    path += node->prefix;
+    // Every key below starts with `path`
+    if (!end.empty() && path >= end) {
+        return ScanStep::Stop;
+    }
+    if (path < from && from.compare(0, path.size(), path) != 0) {
+        return ScanStep::Continue;
+    }
+
+    std::vector<std::pair<uint8_t, Child>> children;
+    const Child terminal = node->terminal.load(std::memory_order_relaxed);
+    forEachChild(node, [&children](uint8_t b, Child c) { children.emplace_back(b, c); });
+    if (!validate(node, v)) {
+        return ScanStep::Restart;
+    }
+
+    auto emit = [&](const ArtLeaf *leaf) {
+        if (leaf->key < from) {
+            return ScanStep::Continue;
+        }
+        if (!end.empty() && leaf->key >= end) {
+            return ScanStep::Stop;
+        }
+        out.push_back(leaf->key);
+        return out.size() >= limit ? ScanStep::Stop : ScanStep::Continue;
+    };
+
+    if (terminal != 0) {
+        ScanStep step = emit(asLeaf(terminal));
+        if (step != ScanStep::Continue) {
+            return step;
+        }
+    }
+    for (const auto &c : children) {
+        ScanStep step = isLeaf(c.second)
+            ? emit(asLeaf(c.second))
+            : scanNode(asInner(c.second), path + static_cast<char>(c.first), from, end, limit, out);
+        if (step != ScanStep::Continue) {
+            return step;
+        }
+    }
+    return ScanStep::Continue;
+}
+
+std::vector<std::string> AdaptiveRadixTree::scan(const std::string &start, const std::string &end,
+                                                 size_t limit) const {
+    std::vector<std::string> out;
+    if (limit == 0) {
+        return out;
+    }
+    EpochManager::Guard guard(epochs_);
+    std::string from = start;
+    // A concurrent change under a visited node restarts just past the last key emitted
+    while (scanNode(root_, std::string(), from, end, limit, out) == ScanStep::Restart) {
+        if (!out.empty()) {
+            from = out.back();
+            from.push_back('\0');
+        }
+    }
+    return out;
+}
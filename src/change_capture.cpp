@@ -0,0 +1,149 @@
+#include "change_capture.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+/******************************************************************************
+ * ChangeCaptureStream
+ *****************************************************************************/
+ChangeCaptureStream::ChangeCaptureStream(std::vector<CaptureColumn> columns,
+                                         char delimiter,
+                                         size_t batchSize,
+                                         std::chrono::milliseconds flushInterval,
+                                         size_t maxPending)
+    : columns_(std::move(columns)),
+      delimiter_(delimiter),
+      batchSize_(batchSize == 0 ? 1 : batchSize),
+      flushInterval_(flushInterval),
+      maxPending_(maxPending == 0 ? 1 : maxPending)
+{
+    pending_.reserve(batchSize_);
+    worker_ = std::thread(&ChangeCaptureStream::run, this);
+}
+
+ChangeCaptureStream::~ChangeCaptureStream() {
+    {
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        stop_ = true;
+    }
+    queueCv_.notify_one();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void ChangeCaptureStream::publish(const std::string &key, const std::string &value) {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        if (pending_.size() >= maxPending_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        pending_.emplace_back(key, value);
+        wake = pending_.size() == batchSize_;
+    }
+    // Only full batches wake the worker early; partial ones wait for the timer
+    if (wake) {
+        queueCv_.notify_one();
+    }
+}
+
+void ChangeCaptureStream::flush() {
+    drainBatch();
+}
+
+int ChangeCaptureStream::columnIndex(const std::string &name) const {
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        if (columns_[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void ChangeCaptureStream::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queueMtx_);
+            queueCv_.wait_for(lock, flushInterval_, [this] {
+                return stop_ || pending_.size() >= batchSize_;
+            });
+            if (stop_ && pending_.empty()) {
+                return;
+            }
+        }
+        drainBatch();
+    }
+}
+
+void ChangeCaptureStream::drainBatch() {
+    std::lock_guard<std::mutex> applyLock(applyMtx_);
+    std::vector<std::pair<std::string, std::string>> batch;
+    batch.reserve(batchSize_);
+    {
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        batch.swap(pending_);
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    // Parse outside the table lock; readers only wait for the appends
+    std::vector<std::vector<int>> rows;
+    rows.reserve(batch.size());
+    std::vector<int> row;
+    for (const auto &kv : batch) {
+        if (parseRow(kv.second, row)) {
+            rows.push_back(row);
+        } else {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(tableMtx_);
+    for (const auto &r : rows) {
+        table_.addRow(r);
+    }
+}
+
+bool ChangeCaptureStream::parseRow(const std::string &value, std::vector<int> &row) const {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t pos = value.find(delimiter_, start);
+        fields.push_back(value.substr(start, pos - start));
+        if (pos == std::string::npos) {
+            break;
+        }
+        start = pos + 1;
+    }
+
+    row.assign(columns_.size(), 0);
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        const CaptureColumn &col = columns_[i];
+        if (col.field >= fields.size() || fields[col.field].empty()) {
+            return false;
+        }
+        const char *text = fields[col.field].c_str();
+        char *end = nullptr;
+        errno = 0;
+        long long cell = 0;
+        if (col.type == CaptureType::Int) {
+            cell = std::strtoll(text, &end, 10);
+        } else {
+            double d = std::strtod(text, &end);
+            if (!std::isfinite(d)) {
+                return false;
+            }
+            cell = std::llround(d * std::pow(10.0, col.scale));
+        }
+        if (*end != '\0' || errno == ERANGE || cell < INT_MIN || cell > INT_MAX) {
+            return false;
+        }
+        row[i] = static_cast<int>(cell);
+    }
+    return true;
+}
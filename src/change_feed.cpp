@@ -0,0 +1,204 @@
+#include "change_feed.hpp"
+#include "concurrency.hpp"
+#include "net_util.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <unistd.h>
+
+/******************************************************************************
+ * ChangeEvent
+ *****************************************************************************/
+std::string ChangeEvent::format() const {
+    if (op == Op::Remove) {
+        return "CHANGE " + std::to_string(seq) + " REMOVE " + key + "\n";
+    }
+    if (!lineSafe(value)) {
+        return "CHANGE " + std::to_string(seq) + " BLOB " + key + " " +
+               std::to_string(expireAtMs) + " " + std::to_string(value.size()) + "\n" +
+               value + "\n";
+    }
+    return "CHANGE " + std::to_string(seq) + " PUT " + key + " " +
+           std::to_string(expireAtMs) + " " + value + "\n";
+}
+
+bool ChangeEvent::parse(const std::string &line, ChangeEvent &out, size_t *blobLen) {
+    std::istringstream iss(line);
+    std::string tag, op;
+    if (!(iss >> tag >> out.seq >> op >> out.key) || tag != "CHANGE") {
+        return false;
+    }
+    if (blobLen != nullptr) {
+        *blobLen = 0;
+    }
+    out.value.clear();
+    if (op == "REMOVE") {
+        out.op = Op::Remove;
+        out.expireAtMs = 0;
+        return true;
+    }
+    out.op = Op::Put;
+    if (op == "BLOB") {
+        size_t len = 0;
+        if (blobLen == nullptr || !(iss >> out.expireAtMs >> len)) {
+            return false;
+        }
+        *blobLen = len;
+        return true;
+    }
+    if (op != "PUT" || !(iss >> out.expireAtMs)) {
+        return false;
+    }
+    iss.get();
+    std::getline(iss, out.value);
+    return true;
+}
+
+/******************************************************************************
+ * ChangeFeed
+ *****************************************************************************/
+ChangeFeed::ChangeFeed(size_t retainEvents, size_t batchEvents, size_t retainBytes)
+    : retainEvents_(retainEvents == 0 ? 1 : retainEvents),
+      batchEvents_(batchEvents == 0 ? 1 : batchEvents),
+      retainBytes_(retainBytes)
+{
+}
+
+ChangeFeed::~ChangeFeed() {
+    stopSender();
+    for (Consumer *c : consumers_) {
+        close(c->sock);
+        delete c;
+    }
+}
+
+size_t ChangeFeed::eventBytes(const ChangeEvent &e) {
+    // Control block, event and deque slot
+    static const size_t kEventOverhead = 128;
+    return e.key.size() + e.value.size() + kEventOverhead;
+}
+
+void ChangeFeed::append(std::vector<ChangeEvent> events) {
+    if (events.empty()) {
+        return;
+    }
+    std::vector<EventPtr> shared;
+    shared.reserve(events.size());
+    for (auto &e : events) {
+        shared.push_back(std::make_shared<const ChangeEvent>(std::move(e)));
+    }
+    // Evicted events are freed after the lock is released
+    std::vector<EventPtr> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto &e : shared) {
+            nextSeq_ = e->seq + 1;
+            bytes_ += eventBytes(*e);
+            events_.push_back(std::move(e));
+        }
+        // An event larger than the whole budget is not kept at all
+        while (!events_.empty() && (events_.size() > retainEvents_ || bytes_ > retainBytes_)) {
+            bytes_ -= eventBytes(*events_.front());
+            evicted.push_back(std::move(events_.front()));
+            events_.pop_front();
+        }
+    }
+    appended_.notify_all();
+    if (consumerCount_.load(std::memory_order_relaxed) > 0) {
+        wake();
+    }
+}
+
+uint64_t ChangeFeed::lastSequence() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return nextSeq_ - 1;
+}
+
+uint64_t ChangeFeed::firstSequence() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return events_.empty() ? nextSeq_ : events_.front()->seq;
+}
+
+size_t ChangeFeed::retainedBytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return bytes_;
+}
+
+bool ChangeFeed::readShared(uint64_t from, size_t max, std::vector<EventPtr> &out) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    const uint64_t first = events_.empty() ? nextSeq_ : events_.front()->seq;
+    if (from < first) {
+        return false;
+    }
+    // Seqs are contiguous, so the cursor indexes the window directly
+    for (uint64_t i = from - first; i < events_.size() && max > 0; ++i, --max) {
+        out.push_back(events_[i]);
+    }
+    return true;
+}
+
+bool ChangeFeed::read(uint64_t from, size_t max, std::vector<ChangeEvent> &out) const {
+    std::vector<EventPtr> shared;
+    if (!readShared(from, max, shared)) {
+        return false;
+    }
+    for (const EventPtr &e : shared) {
+        out.push_back(*e);
+    }
+    return true;
+}
+
+bool ChangeFeed::waitFor(uint64_t from, std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(mtx_);
+    return appended_.wait_for(lock, timeout, [&]() { return nextSeq_ > from; });
+}
+
+void ChangeFeed::subscribe(int sock, uint64_t from) {
+    std::lock_guard<std::mutex> lock(consumersMtx_);
+    startSender();
+    consumers_.push_back(new Consumer(sock, from));
+    consumerCount_.fetch_add(1, std::memory_order_relaxed);
+    wake();
+}
+
+void ChangeFeed::collect(std::vector<Connection*> &out) {
+    // Read before polling: an append after this wakes the sender
+    polledLast_ = lastSequence();
+    std::lock_guard<std::mutex> lock(consumersMtx_);
+    out.insert(out.end(), consumers_.begin(), consumers_.end());
+}
+
+bool ChangeFeed::backlog(const Connection &conn) const {
+    return static_cast<const Consumer&>(conn).cursor <= polledLast_;
+}
+
+void ChangeFeed::drop(const std::vector<Connection*> &conns) {
+    std::lock_guard<std::mutex> lock(consumersMtx_);
+    for (Connection *conn : conns) {
+        consumers_.erase(std::find(consumers_.begin(), consumers_.end(), conn));
+        consumerCount_.fetch_sub(1, std::memory_order_relaxed);
+        close(conn->sock);
+        delete static_cast<Consumer*>(conn);
+    }
+}
+
+void ChangeFeed::fill(Connection &conn) {
+    static const size_t kMaxOutbox = 64 * 1024;
+    Consumer &consumer = static_cast<Consumer&>(conn);
+    std::vector<EventPtr> batch;
+    while (!consumer.closing && consumer.outbox.size() < kMaxOutbox) {
+        batch.clear();
+        if (!readShared(consumer.cursor, batchEvents_, batch)) {
+            consumer.outbox += "ERROR TRUNCATED " + std::to_string(firstSequence()) + "\n";
+            consumer.closing = true;
+            break;
+        }
+        if (batch.empty()) {
+            break;
+        }
+        for (const EventPtr &e : batch) {
+            consumer.outbox += e->format();
+        }
+        consumer.cursor = batch.back()->seq + 1;
+    }
+}
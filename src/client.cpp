@@ -0,0 +1,565 @@
+#include "client.hpp"
+#include "compression.hpp"
+#include "net_util.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/******************************************************************************
+ * DataStoreClient
+ *****************************************************************************/
+DataStoreClient::DataStoreClient(const std::vector<NodeAddress> &nodes)
+    : DataStoreClient(nodes, Options()) {}
+
+DataStoreClient::DataStoreClient(const std::vector<NodeAddress> &nodes, const Options &opts)
+    : nodes_(nodes), opts_(opts)
+{
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        byName_[nodes_[i].name] = i;
+        ring_.addNode(nodes_[i].name);
+        load_.push_back(std::make_unique<NodeLoad>());
+    }
+    if (opts_.nearCache) {
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            trackers_.push_back(std::make_unique<Tracker>());
+        }
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            trackers_[i]->thread = std::thread(&DataStoreClient::runTracker, this, i);
+        }
+    }
+}
+
+DataStoreClient::~DataStoreClient() {
+    {
+        std::lock_guard<std::mutex> lock(stopMtx_);
+        stop_ = true;
+        // Unblock trackers waiting in recv()
+        for (auto &t : trackers_) {
+            if (t->sock >= 0) {
+                shutdown(t->sock, SHUT_RDWR);
+            }
+        }
+    }
+    stopCv_.notify_all();
+    for (auto &t : trackers_) {
+        t->thread.join();
+    }
+}
+
+size_t DataStoreClient::nodeIndex(const std::string &key) const {
+    return byName_.at(ring_.getNode(key));
+}
+
+const NodeAddress& DataStoreClient::ownerOf(const std::string &key) const {
+    return nodes_[nodeIndex(key)];
+}
+
+bool DataStoreClient::roundTrip(size_t node, const std::string &request, std::string &reply) {
+    int sock = connectTo(nodes_[node].host, nodes_[node].port);
+    if (sock < 0) {
+        return false;
+    }
+    bool ok = sendAll(sock, request);
+    if (ok) {
+        SocketReader reader(sock);
+        ok = reader.readLine(reply);
+    }
+    close(sock);
+    return ok;
+}
+
+bool DataStoreClient::timedRoundTrip(size_t node, const std::string &request,
+                                     std::string &reply) {
+    NodeLoad &load = *load_[node];
+    load.inflight.fetch_add(1, std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok = roundTrip(node, request, reply);
+    const int64_t sample = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    load.inflight.fetch_sub(1, std::memory_order_relaxed);
+    if (ok) {
+        // Racing updates may lose a sample, which the average tolerates
+        const int64_t old = static_cast<int64_t>(load.latencyNs.load(std::memory_order_relaxed));
+        const int64_t next = old == 0 ? sample : old + (sample - old) / 8;
+        load.latencyNs.store(static_cast<uint64_t>(next), std::memory_order_relaxed);
+        load.reads.fetch_add(1, std::memory_order_relaxed);
+    }
+    return ok;
+}
+
+size_t DataStoreClient::pickReadNode(const std::string &key) {
+    if (opts_.readReplicas <= 1) {
+        return nodeIndex(key);
+    }
+    if (opts_.replicaReadMinCount > 0) {
+        readCounts_.record(key);
+        if (!readCounts_.isHot(key, opts_.replicaReadMinCount)) {
+            return nodeIndex(key);
+        }
+    }
+    const std::vector<std::string> replicas = ring_.getNodes(key, opts_.readReplicas);
+    if (replicas.size() == 1) {
+        return byName_.at(replicas[0]);
+    }
+    thread_local std::minstd_rand rng(std::random_device{}());
+    std::uniform_int_distribution<size_t> pick(0, replicas.size() - 1);
+    const size_t a = pick(rng);
+    size_t b = pick(rng);
+    if (b == a) {
+        b = (a + 1) % replicas.size();
+    }
+    auto score = [this](size_t node) {
+        const NodeLoad &load = *load_[node];
+        return load.latencyNs.load(std::memory_order_relaxed) *
+               (load.inflight.load(std::memory_order_relaxed) + 1);
+    };
+    const size_t na = byName_.at(replicas[a]);
+    const size_t nb = byName_.at(replicas[b]);
+    return score(nb) < score(na) ? nb : na;
+}
+
+std::vector<size_t> DataStoreClient::readsPerNode() const {
+    std::vector<size_t> counts;
+    for (const auto &load : load_) {
+        counts.push_back(load->reads.load(std::memory_order_relaxed));
+    }
+    return counts;
+}
+
+bool DataStoreClient::put(const std::string &key, const std::string &value, uint64_t ttlMs) {
+    const NodeAddress &owner = ownerOf(key);
+    int sock = connectTo(owner.host, owner.port);
+    if (sock < 0) {
+        return false;
+    }
+    std::string msg = "PUT " + key + " " + value;
+    if (ttlMs > 0) {
+        msg += " PX " + std::to_string(ttlMs);
+    }
+    const bool ok = sendAll(sock, msg + "\n");
+    close(sock);
+    return ok;
+}
+
+bool DataStoreClient::putAcked(const std::string &key, const std::string &value,
+                               uint64_t ttlMs) {
+    std::string msg = "PUT " + key + " " + value;
+    if (ttlMs > 0) {
+        msg += " PX " + std::to_string(ttlMs);
+    }
+    std::string reply;
+    return roundTrip(nodeIndex(key), msg + " ACK\n", reply) && reply == "OK";
+}
+
+bool DataStoreClient::putBlob(const std::string &key, const std::string &value, uint64_t ttlMs) {
+    const NodeAddress &owner = ownerOf(key);
+    int sock = connectTo(owner.host, owner.port);
+    if (sock < 0) {
+        return false;
+    }
+    std::string header = "PUTBLOB " + key + " " + std::to_string(value.size());
+    if (ttlMs > 0) {
+        header += " PX " + std::to_string(ttlMs);
+    }
+    std::string reply;
+    SocketReader reader(sock);
+    const bool ok = sendAll(sock, header + "\n", value.data(), value.size()) &&
+                    reader.readLine(reply) && reply == "OK";
+    close(sock);
+    return ok;
+}
+
+bool DataStoreClient::getBlob(const std::string &key, std::string &outVal) {
+    const NodeAddress &owner = ownerOf(key);
+    int sock = connectTo(owner.host, owner.port);
+    if (sock < 0) {
+        return false;
+    }
+    SocketReader reader(sock);
+    std::string reply;
+    // Accept the node's compressed form; decoding here spares it the CPU
+    // and the wire the bytes
+    bool ok = sendAll(sock, "GETBLOB " + key + " LZ\n") && reader.readLine(reply) &&
+              reply.compare(0, 5, "BLOB ") == 0;
+    if (ok) {
+        char *rest = nullptr;
+        std::string body(std::strtoull(reply.c_str() + 5, &rest, 10), '\0');
+        ok = body.empty() || reader.readExact(&body[0], body.size());
+        if (ok && std::strcmp(rest, " LZ") == 0) {
+            ok = lzDecompress(body.data(), body.size(), outVal);
+        } else {
+            outVal.swap(body);
+        }
+    }
+    close(sock);
+    return ok;
+}
+
+bool DataStoreClient::remove(const std::string &key) {
+    const NodeAddress &owner = ownerOf(key);
+    int sock = connectTo(owner.host, owner.port);
+    if (sock < 0) {
+        return false;
+    }
+    const bool ok = sendAll(sock, "REMOVE " + key + "\n");
+    close(sock);
+    return ok;
+}
+
+bool DataStoreClient::get(const std::string &key, std::string &outVal) {
+    uint64_t seenInvalidations = 0;
+    if (opts_.nearCache) {
+        std::lock_guard<std::mutex> lock(cacheMtx_);
+        auto it = cache_.find(key);
+        if (it != cache_.end()) {
+            outVal = it->second.value;
+            nearCacheHits_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    const size_t node = pickReadNode(key);
+    bool tracked = false;
+    if (opts_.nearCache) {
+        std::lock_guard<std::mutex> lock(cacheMtx_);
+        seenInvalidations = trackers_[node]->invalidations;
+        tracked = trackers_[node]->up;
+    }
+    std::string reply;
+    bool cacheable = true;
+    // Only a client that hears this node's invalidations may be offered a lease
+    if (!timedRoundTrip(node, "GET " + key + (tracked ? " TRACKED\n" : "\n"), reply)) {
+        const size_t owner = nodeIndex(key);
+        // An unreachable replica falls back to the owner, whose invalidation
+        // counter was not sampled, so that reply is never cached
+        if (node == owner || !timedRoundTrip(owner, "GET " + key + "\n", reply)) {
+            return false;
+        }
+        cacheable = false;
+    }
+    std::istringstream iss(reply);
+    std::string status, value, flag;
+    iss >> status >> value >> flag;
+    if (status != "VALUE") {
+        return false;
+    }
+    outVal = value;
+    if (opts_.nearCache && cacheable && flag == "CACHE") {
+        std::lock_guard<std::mutex> lock(cacheMtx_);
+        Tracker &tracker = *trackers_[node];
+        if (tracker.up && tracker.invalidations == seenInvalidations &&
+            cache_.size() < opts_.nearCacheCapacity) {
+            cache_[key] = {value, node};
+        }
+    }
+    return true;
+}
+
+bool DataStoreClient::getWithVersion(const std::string &key, std::string &outVal,
+                                     uint64_t &version) {
+    std::string reply;
+    if (!roundTrip(nodeIndex(key), "GETS " + key + "\n", reply)) {
+        return false;
+    }
+    std::istringstream iss(reply);
+    std::string status;
+    return (iss >> status >> outVal >> version) && status == "VALUE";
+}
+
+bool DataStoreClient::compareAndSwap(const std::string &key, uint64_t expectedVersion,
+                                     const std::string &value, uint64_t *newVersion) {
+    std::string reply;
+    if (!roundTrip(nodeIndex(key),
+                   "CAS " + key + " " + std::to_string(expectedVersion) + " " + value + "\n",
+                   reply)) {
+        return false;
+    }
+    std::istringstream iss(reply);
+    std::string status;
+    uint64_t version = 0;
+    if (!(iss >> status >> version) || status != "OK") {
+        return false;
+    }
+    if (newVersion != nullptr) {
+        *newVersion = version;
+    }
+    return true;
+}
+
+bool DataStoreClient::increment(const std::string &key, int64_t delta, int64_t &result) {
+    std::string reply;
+    if (!roundTrip(nodeIndex(key), "INCR " + key + " " + std::to_string(delta) + "\n", reply)) {
+        return false;
+    }
+    std::istringstream iss(reply);
+    std::string status;
+    return (iss >> status >> result) && status == "INTEGER";
+}
+
+bool DataStoreClient::append(const std::string &key, const std::string &suffix,
+                             size_t *newLength) {
+    std::string reply;
+    if (!roundTrip(nodeIndex(key), "APPEND " + key + " " + suffix + "\n", reply)) {
+        return false;
+    }
+    std::istringstream iss(reply);
+    std::string status;
+    size_t length = 0;
+    if (!(iss >> status >> length) || status != "INTEGER") {
+        return false;
+    }
+    if (newLength != nullptr) {
+        *newLength = length;
+    }
+    return true;
+}
+
+bool DataStoreClient::scan(const std::string &start, const std::string &end, size_t limit,
+                           std::vector<std::pair<std::string, std::string>> &out) {
+    const std::string request = "SCAN " + (start.empty() ? std::string("-") : start) + " " +
+                                (end.empty() ? std::string("-") : end) + " " +
+                                std::to_string(limit) + "\n";
+    // Each node returns its own first `limit` keys, so the merged prefix is exact
+    std::map<std::string, std::string> merged;
+    for (const auto &addr : nodes_) {
+        int sock = connectTo(addr.host, addr.port);
+        if (sock < 0) {
+            return false;
+        }
+        bool ok = sendAll(sock, request);
+        SocketReader reader(sock);
+        std::string line;
+        while (ok && (ok = reader.readLine(line)) && line.compare(0, 4, "END ") != 0) {
+            if (line.compare(0, 10, "ENTRYBLOB ") == 0) {
+                // ENTRYBLOB key len, then len raw bytes and a newline
+                std::istringstream iss(line.substr(10));
+                std::string key, value;
+                size_t len = 0;
+                char newline = 0;
+                ok = static_cast<bool>(iss >> key >> len);
+                if (ok) {
+                    value.resize(len);
+                    ok = (len == 0 || reader.readExact(&value[0], len)) &&
+                         reader.readExact(&newline, 1) && newline == '\n';
+                }
+                if (ok) {
+                    merged.emplace(std::move(key), std::move(value));
+                }
+                continue;
+            }
+            const size_t keyEnd = line.find(' ', 6);
+            if (line.compare(0, 6, "ENTRY ") != 0 || keyEnd == std::string::npos) {
+                ok = false;
+                break;
+            }
+            merged.emplace(line.substr(6, keyEnd - 6), line.substr(keyEnd + 1));
+        }
+        close(sock);
+        if (!ok) {
+            return false;
+        }
+    }
+    out.clear();
+    for (auto it = merged.begin(); it != merged.end() && out.size() < limit; ++it) {
+        out.emplace_back(it->first, it->second);
+    }
+    return true;
+}
+
+bool DataStoreClient::hotKeys(const std::string &nodeName, size_t n, std::vector<HotKey> &out) {
+    auto it = byName_.find(nodeName);
+    if (it == byName_.end()) {
+        return false;
+    }
+    const NodeAddress &addr = nodes_[it->second];
+    int sock = connectTo(addr.host, addr.port);
+    if (sock < 0) {
+        return false;
+    }
+    out.clear();
+    bool ok = sendAll(sock, "STATS HOTKEYS " + std::to_string(n) + "\n");
+    SocketReader reader(sock);
+    std::string line;
+    while (ok && (ok = reader.readLine(line)) && line != "END") {
+        std::istringstream iss(line);
+        std::string tag;
+        HotKey h;
+        if (!(iss >> tag >> h.key >> h.count >> h.error) || tag != "HOTKEY") {
+            ok = false;
+            break;
+        }
+        out.push_back(h);
+    }
+    close(sock);
+    return ok;
+}
+
+bool DataStoreClient::stats(const std::string &nodeName,
+                            std::vector<std::pair<std::string, double>> &out) {
+    auto it = byName_.find(nodeName);
+    if (it == byName_.end()) {
+        return false;
+    }
+    const NodeAddress &addr = nodes_[it->second];
+    int sock = connectTo(addr.host, addr.port);
+    if (sock < 0) {
+        return false;
+    }
+    out.clear();
+    bool ok = sendAll(sock, "STATS\n");
+    SocketReader reader(sock);
+    std::string line;
+    while (ok && (ok = reader.readLine(line)) && line != "END") {
+        std::istringstream iss(line);
+        std::string tag, series;
+        double value = 0;
+        if (!(iss >> tag >> series >> value) || tag != "STAT") {
+            ok = false;
+            break;
+        }
+        out.emplace_back(series, value);
+    }
+    close(sock);
+    return ok;
+}
+
+size_t DataStoreClient::nearCacheSize() const {
+    std::lock_guard<std::mutex> lock(cacheMtx_);
+    return cache_.size();
+}
+
+bool DataStoreClient::nearCacheReady() const {
+    if (!opts_.nearCache) {
+        return false;
+    }
+    for (const auto &t : trackers_) {
+        if (!t->up) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DataStoreClient::dropCachedFrom(size_t node) {
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        if (it->second.node == node) {
+            it = cache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DataStoreClient::runTracker(size_t node) {
+    Tracker &tracker = *trackers_[node];
+    while (!stop_) {
+        int sock = connectTo(nodes_[node].host, nodes_[node].port);
+        {
+            std::lock_guard<std::mutex> lock(stopMtx_);
+            if (stop_) {
+                if (sock >= 0) {
+                    close(sock);
+                }
+                break;
+            }
+            tracker.sock = sock;
+        }
+        if (sock >= 0) {
+            SocketReader reader(sock);
+            std::string line;
+            if (sendAll(sock, "TRACK\n") && reader.readLine(line) && line == "OK") {
+                tracker.up = true;
+                while (reader.readLine(line)) {
+                    if (line.compare(0, 11, "INVALIDATE ") == 0) {
+                        std::lock_guard<std::mutex> lock(cacheMtx_);
+                        ++tracker.invalidations;
+                        cache_.erase(line.substr(11));
+                    }
+                }
+            }
+            // Anything cached from this node may now be stale
+            std::lock_guard<std::mutex> cacheLock(cacheMtx_);
+            tracker.up = false;
+            ++tracker.invalidations;
+            dropCachedFrom(node);
+        }
+        {
+            std::lock_guard<std::mutex> lock(stopMtx_);
+            tracker.sock = -1;
+        }
+        if (sock >= 0) {
+            close(sock);
+        }
+        std::unique_lock<std::mutex> lock(stopMtx_);
+        stopCv_.wait_for(lock, std::chrono::seconds(1), [this]() { return stop_.load(); });
+    }
+}
+
+/******************************************************************************
+ * ChangeFeedReader
+ *****************************************************************************/
+ChangeFeedReader::ChangeFeedReader(const NodeAddress &node, uint64_t fromSeq)
+    : node_(node), cursor_(fromSeq) {}
+
+ChangeFeedReader::~ChangeFeedReader() {
+    disconnect();
+}
+
+bool ChangeFeedReader::connect() {
+    sock_ = connectTo(node_.host, node_.port);
+    if (sock_ < 0) {
+        return false;
+    }
+    reader_ = std::make_unique<SocketReader>(sock_);
+    std::string reply;
+    if (!sendAll(sock_, "CDC " + std::to_string(cursor_) + "\n") || !reader_->readLine(reply)) {
+        disconnect();
+        return false;
+    }
+    if (reply.compare(0, 3, "OK ") != 0) {
+        truncated_ = reply.compare(0, 15, "ERROR TRUNCATED") == 0;
+        disconnect();
+        return false;
+    }
+    // The node resolves 0 to its oldest retained seq
+    cursor_ = std::strtoull(reply.c_str() + 3, nullptr, 10);
+    return true;
+}
+
+void ChangeFeedReader::disconnect() {
+    reader_.reset();
+    if (sock_ >= 0) {
+        close(sock_);
+        sock_ = -1;
+    }
+}
+
+bool ChangeFeedReader::next(ChangeEvent &out) {
+    for (int attempt = 0; attempt < 2 && !truncated_; ++attempt) {
+        if (sock_ < 0 && !connect()) {
+            continue;
+        }
+        std::string line;
+        size_t blobLen = 0;
+        if (reader_->readLine(line) && ChangeEvent::parse(line, out, &blobLen)) {
+            char newline;
+            if (blobLen > 0) {
+                out.value.resize(blobLen);
+            }
+            if (blobLen == 0 ||
+                (reader_->readExact(&out.value[0], blobLen) && reader_->readExact(&newline, 1))) {
+                cursor_ = out.seq + 1;
+                return true;
+            }
+        }
+        truncated_ = line.compare(0, 15, "ERROR TRUNCATED") == 0;
+        disconnect();
+    }
+    return false;
+}
@@ -0,0 +1,187 @@
+#include "column_file.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const char kColumnMagic[8] = {'D', 'C', 'O', 'L', 'v', '1', '\0', '\0'};
+
+bool syncFile(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+}
+
+/******************************************************************************
+ * ColumnFile (writer)
+ *****************************************************************************/
+bool ColumnFile::write(const std::string &path, const int *data, size_t numRows,
+                       size_t chunkRows) {
+    // Round the chunk size up so every chunk starts on a page boundary
+    chunkRows = std::max(chunkRows, kChunkAlignRows);
+    chunkRows = (chunkRows + kChunkAlignRows - 1) / kChunkAlignRows * kChunkAlignRows;
+    const size_t numChunks = (numRows + chunkRows - 1) / chunkRows;
+
+    // Written beside the target and renamed over it, so readers that still
+    // map the old file keep its inode instead of faulting past a shorter end
+    const std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    char headerPage[kDataOffset];
+    std::memset(headerPage, 0, sizeof(headerPage));
+    ColumnFileHeader header;
+    std::memcpy(header.magic, kColumnMagic, sizeof(header.magic));
+    header.version = kVersion;
+    header.chunkRows = static_cast<uint32_t>(chunkRows);
+    header.numRows = numRows;
+    header.numChunks = numChunks;
+    std::memcpy(headerPage, &header, sizeof(header));
+    out.write(headerPage, sizeof(headerPage));
+
+    out.write(reinterpret_cast<const char*>(data),
+              static_cast<std::streamsize>(numRows * sizeof(int32_t)));
+
+    // Pad so the footer is 8-byte aligned
+    const size_t dataEnd = kDataOffset + numRows * sizeof(int32_t);
+    const size_t footerOffset = (dataEnd + 7) / 8 * 8;
+    const char pad[8] = {0};
+    out.write(pad, static_cast<std::streamsize>(footerOffset - dataEnd));
+
+    for (size_t c = 0; c < numChunks; ++c) {
+        const size_t begin = c * chunkRows;
+        const size_t end = std::min(numRows, begin + chunkRows);
+        auto mm = std::minmax_element(data + begin, data + end);
+        ZoneMap zm{*mm.first, *mm.second};
+        out.write(reinterpret_cast<const char*>(&zm), sizeof(zm));
+    }
+
+    ColumnFileTail tail;
+    tail.footerOffset = footerOffset;
+    tail.numChunks = numChunks;
+    std::memcpy(tail.magic, kColumnMagic, sizeof(tail.magic));
+    out.write(reinterpret_cast<const char*>(&tail), sizeof(tail));
+
+    out.close();
+    if (!out.good() || !syncFile(tmpPath) || ::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/******************************************************************************
+ * MappedColumn
+ *****************************************************************************/
+MappedColumn::~MappedColumn() {
+    close();
+}
+
+MappedColumn::MappedColumn(MappedColumn &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedColumn& MappedColumn::operator=(MappedColumn &&other) noexcept {
+    if (this != &other) {
+        close();
+        base_ = other.base_;
+        mappedBytes_ = other.mappedBytes_;
+        data_ = other.data_;
+        numRows_ = other.numRows_;
+        chunkRows_ = other.chunkRows_;
+        zoneMaps_ = std::move(other.zoneMaps_);
+        other.base_ = nullptr;
+        other.mappedBytes_ = 0;
+        other.data_ = nullptr;
+        other.numRows_ = 0;
+        other.chunkRows_ = 0;
+    }
+    return *this;
+}
+
+bool MappedColumn::open(const std::string &path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < ColumnFile::kDataOffset + sizeof(ColumnFileTail)) {
+        ::close(fd);
+        return false;
+    }
+    const size_t fileSize = static_cast<size_t>(st.st_size);
+    void *base = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    base_ = base;
+    mappedBytes_ = fileSize;
+
+    const char *bytes = static_cast<const char*>(base_);
+    ColumnFileHeader header;
+    ColumnFileTail tail;
+    std::memcpy(&header, bytes, sizeof(header));
+    std::memcpy(&tail, bytes + fileSize - sizeof(tail), sizeof(tail));
+
+    // Sizes from the file are bounded by division, never by a sum or product
+    // that a corrupt header could overflow
+    const size_t tailOffset = fileSize - sizeof(tail);
+    const bool valid =
+        std::memcmp(header.magic, kColumnMagic, sizeof(kColumnMagic)) == 0 &&
+        std::memcmp(tail.magic, kColumnMagic, sizeof(kColumnMagic)) == 0 &&
+        header.version == ColumnFile::kVersion &&
+        header.chunkRows > 0 &&
+        tail.footerOffset >= ColumnFile::kDataOffset &&
+        tail.footerOffset <= tailOffset &&
+        header.numRows <= (tail.footerOffset - ColumnFile::kDataOffset) / sizeof(int32_t) &&
+        tail.numChunks == (tailOffset - tail.footerOffset) / sizeof(ZoneMap) &&
+        (tailOffset - tail.footerOffset) % sizeof(ZoneMap) == 0 &&
+        header.numChunks == tail.numChunks &&
+        header.numChunks == (header.numRows + header.chunkRows - 1) / header.chunkRows;
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    numRows_ = header.numRows;
+    chunkRows_ = header.chunkRows;
+    data_ = reinterpret_cast<const int*>(bytes + ColumnFile::kDataOffset);
+    zoneMaps_.resize(tail.numChunks);
+    std::memcpy(zoneMaps_.data(), bytes + tail.footerOffset,
+                tail.numChunks * sizeof(ZoneMap));
+
+    // Scans are sequential; let the kernel read ahead aggressively
+    madvise(base_, mappedBytes_, MADV_SEQUENTIAL);
+    return true;
+}
+
+void MappedColumn::close() {
+    if (base_ != nullptr) {
+        munmap(base_, mappedBytes_);
+    }
+    base_ = nullptr;
+    mappedBytes_ = 0;
+    data_ = nullptr;
+    numRows_ = 0;
+    chunkRows_ = 0;
+    zoneMaps_.clear();
+}
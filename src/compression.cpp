@@ -0,0 +1,313 @@
+#include "compression.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+constexpr unsigned kHashBits = 12;
+// A decoded size beyond this many times the encoding is treated as corrupt
+constexpr uint64_t kMaxRatio = 256;
+
+uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+size_t commonLength(const unsigned char *a, const unsigned char *b, size_t max) {
+    size_t n = 0;
+    while (n < max && a[n] == b[n]) {
+        ++n;
+    }
+    return n;
+}
+
+void putLength(std::string &out, size_t v) {
+    while (v >= 255) {
+        out.push_back(static_cast<char>(255));
+        v -= 255;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool getLength(const unsigned char *&ip, const unsigned char *end, size_t &v) {
+    unsigned char b;
+    do {
+        if (ip == end) {
+            return false;
+        }
+        b = *ip++;
+        v += b;
+    } while (b == 255);
+    return true;
+}
+
+void putVarint(std::string &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool getVarint(const unsigned char *&ip, const unsigned char *end, uint64_t &v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 64 && ip != end; shift += 7) {
+        const unsigned char b = *ip++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Literals then, unless matchLen is 0 (the final sequence), one match
+void putSequence(std::string &out, const unsigned char *literals, size_t litLen,
+                 size_t offset, size_t matchLen) {
+    const size_t matchCode = matchLen == 0 ? 0 : matchLen - kMinMatch;
+    out.push_back(static_cast<char>((std::min<size_t>(litLen, 15) << 4) |
+                                    std::min<size_t>(matchCode, 15)));
+    if (litLen >= 15) {
+        putLength(out, litLen - 15);
+    }
+    out.append(reinterpret_cast<const char*>(literals), litLen);
+    if (matchLen == 0) {
+        return;
+    }
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15) {
+        putLength(out, matchCode - 15);
+    }
+}
+
+} // namespace
+
+/******************************************************************************
+ * CompressionDictionary
+ *****************************************************************************/
+CompressionDictionary::CompressionDictionary(std::string bytes)
+    : bytes_(std::move(bytes)), id_(1469598103934665603ull), table_(size_t(1) << kHashBits, 0)
+{
+    if (bytes_.size() > kMaxBytes) {
+        bytes_.erase(0, bytes_.size() - kMaxBytes);
+    }
+    for (unsigned char c : bytes_) {
+        id_ = (id_ ^ c) * 1099511628211ull;
+    }
+    // Later positions overwrite earlier ones: the most useful bytes are last
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(bytes_.data());
+    for (size_t i = 0; i + kMinMatch <= bytes_.size(); ++i) {
+        table_[hash4(read32(p + i))] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+std::shared_ptr<const CompressionDictionary> CompressionDictionary::train(
+    const std::vector<std::string> &samples, size_t maxBytes) {
+    static const size_t kGram = 8;
+    static const size_t kSegment = 32;
+    maxBytes = std::min(maxBytes, kMaxBytes);
+
+    // How many samples each 8-byte substring occurs in
+    std::unordered_map<uint64_t, uint32_t> freq;
+    for (const auto &s : samples) {
+        std::unordered_set<uint64_t> seen;
+        for (size_t i = 0; i + kGram <= s.size(); ++i) {
+            uint64_t g;
+            std::memcpy(&g, s.data() + i, kGram);
+            if (seen.insert(g).second) {
+                ++freq[g];
+            }
+        }
+    }
+
+    struct Candidate {
+        uint64_t score;
+        const std::string *sample;
+        size_t pos;
+        size_t len;
+    };
+    std::vector<Candidate> candidates;
+    for (const auto &s : samples) {
+        for (size_t pos = 0; pos + kGram <= s.size(); pos += kSegment / 2) {
+            const size_t len = std::min(kSegment, s.size() - pos);
+            uint64_t score = 0;
+            for (size_t i = pos; i + kGram <= pos + len; ++i) {
+                uint64_t g;
+                std::memcpy(&g, s.data() + i, kGram);
+                score += freq[g] - 1;
+            }
+            if (score > 0) {
+                candidates.push_back({score, &s, pos, len});
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) { return a.score > b.score; });
+
+    // Best segments first, skipping ones mostly covered already
+    std::vector<std::string> chosen;
+    std::unordered_set<uint64_t> covered;
+    size_t total = 0;
+    for (const auto &c : candidates) {
+        if (total + c.len > maxBytes) {
+            break;
+        }
+        size_t grams = 0, known = 0;
+        for (size_t i = c.pos; i + kGram <= c.pos + c.len; ++i, ++grams) {
+            uint64_t g;
+            std::memcpy(&g, c.sample->data() + i, kGram);
+            known += covered.count(g);
+        }
+        if (known * 2 > grams) {
+            continue;
+        }
+        for (size_t i = c.pos; i + kGram <= c.pos + c.len; ++i) {
+            uint64_t g;
+            std::memcpy(&g, c.sample->data() + i, kGram);
+            covered.insert(g);
+        }
+        chosen.push_back(c.sample->substr(c.pos, c.len));
+        total += c.len;
+    }
+    std::string bytes;
+    bytes.reserve(total);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+        bytes += *it;
+    }
+    return std::make_shared<CompressionDictionary>(std::move(bytes));
+}
+
+/******************************************************************************
+ * LZ codec
+ *****************************************************************************/
+bool lzCompress(const std::string &in, std::string &out, const CompressionDictionary *dict) {
+    const size_t n = in.size();
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(in.data());
+    const unsigned char *dictBytes =
+        dict ? reinterpret_cast<const unsigned char*>(dict->bytes_.data()) : nullptr;
+    const size_t dictLen = dict ? dict->bytes_.size() : 0;
+
+    out.clear();
+    out.reserve(n);
+    putVarint(out, n);
+    uint32_t table[size_t(1) << kHashBits] = {};
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + kMinMatch <= n) {
+        const uint32_t seq = read32(src + i);
+        const uint32_t h = hash4(seq);
+        const uint32_t cand = table[h];
+        table[h] = static_cast<uint32_t>(i + 1);
+        size_t offset = 0;
+        size_t matchLen = 0;
+        if (cand != 0 && i - (cand - 1) <= kMaxOffset && read32(src + cand - 1) == seq) {
+            const size_t c = cand - 1;
+            offset = i - c;
+            matchLen = kMinMatch + commonLength(src + c + kMinMatch, src + i + kMinMatch,
+                                                n - i - kMinMatch);
+        } else if (dict != nullptr && dict->table_[h] != 0) {
+            const size_t d = dict->table_[h] - 1;
+            if (i + dictLen - d <= kMaxOffset && read32(dictBytes + d) == seq) {
+                offset = i + dictLen - d;
+                matchLen = kMinMatch + commonLength(dictBytes + d + kMinMatch, src + i + kMinMatch,
+                                                    std::min(dictLen - d, n - i) - kMinMatch);
+                if (d + matchLen == dictLen) {
+                    // The match runs off the dictionary into the value's start
+                    matchLen += commonLength(src, src + i + matchLen, n - i - matchLen);
+                }
+            }
+        }
+        if (matchLen < kMinMatch) {
+            ++i;
+            continue;
+        }
+        putSequence(out, src + anchor, i - anchor, offset, matchLen);
+        i += matchLen;
+        anchor = i;
+        if (out.size() >= n) {
+            return false;
+        }
+    }
+    putSequence(out, src + anchor, n - anchor, 0, 0);
+    return out.size() < n;
+}
+
+bool lzDecompress(const char *data, size_t len, std::string &out, const CompressionDictionary *dict) {
+    const unsigned char *ip = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char *end = ip + len;
+    uint64_t n = 0;
+    if (!getVarint(ip, end, n) || n > kMaxRatio * len + 16) {
+        return false;
+    }
+    const unsigned char *dictBytes =
+        dict ? reinterpret_cast<const unsigned char*>(dict->bytes().data()) : nullptr;
+    const size_t dictLen = dict ? dict->bytes().size() : 0;
+    out.resize(n);
+    size_t pos = 0;
+    while (true) {
+        if (ip == end) {
+            return false;
+        }
+        const unsigned token = *ip++;
+        size_t litLen = token >> 4;
+        if (litLen == 15 && !getLength(ip, end, litLen)) {
+            return false;
+        }
+        if (litLen > static_cast<size_t>(end - ip) || litLen > n - pos) {
+            return false;
+        }
+        std::memcpy(&out[pos], ip, litLen);
+        ip += litLen;
+        pos += litLen;
+        if (ip == end) {
+            break;
+        }
+        if (end - ip < 2) {
+            return false;
+        }
+        const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t matchLen = token & 15;
+        if (matchLen == 15 && !getLength(ip, end, matchLen)) {
+            return false;
+        }
+        matchLen += kMinMatch;
+        if (offset == 0 || matchLen > n - pos) {
+            return false;
+        }
+        size_t from = pos - std::min(offset, pos);
+        if (offset > pos) {
+            // Starts in the dictionary, possibly running on into the output
+            const size_t back = offset - pos;
+            if (back > dictLen) {
+                return false;
+            }
+            const size_t fromDict = std::min(back, matchLen);
+            std::memcpy(&out[pos], dictBytes + dictLen - back, fromDict);
+            pos += fromDict;
+            matchLen -= fromDict;
+            from = 0;
+        }
+        if (pos - from >= matchLen) {
+            std::memcpy(&out[pos], &out[from], matchLen);
+            pos += matchLen;
+            continue;
+        }
+        // Byte by byte: an overlapping match repeats the bytes it just wrote
+        for (; matchLen > 0; --matchLen) {
+            out[pos++] = out[from++];
+        }
+    }
+    return pos == n;
+}
@@ -1,11 +1,16 @@
 #include "concurrency.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <unordered_set>
 #include <utility>
 #include <iostream>
 
 /******************************************************************************
  * ThreadPool Implementation
  *****************************************************************************/
-ThreadPool::ThreadPool(size_t numThreads) : stop_(false) {
+ThreadPool::ThreadPool(size_t numThreads, LatencyHistogram *queueWait)
+    : stop_(false), queueWait_(queueWait) {
     // Create worker threads
     for (size_t i = 0; i < numThreads; ++i) {
         workers_.emplace_back([this] {
@@ -23,12 +28,18 @@ ThreadPool::ThreadPool(size_t numThreads) : stop_(false) {
                     tasks_.pop_front();
                 }
                 // Execute the task outside the locked region
+                TRACE_SCOPE("pool.task");
                 task();
             }
         });
     }
 }
 
+size_t ThreadPool::pending() const {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    return tasks_.size();
+}
+
 ThreadPool::~ThreadPool() {
     {
         std::unique_lock<std::mutex> lock(queueMutex_);
@@ -41,3 +52,202 @@ ThreadPool::~ThreadPool() {
         }
     }
 }
+
+/******************************************************************************
+ * EpochManager Implementation
+ *****************************************************************************/
+namespace {
+
+// Live managers by id. A thread's participant records belong to their
+// manager, so a thread exiting after its manager is gone must not touch them.
+std::mutex& liveManagersMtx() {
+    static std::mutex *mtx = new std::mutex;
+    return *mtx;
+}
+
+std::unordered_set<uint64_t>& liveManagers() {
+    static auto *ids = new std::unordered_set<uint64_t>;
+    return *ids;
+}
+
+struct ThreadEpochRecords {
+    // (manager id, participant, its inUse flag)
+    struct Slot {
+        uint64_t manager;
+        void *participant;
+        std::atomic<bool> *inUse;
+    };
+    std::vector<Slot> slots;
+    uint64_t lastManager = 0;
+    void *lastParticipant = nullptr;
+
+    ~ThreadEpochRecords() {
+        std::lock_guard<std::mutex> lock(liveManagersMtx());
+        for (const auto &slot : slots) {
+            if (liveManagers().count(slot.manager)) {
+                slot.inUse->store(false, std::memory_order_release);
+            }
+        }
+    }
+};
+
+thread_local ThreadEpochRecords threadEpochRecords;
+
+std::atomic<uint64_t> nextEpochManagerId{1};
+
+} // namespace
+
+EpochManager::Guard::Guard(const EpochManager &epochs) {
+    Participant *self = epochs.self();
+    self_ = self;
+    if (self->depth++ == 0) {
+        // seq_cst store: either tryAdvance() sees this reader, or this
+        // reader sees every unlink that preceded the advance
+        self->state.store((epochs.epoch_.load(std::memory_order_seq_cst) << 1) | 1,
+                          std::memory_order_seq_cst);
+    }
+}
+
+EpochManager::Guard::~Guard() {
+    Participant *self = static_cast<Participant*>(self_);
+    if (--self->depth == 0) {
+        self->state.store(0, std::memory_order_release);
+    }
+}
+
+EpochManager::EpochManager(size_t collectThreshold)
+    : id_(nextEpochManagerId.fetch_add(1)), threshold_(std::max<size_t>(collectThreshold, 1))
+{
+    std::lock_guard<std::mutex> lock(liveManagersMtx());
+    liveManagers().insert(id_);
+}
+
+EpochManager::~EpochManager() {
+    {
+        std::lock_guard<std::mutex> lock(liveManagersMtx());
+        liveManagers().erase(id_);
+    }
+    for (auto &bucket : limbo_) {
+        release(bucket);
+    }
+    Participant *p = participants_.load(std::memory_order_acquire);
+    while (p != nullptr) {
+        Participant *next = p->next;
+        delete p;
+        p = next;
+    }
+}
+
+EpochManager::Participant* EpochManager::self() const {
+    ThreadEpochRecords &records = threadEpochRecords;
+    if (records.lastManager == id_) {
+        return static_cast<Participant*>(records.lastParticipant);
+    }
+    for (const auto &slot : records.slots) {
+        if (slot.manager == id_) {
+            records.lastManager = id_;
+            records.lastParticipant = slot.participant;
+            return static_cast<Participant*>(slot.participant);
+        }
+    }
+    {
+        // Forget managers destroyed since this thread last registered
+        std::lock_guard<std::mutex> lock(liveManagersMtx());
+        auto &slots = records.slots;
+        for (size_t i = 0; i < slots.size();) {
+            if (!liveManagers().count(slots[i].manager)) {
+                slots[i] = slots.back();
+                slots.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+    // Reuse a record left by an exited thread, else publish a new one
+    Participant *self = nullptr;
+    for (Participant *p = participants_.load(std::memory_order_acquire); p; p = p->next) {
+        bool idle = false;
+        if (p->inUse.compare_exchange_strong(idle, true, std::memory_order_acq_rel)) {
+            self = p;
+            break;
+        }
+    }
+    if (self == nullptr) {
+        self = new Participant();
+        self->next = participants_.load(std::memory_order_relaxed);
+        while (!participants_.compare_exchange_weak(self->next, self,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed)) {
+        }
+    }
+    records.slots.push_back({id_, self, &self->inUse});
+    records.lastManager = id_;
+    records.lastParticipant = self;
+    return self;
+}
+
+bool EpochManager::tryAdvance() {
+    uint64_t global = epoch_.load(std::memory_order_seq_cst);
+    for (Participant *p = participants_.load(std::memory_order_acquire); p; p = p->next) {
+        const uint64_t state = p->state.load(std::memory_order_seq_cst);
+        if ((state & 1) != 0 && (state >> 1) != global) {
+            return false;
+        }
+    }
+    return epoch_.compare_exchange_strong(global, global + 1, std::memory_order_seq_cst);
+}
+
+void EpochManager::release(std::vector<Retired> &batch) {
+    for (auto &r : batch) {
+        r.deleter(r.ptr);
+    }
+    batch.clear();
+}
+
+void EpochManager::retire(void *p, void (*deleter)(void *)) {
+    std::vector<Retired> ready;
+    bool collect;
+    {
+        std::lock_guard<std::mutex> lock(limboMtx_);
+        // Read after p was unlinked: any reader that can still reach p
+        // announced this epoch or an earlier one
+        const uint64_t e = epoch_.load(std::memory_order_seq_cst);
+        const size_t b = e % 3;
+        if (limboEpoch_[b] != e) {
+            // The bucket holds epoch e - 3 or older, safe to free now
+            ready.swap(limbo_[b]);
+            limboCount_ -= ready.size();
+            limboEpoch_[b] = e;
+        }
+        limbo_[b].push_back({p, deleter});
+        collect = ++limboCount_ >= threshold_;
+    }
+    release(ready);
+    if (collect) {
+        tryReclaim();
+    }
+}
+
+void EpochManager::tryReclaim() {
+    if (tryAdvance()) {
+        tryAdvance();
+    }
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> lock(limboMtx_);
+        const uint64_t e = epoch_.load(std::memory_order_seq_cst);
+        for (size_t b = 0; b < 3; ++b) {
+            if (!limbo_[b].empty() && limboEpoch_[b] + 2 <= e) {
+                ready.insert(ready.end(), limbo_[b].begin(), limbo_[b].end());
+                limbo_[b].clear();
+            }
+        }
+        limboCount_ -= ready.size();
+    }
+    release(ready);
+}
+
+size_t EpochManager::pending() const {
+    std::lock_guard<std::mutex> lock(limboMtx_);
+    return limboCount_;
+}
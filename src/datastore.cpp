@@ -1,6 +1,25 @@
 #include "datastore.hpp"
+#include "accelerator.hpp"
+#include "change_feed.hpp"
+#include "trace.hpp"
 #include <functional>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /******************************************************************************
  * ConsistentHashRing
@@ -36,37 +55,858 @@ std::string ConsistentHashRing::getNode(const std::string& key) const {
     return it->second;
 }
 
+std::vector<std::string> ConsistentHashRing::getNodes(const std::string& key, size_t n) const {
+    std::vector<std::string> nodes;
+    if (ring_.empty()) {
+        return nodes;
+    }
+    auto it = ring_.lower_bound(std::hash<std::string>()(key));
+    // One lap at most, skipping further replicas of nodes already chosen
+    for (size_t visited = 0; visited < ring_.size() && nodes.size() < n; ++visited, ++it) {
+        if (it == ring_.end()) {
+            it = ring_.begin();
+        }
+        if (std::find(nodes.begin(), nodes.end(), it->second) == nodes.end()) {
+            nodes.push_back(it->second);
+        }
+    }
+    return nodes;
+}
+
 /******************************************************************************
  * ConcurrentHashMap
  *****************************************************************************/
-void ConcurrentHashMap::put(const std::string &key, const std::string &value) {
-    std::lock_guard<std::mutex> lg(mtx_);
-    kvStore_[key] = value;
+ConcurrentHashMap::ConcurrentHashMap() : ConcurrentHashMap(Options()) {}
+
+ConcurrentHashMap::ConcurrentHashMap(const Options &opts)
+    : opts_(opts),
+      shards_(new Shard[std::max<size_t>(opts.numShards, 1)]),
+      shardBudget_(0)
+{
+    opts_.numShards = std::max<size_t>(opts.numShards, 1);
+    const uint64_t now = nowMs();
+    if (opts_.maxMemoryBytes > 0) {
+        shardBudget_ = std::max<size_t>(opts_.maxMemoryBytes / opts_.numShards, 1);
+    }
+    for (size_t i = 0; i < opts_.numShards; ++i) {
+        shards_[i].wheel = TimingWheel(now);
+        if (shardBudget_ > 0) {
+            shards_[i].policy = opts_.evictionFactory
+                ? opts_.evictionFactory()
+                : EvictionPolicy::create(opts_.eviction, shardBudget_ / 128);
+        }
+    }
+    if (opts_.engine == Engine::ART) {
+        art_ = std::make_unique<AdaptiveRadixTree>();
+    } else if (opts_.orderedIndex) {
+        index_ = std::make_unique<OrderedKeyIndex>();
+    }
+    if (MetricsRegistry *m = opts_.metrics) {
+        static const char *kOpsHelp = "Map operations by type";
+        counters_.gets = &m->counter("kv_ops_total{op=\"get\"}", kOpsHelp);
+        counters_.puts = &m->counter("kv_ops_total{op=\"put\"}", kOpsHelp);
+        counters_.removes = &m->counter("kv_ops_total{op=\"remove\"}", kOpsHelp);
+        counters_.cas = &m->counter("kv_ops_total{op=\"cas\"}", kOpsHelp);
+        counters_.increments = &m->counter("kv_ops_total{op=\"incr\"}", kOpsHelp);
+        counters_.appends = &m->counter("kv_ops_total{op=\"append\"}", kOpsHelp);
+        counters_.commits = &m->counter("kv_ops_total{op=\"commit\"}", kOpsHelp);
+        counters_.getMisses = &m->counter("kv_get_misses_total", "Gets that found no live key");
+        counters_.conflicts = &m->counter("kv_conflicts_total",
+                                          "CAS and transaction commits rejected on a version mismatch");
+        counters_.expired = &m->counter("kv_expired_total", "Keys removed by TTL expiry");
+    }
+}
+
+size_t ConcurrentHashMap::shardIndex(const std::string &key) const {
+    return std::hash<std::string>()(key) % opts_.numShards;
+}
+
+ConcurrentHashMap::Shard& ConcurrentHashMap::shardFor(const std::string &key) const {
+    return shards_[shardIndex(key)];
+}
+
+size_t ConcurrentHashMap::entryBytes(const std::string &key, const Entry &entry) {
+    return key.size() + entry.value.size() + kEntryOverhead;
+}
+
+ConcurrentHashMap::Entry* ConcurrentHashMap::findEntry(Shard &shard, const std::string &key,
+                                                       const std::string **storedKey) const {
+    if (art_) {
+        ArtLeaf *leaf = art_->lookup(key);
+        if (leaf == nullptr) {
+            return nullptr;
+        }
+        if (storedKey != nullptr) {
+            *storedKey = &leaf->key;
+        }
+        return &static_cast<ArtEntry*>(leaf)->entry;
+    }
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+        return nullptr;
+    }
+    if (storedKey != nullptr) {
+        *storedKey = &it->first;
+    }
+    return &it->second;
+}
+
+ConcurrentHashMap::Entry& ConcurrentHashMap::upsertEntry(Shard &shard, const std::string &key,
+                                                         bool &created,
+                                                         const std::string **storedKeyOut) {
+    const std::string *storedKey = nullptr;
+    Entry *existing = findEntry(shard, key, &storedKey);
+    created = existing == nullptr;
+    if (existing != nullptr) {
+        if (storedKeyOut != nullptr) {
+            *storedKeyOut = storedKey;
+        }
+        return *existing;
+    }
+    Entry *entry;
+    if (art_) {
+        // Writers of this key are serialized by the shard lock, so it cannot race in
+        ArtEntry *leaf = new ArtEntry(key, Entry());
+        art_->insert(leaf);
+        storedKey = &leaf->key;
+        entry = &leaf->entry;
+    } else {
+        auto it = shard.map.emplace(key, Entry()).first;
+        if (index_) {
+            index_->insert(key);
+        }
+        storedKey = &it->first;
+        entry = &it->second;
+    }
+    track(shard, *storedKey, *entry);
+    if (storedKeyOut != nullptr) {
+        *storedKeyOut = storedKey;
+    }
+    return *entry;
+}
+
+void ConcurrentHashMap::setExpiry(Shard &shard, const std::string &storedKey, Entry &entry,
+                                  uint64_t expireAtMs) {
+    if (expireAtMs == 0) {
+        if (entry.timer != nullptr) {
+            shard.wheel.cancel(entry.timer);
+            entry.timer = nullptr;
+            shard.bytes -= TimingWheel::kTimerBytes;
+        }
+    } else if (entry.timer == nullptr) {
+        entry.timer = shard.wheel.schedule(&storedKey, expireAtMs);
+        shard.bytes += TimingWheel::kTimerBytes;
+    } else if (expireAtMs != entry.timer->expireAtMs) {
+        shard.wheel.reschedule(entry.timer, expireAtMs);
+    }
+}
+
+void ConcurrentHashMap::track(Shard &shard, const std::string &storedKey, Entry &entry) {
+    shard.bytes += entryBytes(storedKey, entry);
+    if (shard.policy) {
+        entry.meta.slot = static_cast<uint32_t>(shard.residents.size());
+        shard.residents.push_back({&storedKey, &entry.meta});
+        shard.policy->onInsert(storedKey, entry.meta);
+    }
+}
+
+void ConcurrentHashMap::untrack(Shard &shard, const std::string &storedKey, Entry &entry) {
+    shard.bytes -= entryBytes(storedKey, entry);
+    if (shard.policy) {
+        shard.policy->onRemove(entry.meta);
+        // Swap-remove keeps the resident table dense for sampling
+        Resident &hole = shard.residents[entry.meta.slot];
+        hole = shard.residents.back();
+        hole.meta->slot = entry.meta.slot;
+        shard.residents.pop_back();
+    }
+}
+
+bool ConcurrentHashMap::eraseEntry(Shard &shard, const std::string &key, uint64_t version) {
+    const std::string *storedKey = nullptr;
+    Entry *entry = nullptr;
+    std::unordered_map<std::string, Entry>::iterator it;
+    if (art_) {
+        if (ArtLeaf *leaf = art_->lookup(key)) {
+            storedKey = &leaf->key;
+            entry = &static_cast<ArtEntry*>(leaf)->entry;
+        }
+    } else {
+        it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            storedKey = &it->first;
+            entry = &it->second;
+        }
+    }
+    if (entry == nullptr || (version != 0 && entry->deleted)) {
+        return false;
+    }
+    if (version != 0) {
+        preserve(shard, key, *entry, version);
+        if (entry->history) {
+            // An open snapshot can still read an older version of this key
+            shard.bytes -= entry->value.size();
+            std::string().swap(entry->value);
+            entry->version = version;
+            setExpiry(shard, *storedKey, *entry, 0);
+            entry->deleted = true;
+            ++shard.tombstones;
+            return true;
+        }
+    }
+    if (entry->deleted) {
+        --shard.tombstones;
+    }
+    shard.retained -= trimHistory(*entry, std::numeric_limits<uint64_t>::max());
+    setExpiry(shard, *storedKey, *entry, 0);
+    untrack(shard, *storedKey, *entry);
+    if (art_) {
+        return art_->remove(key);
+    }
+    shard.map.erase(it);
+    if (index_) {
+        index_->remove(key);
+    }
+    return true;
+}
+
+void ConcurrentHashMap::evictIfOverBudget(Shard &shard, Entry &justWritten) {
+    int retries = 0;
+    while (shard.bytes > shardBudget_ && shard.residents.size() > 1) {
+        const size_t victim = shard.policy->selectVictim(shard.residents);
+        if (shard.residents[victim].meta == &justWritten.meta) {
+            // Never evict the write being made; refresh it and ask again
+            if (++retries > 4) {
+                break;
+            }
+            shard.policy->onAccess(*shard.residents[victim].key, justWritten.meta);
+            continue;
+        }
+        // Copy: erasing frees the stored key
+        const std::string key = *shard.residents[victim].key;
+        // A tombstone only frees the history kept for snapshots: the key is
+        // already gone, so it is neither counted nor reported again
+        const bool live = !findEntry(shard, key)->deleted;
+        eraseEntry(shard, key, 0);
+        if (live) {
+            ++shard.evictions;
+            if (opts_.onErase) {
+                opts_.onErase(key);
+            }
+        }
+    }
+}
+
+ConcurrentHashMap::Entry* ConcurrentHashMap::liveEntry(Shard &shard, const std::string &key) const {
+    Entry *entry = findEntry(shard, key);
+    return entry == nullptr || entry->deleted || entry->expired(nowMs()) ? nullptr : entry;
+}
+
+ConcurrentHashMap::StoredValue ConcurrentHashMap::encode(const std::string &value) const {
+    StoredValue stored;
+    if (opts_.compressMinBytes == 0 || value.size() < opts_.compressMinBytes ||
+        !lzCompress(value, stored.bytes, opts_.compressionDictionary.get())) {
+        stored.bytes = value;
+        return stored;
+    }
+    stored.codec = opts_.compressionDictionary ? Codec::LZDict : Codec::LZ;
+    return stored;
+}
+
+void ConcurrentHashMap::decode(const std::string &bytes, Codec codec, std::string &out) const {
+    if (codec == Codec::None) {
+        out = bytes;
+        return;
+    }
+    // Only this map wrote these bytes, so a failure means memory corruption
+    const bool ok = lzDecompress(bytes.data(), bytes.size(), out,
+                                 codec == Codec::LZDict ? opts_.compressionDictionary.get() : nullptr);
+    CHECK_RET(ok, "Corrupt compressed value");
+}
+
+ConcurrentHashMap::Entry& ConcurrentHashMap::storeEntry(Shard &shard, const std::string &key,
+                                                        StoredValue value,
+                                                        uint64_t expireAtMs, uint64_t version) {
+    bool created;
+    const std::string *storedKey;
+    Entry &entry = upsertEntry(shard, key, created, &storedKey);
+    if (!created) {
+        preserve(shard, key, entry, version);
+        if (entry.deleted) {
+            entry.deleted = false;
+            --shard.tombstones;
+        }
+    }
+    shard.bytes += value.bytes.size();
+    shard.bytes -= entry.value.size();
+    entry.value = std::move(value.bytes);
+    entry.codec = value.codec;
+    entry.version = version;
+    setExpiry(shard, *storedKey, entry, expireAtMs);
+    if (shard.policy) {
+        if (!created) {
+            shard.policy->onAccess(key, entry.meta);
+        }
+        evictIfOverBudget(shard, entry);
+    }
+    return entry;
+}
+
+void ConcurrentHashMap::put(const std::string &key, const std::string &value,
+                            uint64_t expireAtMs, const WriteHook &onWrite,
+                            const RemoveHook &onRemove) {
+    TRACE_SCOPE("kv.put");
+    bump(counters_.puts);
+    StoredValue stored = encode(value);
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lg(shard.mtx);
+    if (expireAtMs != 0 && expireAtMs <= nowMs()) {
+        eraseEntry(shard, key, nextVersion());
+        if (onRemove) {
+            onRemove(key);
+        }
+        return;
+    }
+    storeEntry(shard, key, std::move(stored), expireAtMs, nextVersion());
+    if (onWrite) {
+        onWrite(key, value, expireAtMs);
+    }
 }
 
 bool ConcurrentHashMap::get(const std::string &key, std::string &outVal) const {
-    std::lock_guard<std::mutex> lg(mtx_);
-    auto it = kvStore_.find(key);
-    if (it != kvStore_.end()) {
-        outVal = it->second;
+    uint64_t version;
+    return get(key, outVal, version);
+}
+
+bool ConcurrentHashMap::get(const std::string &key, std::string &outVal,
+                            uint64_t &version) const {
+    TRACE_SCOPE("kv.get");
+    bump(counters_.gets);
+    Codec codec;
+    std::string stored;
+    {
+        Shard &shard = shardFor(key);
+        std::lock_guard<std::mutex> lg(shard.mtx);
+        Entry *entry = liveEntry(shard, key);
+        if (entry == nullptr) {
+            bump(counters_.getMisses);
+            return false;
+        }
+        if (shard.policy) {
+            shard.policy->onAccess(key, entry->meta);
+        }
+        codec = entry->codec;
+        (codec == Codec::None ? outVal : stored) = entry->value;
+        version = entry->version;
+    }
+    // Decompress lazily, outside the shard lock
+    if (codec != Codec::None) {
+        decode(stored, codec, outVal);
+    }
+    return true;
+}
+
+bool ConcurrentHashMap::getStored(const std::string &key, std::string &bytes, Codec &codec) const {
+    bump(counters_.gets);
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lg(shard.mtx);
+    Entry *entry = liveEntry(shard, key);
+    if (entry == nullptr) {
+        bump(counters_.getMisses);
+        return false;
+    }
+    if (shard.policy) {
+        shard.policy->onAccess(key, entry->meta);
+    }
+    bytes = entry->value;
+    codec = entry->codec;
+    return true;
+}
+
+bool ConcurrentHashMap::compareAndSwap(const std::string &key, uint64_t expectedVersion,
+                                       const std::string &value, uint64_t &newVersion,
+                                       const WriteHook &onWrite) {
+    bump(counters_.cas);
+    StoredValue stored = encode(value);
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lg(shard.mtx);
+    Entry *current = liveEntry(shard, key);
+    if ((current == nullptr ? 0 : current->version) != expectedVersion) {
+        bump(counters_.conflicts);
+        return false;
+    }
+    const uint64_t expireAtMs = current == nullptr ? 0 : current->expireAtMs();
+    Entry &entry = storeEntry(shard, key, std::move(stored), expireAtMs, nextVersion());
+    newVersion = entry.version;
+    if (onWrite) {
+        onWrite(key, value, expireAtMs);
+    }
+    return true;
+}
+
+bool ConcurrentHashMap::increment(const std::string &key, int64_t delta, int64_t &result,
+                                  const WriteHook &onWrite) {
+    bump(counters_.increments);
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lg(shard.mtx);
+    Entry *current = liveEntry(shard, key);
+    int64_t base = 0;
+    if (current != nullptr) {
+        // Strict parse: the whole value must be one base-10 integer in range
+        std::string v;
+        decode(current->value, current->codec, v);
+        errno = 0;
+        char *end = nullptr;
+        const long long parsed = std::strtoll(v.c_str(), &end, 10);
+        if (v.empty() || std::isspace(static_cast<unsigned char>(v[0])) ||
+            end != v.c_str() + v.size() || errno == ERANGE) {
+            return false;
+        }
+        base = parsed;
+    }
+    if ((delta > 0 && base > std::numeric_limits<int64_t>::max() - delta) ||
+        (delta < 0 && base < std::numeric_limits<int64_t>::min() - delta)) {
+        return false;
+    }
+    result = base + delta;
+    const uint64_t expireAtMs = current == nullptr ? 0 : current->expireAtMs();
+    const std::string value = std::to_string(result);
+    storeEntry(shard, key, encode(value), expireAtMs, nextVersion());
+    if (onWrite) {
+        onWrite(key, value, expireAtMs);
+    }
+    return true;
+}
+
+size_t ConcurrentHashMap::append(const std::string &key, const std::string &suffix,
+                                 const WriteHook &onWrite) {
+    bump(counters_.appends);
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lg(shard.mtx);
+    Entry *current = liveEntry(shard, key);
+    const uint64_t expireAtMs = current == nullptr ? 0 : current->expireAtMs();
+    std::string value;
+    if (current != nullptr) {
+        decode(current->value, current->codec, value);
+    }
+    value += suffix;
+    storeEntry(shard, key, encode(value), expireAtMs, nextVersion());
+    if (onWrite) {
+        onWrite(key, value, expireAtMs);
+    }
+    return value.size();
+}
+
+bool ConcurrentHashMap::commitBatch(const ReadSet &reads, const std::vector<BatchWrite> &writes,
+                                    const CommitHook &onCommit) {
+    bump(counters_.commits);
+    // Fixed lock order across shards, so concurrent commits cannot deadlock
+    std::vector<size_t> order;
+    for (const auto &r : reads) {
+        order.push_back(shardIndex(r.first));
+    }
+    for (const auto &w : writes) {
+        order.push_back(shardIndex(w.key));
+    }
+    std::sort(order.begin(), order.end());
+    order.erase(std::unique(order.begin(), order.end()), order.end());
+    std::vector<StoredValue> encoded;
+    encoded.reserve(writes.size());
+    for (const auto &w : writes) {
+        encoded.push_back(w.remove ? StoredValue() : encode(w.value));
+    }
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(order.size());
+    for (size_t idx : order) {
+        locks.emplace_back(shards_[idx].mtx);
+    }
+
+    for (const auto &r : reads) {
+        Entry *entry = liveEntry(shardFor(r.first), r.first);
+        if ((entry == nullptr ? 0 : entry->version) != r.second) {
+            bump(counters_.conflicts);
+            return false;
+        }
+    }
+    const uint64_t now = nowMs();
+    // One version for the whole batch: a snapshot sees all of it or none
+    const uint64_t version = nextVersion();
+    // Copied only if some write has already expired and becomes a remove
+    std::vector<BatchWrite> lapsed;
+    for (size_t i = 0; i < writes.size(); ++i) {
+        const BatchWrite &w = writes[i];
+        Shard &shard = shardFor(w.key);
+        if (w.remove) {
+            eraseEntry(shard, w.key, version);
+        } else if (w.expireAtMs != 0 && w.expireAtMs <= now) {
+            eraseEntry(shard, w.key, version);
+            if (lapsed.empty()) {
+                lapsed = writes;
+            }
+            lapsed[i].value.clear();
+            lapsed[i].expireAtMs = 0;
+            lapsed[i].remove = true;
+        } else {
+            storeEntry(shard, w.key, std::move(encoded[i]), w.expireAtMs, version);
+        }
+    }
+    if (onCommit && !writes.empty()) {
+        onCommit(lapsed.empty() ? writes : lapsed);
+    }
+    return true;
+}
+
+bool ConcurrentHashMap::remove(const std::string &key, const RemoveHook &onRemove) {
+    TRACE_SCOPE("kv.remove");
+    bump(counters_.removes);
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lg(shard.mtx);
+    const bool removed = eraseEntry(shard, key, nextVersion());
+    if (onRemove) {
+        onRemove(key);
+    }
+    return removed;
+}
+
+size_t ConcurrentHashMap::size() const {
+    size_t total = art_ ? art_->size() : 0;
+    for (size_t i = 0; i < opts_.numShards; ++i) {
+        std::lock_guard<std::mutex> lg(shards_[i].mtx);
+        total += shards_[i].map.size();
+        total -= shards_[i].tombstones;
+    }
+    return total;
+}
+
+size_t ConcurrentHashMap::memoryUsage() const {
+    size_t total = 0;
+    for (size_t i = 0; i < opts_.numShards; ++i) {
+        std::lock_guard<std::mutex> lg(shards_[i].mtx);
+        total += shards_[i].bytes;
+    }
+    return total;
+}
+
+size_t ConcurrentHashMap::evictions() const {
+    size_t total = 0;
+    for (size_t i = 0; i < opts_.numShards; ++i) {
+        std::lock_guard<std::mutex> lg(shards_[i].mtx);
+        total += shards_[i].evictions;
+    }
+    return total;
+}
+
+size_t ConcurrentHashMap::expire() {
+    static const size_t kBatch = 256;
+    const uint64_t now = nowMs();
+    size_t expired = 0;
+    std::vector<TimingWheel::Timer*> due;
+    for (size_t i = 0; i < opts_.numShards; ++i) {
+        Shard &shard = shards_[i];
+        // A batch at a time, so writers to the shard are not held up for long
+        do {
+            due.clear();
+            std::lock_guard<std::mutex> lg(shard.mtx);
+            shard.wheel.advance(now, due, kBatch);
+            for (TimingWheel::Timer *timer : due) {
+                // Copy: erasing frees the stored key. It also cancels the
+                // fired timer, which still holds the deadline that an erased
+                // version kept for snapshots records
+                const std::string key = *timer->key;
+                if (eraseEntry(shard, key, nextVersion())) {
+                    ++expired;
+                    if (opts_.onErase) {
+                        opts_.onErase(key);
+                    }
+                }
+            }
+        } while (due.size() >= kBatch);
+    }
+    if (counters_.expired != nullptr) {
+        counters_.expired->add(expired);
+    }
+    return expired;
+}
+
+uint64_t ConcurrentHashMap::nowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+bool ConcurrentHashMap::scan(const std::string &start, const std::string &end, size_t limit,
+                             std::vector<std::pair<std::string, std::string>> &out,
+                             std::string &nextCursor) const {
+    return scanWith(start, end, limit, out, nextCursor,
+                    [this](const std::string &key, std::string &value) { return get(key, value); });
+}
+
+bool ConcurrentHashMap::scanWith(const std::string &start, const std::string &end, size_t limit,
+                                 std::vector<std::pair<std::string, std::string>> &out,
+                                 std::string &nextCursor, const ReadFn &read) const {
+    // Callers commonly pass the previous cursor as `start`
+    const std::string from = start;
+    nextCursor.clear();
+    if (!index_ && !art_) {
+        return false;
+    }
+    if (limit == 0) {
+        nextCursor = from;
         return true;
     }
+    // One extra key tells us where the next page starts
+    std::vector<std::string> keys = art_ ? art_->scan(from, end, limit + 1)
+                                         : index_->scan(from, end, limit + 1);
+    if (keys.size() > limit) {
+        nextCursor = keys.back();
+        keys.pop_back();
+    }
+    for (const auto &key : keys) {
+        std::string value;
+        if (read(key, value)) {
+            out.emplace_back(key, std::move(value));
+        }
+    }
+    return true;
+}
+
+/******************************************************************************
+ * ConcurrentHashMap snapshots (MVCC)
+ *****************************************************************************/
+void ConcurrentHashMap::preserve(Shard &shard, const std::string &key, Entry &entry,
+                                 uint64_t version) {
+    if (!entry.history && openSnapshots_.load() == 0) {
+        // A snapshot not counted yet will read clock_ at or after `version`
+        return;
+    }
+    uint64_t oldest = version;
+    uint64_t newest = 0;
+    if (openSnapshots_.load() > 0) {
+        snapshotBounds(oldest, newest);
+    }
+    shard.retained -= trimHistory(entry, oldest);
+    if (newest >= entry.version) {
+        std::unique_ptr<Version> v(new Version());
+        v->value = entry.value;
+        v->codec = entry.codec;
+        v->expireAtMs = entry.expireAtMs();
+        v->version = entry.version;
+        v->supersededAt = version;
+        v->deleted = entry.deleted;
+        v->older = std::move(entry.history);
+        entry.history = std::move(v);
+        ++shard.retained;
+    }
+    if (entry.history && !entry.listed) {
+        entry.listed = true;
+        shard.versioned.push_back(key);
+    }
+}
+
+size_t ConcurrentHashMap::trimHistory(Entry &entry, uint64_t oldest) {
+    // Snapshot s reads a version iff version <= s < supersededAt, and every
+    // open or future snapshot is at least `oldest`
+    std::unique_ptr<Version> *link = &entry.history;
+    while (*link && (*link)->supersededAt > oldest) {
+        link = &(*link)->older;
+    }
+    size_t freed = 0;
+    for (const Version *v = link->get(); v != nullptr; v = v->older.get()) {
+        ++freed;
+    }
+    link->reset();
+    return freed;
+}
+
+bool ConcurrentHashMap::snapshotBounds(uint64_t &oldest, uint64_t &newest) const {
+    std::lock_guard<std::mutex> lock(snapshotMtx_);
+    if (snapshotVersions_.empty()) {
+        return false;
+    }
+    oldest = *snapshotVersions_.begin();
+    newest = *snapshotVersions_.rbegin();
+    return true;
+}
+
+std::unique_ptr<ConcurrentHashMap::Snapshot> ConcurrentHashMap::snapshot() const {
+    // Counted first: a writer that still sees zero has bumped clock_ before
+    // the load below, so this snapshot already includes its write
+    openSnapshots_.fetch_add(1);
+    std::lock_guard<std::mutex> lock(snapshotMtx_);
+    const uint64_t version = clock_.load();
+    snapshotVersions_.insert(version);
+    return std::unique_ptr<Snapshot>(new Snapshot(*this, version, nowMs()));
+}
+
+void ConcurrentHashMap::closeSnapshot(uint64_t version) const {
+    std::lock_guard<std::mutex> lock(snapshotMtx_);
+    snapshotVersions_.erase(snapshotVersions_.find(version));
+    openSnapshots_.fetch_sub(1);
+}
+
+size_t ConcurrentHashMap::collectVersions() {
+    static const size_t kBatch = 256;
+    size_t freed = 0;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < opts_.numShards; ++i) {
+        Shard &shard = shards_[i];
+        {
+            std::lock_guard<std::mutex> lg(shard.mtx);
+            keys.swap(shard.versioned);
+        }
+        // A key erased and re-listed meanwhile can appear twice
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        for (size_t b = 0; b < keys.size(); b += kBatch) {
+            std::lock_guard<std::mutex> lg(shard.mtx);
+            uint64_t oldest = clock_.load();
+            uint64_t newest = 0;
+            if (openSnapshots_.load() > 0) {
+                snapshotBounds(oldest, newest);
+            }
+            for (size_t j = b; j < std::min(keys.size(), b + kBatch); ++j) {
+                Entry *entry = findEntry(shard, keys[j]);
+                if (entry == nullptr || !entry->listed) {
+                    continue;
+                }
+                const size_t trimmed = trimHistory(*entry, oldest);
+                shard.retained -= trimmed;
+                freed += trimmed;
+                if (entry->deleted && !entry->history) {
+                    // Tombstone with nothing left to hide
+                    eraseEntry(shard, keys[j], 0);
+                    ++freed;
+                } else if (entry->history) {
+                    shard.versioned.push_back(keys[j]);
+                } else {
+                    entry->listed = false;
+                }
+            }
+        }
+        keys.clear();
+    }
+    return freed;
+}
+
+size_t ConcurrentHashMap::retainedVersions() const {
+    size_t total = 0;
+    for (size_t i = 0; i < opts_.numShards; ++i) {
+        std::lock_guard<std::mutex> lg(shards_[i].mtx);
+        total += shards_[i].retained;
+    }
+    return total;
+}
+
+bool ConcurrentHashMap::visibleAt(const Entry &entry, uint64_t version, uint64_t wallMs,
+                                  std::string &outVal) const {
+    if (entry.version <= version) {
+        if (entry.deleted || entry.expired(wallMs)) {
+            return false;
+        }
+        decode(entry.value, entry.codec, outVal);
+        return true;
+    }
+    for (const Version *v = entry.history.get(); v != nullptr; v = v->older.get()) {
+        if (v->version <= version) {
+            if (v->deleted || (v->expireAtMs != 0 && v->expireAtMs <= wallMs)) {
+                return false;
+            }
+            decode(v->value, v->codec, outVal);
+            return true;
+        }
+    }
+    // Created after the snapshot
     return false;
 }
 
-bool ConcurrentHashMap::remove(const std::string &key) {
-    std::lock_guard<std::mutex> lg(mtx_);
-    return kvStore_.erase(key) > 0;
+ConcurrentHashMap::Snapshot::~Snapshot() {
+    map_.closeSnapshot(version_);
+}
+
+bool ConcurrentHashMap::Snapshot::get(const std::string &key, std::string &outVal) const {
+    Shard &shard = map_.shardFor(key);
+    std::lock_guard<std::mutex> lg(shard.mtx);
+    const Entry *entry = map_.findEntry(shard, key);
+    return entry != nullptr && map_.visibleAt(*entry, version_, wallMs_, outVal);
+}
+
+bool ConcurrentHashMap::Snapshot::scan(const std::string &start, const std::string &end,
+                                       size_t limit,
+                                       std::vector<std::pair<std::string, std::string>> &out,
+                                       std::string &nextCursor) const {
+    return map_.scanWith(start, end, limit, out, nextCursor,
+                         [this](const std::string &key, std::string &value) {
+                             return get(key, value);
+                         });
+}
+
+void ConcurrentHashMap::Snapshot::forEach(
+    const std::function<void(const std::string &key, const std::string &value)> &fn) const {
+    static const size_t kPage = 1024;
+    std::vector<std::pair<std::string, std::string>> page;
+    if (map_.art_ || map_.index_) {
+        std::string cursor;
+        do {
+            page.clear();
+            scan(cursor, "", kPage, page, cursor);
+            for (const auto &kv : page) {
+                fn(kv.first, kv.second);
+            }
+        } while (!cursor.empty());
+        return;
+    }
+    for (size_t i = 0; i < map_.opts_.numShards; ++i) {
+        Shard &shard = map_.shards_[i];
+        page.clear();
+        {
+            std::lock_guard<std::mutex> lg(shard.mtx);
+            std::string value;
+            for (const auto &kv : shard.map) {
+                if (map_.visibleAt(kv.second, version_, wallMs_, value)) {
+                    page.emplace_back(kv.first, value);
+                }
+            }
+        }
+        // Callbacks run unlocked, so they may touch the map
+        for (const auto &kv : page) {
+            fn(kv.first, kv.second);
+        }
+    }
+}
+
+std::string ConcurrentHashMap::prefixEnd(const std::string &prefix) {
+    std::string end = prefix;
+    while (!end.empty()) {
+        unsigned char last = static_cast<unsigned char>(end.back());
+        if (last != 0xFF) {
+            end.back() = static_cast<char>(last + 1);
+            return end;
+        }
+        end.pop_back();
+    }
+    return end;
 }
 
 /******************************************************************************
  * WriteAheadLog
  *****************************************************************************/
-WriteAheadLog::WriteAheadLog(const std::string &filename)
+WriteAheadLog::WriteAheadLog(const std::string &filename, MetricsRegistry *metrics)
     : filename_(filename)
 {
     walStream_.open(filename_, std::ios::app | std::ios::out);
     CHECK_RET(walStream_.is_open(), "Failed to open WAL file: " + filename_);
+    if (metrics != nullptr) {
+        records_ = &metrics->counter("wal_records_total", "Records appended to the WAL");
+        flushLatency_ = &metrics->histogram("wal_flush_seconds", "Time to flush WAL writes to the OS");
+    }
+}
+
+void WriteAheadLog::flush(size_t records) {
+    TRACE_SCOPE("wal.flush");
+    LatencyHistogram::Timer timer(flushLatency_);
+    walStream_.flush();
+    if (records_ != nullptr) {
+        records_->add(records);
+    }
 }
 
 WriteAheadLog::~WriteAheadLog() {
@@ -75,42 +915,284 @@ WriteAheadLog::~WriteAheadLog() {
     }
 }
 
-void WriteAheadLog::logPut(const std::string &key, const std::string &value) {
+// Values the whitespace-delimited records cannot hold (empty, or containing
+// whitespace such as binary blobs) are logged length-prefixed:
+// "PUTBLOB key expireAtMs len\n" followed by len raw bytes
+static void writeRecord(std::ostream &out, const ConcurrentHashMap::BatchWrite &w) {
+    if (w.remove) {
+        out << "REMOVE " << w.key << "\n";
+    } else if (w.value.empty() || w.value.find_first_of(" \t\r\n\v\f") != std::string::npos) {
+        out << "PUTBLOB " << w.key << " " << w.expireAtMs << " " << w.value.size() << "\n";
+        out.write(w.value.data(), static_cast<std::streamsize>(w.value.size()));
+        out << "\n";
+    } else if (w.expireAtMs != 0) {
+        out << "PUTEX " << w.key << " " << w.expireAtMs << " " << w.value << "\n";
+    } else {
+        out << "PUT " << w.key << " " << w.value << "\n";
+    }
+}
+
+// Longest PUTBLOB body a torn tail may claim, matching the node's blob cap
+static const size_t kMaxTornBlobBytes = 256u << 20;
+
+// Reads the operands of one record whose opcode is op; false if torn or unknown.
+// A failure that leaves in at EOF is a torn tail, anything else is corruption.
+static bool readRecord(std::istream &in, std::streamoff fileBytes, const std::string &op,
+                       ConcurrentHashMap::BatchWrite &w) {
+    if (op == "PUT") {
+        in >> w.key >> w.value;
+    } else if (op == "PUTEX") {
+        // Expiries are absolute, so keys that lapsed while down stay gone
+        in >> w.key >> w.expireAtMs >> w.value;
+    } else if (op == "PUTBLOB") {
+        size_t len = 0;
+        if (in >> w.key >> w.expireAtMs >> len && in.get() == '\n') {
+            // The length comes from the file: never allocate past its end.
+            // A body cut short by a crash runs into EOF; a length no writer
+            // could have produced is corruption.
+            const size_t remaining = static_cast<size_t>(fileBytes - in.tellg());
+            if (len > remaining) {
+                if (len <= kMaxTornBlobBytes) {
+                    in.ignore(std::numeric_limits<std::streamsize>::max());
+                }
+                in.setstate(std::ios::failbit);
+                return false;
+            }
+            w.value.resize(len);
+            in.read(&w.value[0], static_cast<std::streamsize>(len));
+        } else {
+            in.setstate(std::ios::failbit);
+        }
+    } else if (op == "REMOVE") {
+        in >> w.key;
+        w.remove = true;
+    } else {
+        return false;
+    }
+    return static_cast<bool>(in);
+}
+
+void WriteAheadLog::logPut(const std::string &key, const std::string &value,
+                           uint64_t expireAtMs) {
+    TRACE_SCOPE("wal.logPut");
     std::lock_guard<std::mutex> lock(mtx_);
-    walStream_ << "PUT " << key << " " << value << "\n";
-    walStream_.flush();
+    writeRecord(walStream_, {key, value, expireAtMs, false});
+    flush(1);
+    publish({{key, value, expireAtMs, false}});
 }
 
 void WriteAheadLog::logRemove(const std::string &key) {
+    TRACE_SCOPE("wal.logRemove");
     std::lock_guard<std::mutex> lock(mtx_);
     walStream_ << "REMOVE " << key << "\n";
-    walStream_.flush();
+    flush(1);
+    publish({{key, std::string(), 0, true}});
+}
+
+void WriteAheadLog::logBatch(const std::vector<ConcurrentHashMap::BatchWrite> &writes) {
+    TRACE_SCOPE("wal.logBatch");
+    std::ostringstream record;
+    record << "TXN " << writes.size() << "\n";
+    for (const auto &w : writes) {
+        writeRecord(record, w);
+    }
+    record << "COMMIT\n";
+    std::lock_guard<std::mutex> lock(mtx_);
+    walStream_ << record.str();
+    flush(writes.size());
+    publish(writes);
+}
+
+void WriteAheadLog::attachFeed(ChangeFeed *feed) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    feed_ = feed;
+}
+
+uint64_t WriteAheadLog::lastSequence() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return seq_;
+}
+
+void WriteAheadLog::publish(const std::vector<ConcurrentHashMap::BatchWrite> &writes) {
+    if (feed_ == nullptr) {
+        seq_ += writes.size();
+        return;
+    }
+    std::vector<ChangeEvent> events;
+    events.reserve(writes.size());
+    for (const auto &w : writes) {
+        ChangeEvent e;
+        e.seq = ++seq_;
+        e.op = w.remove ? ChangeEvent::Op::Remove : ChangeEvent::Op::Put;
+        e.key = w.key;
+        e.value = w.value;
+        e.expireAtMs = w.expireAtMs;
+        events.push_back(std::move(e));
+    }
+    feed_->append(std::move(events));
 }
 
 void WriteAheadLog::replay(ConcurrentHashMap &store) {
-    std::ifstream in(filename_);
+    std::ifstream in(filename_, std::ios::binary);
     CHECK_RET(in.is_open(), "Failed to open WAL file for replay: " + filename_);
+    std::lock_guard<std::mutex> lock(mtx_);
+    seq_ = 0;
+    in.seekg(0, std::ios::end);
+    const std::streamoff fileBytes = in.tellg();
+    in.seekg(0, std::ios::beg);
+    // End of the last complete record; every record ends in a newline
+    std::streamoff complete = 0;
+    // A record that fails to parse is a torn tail only if it runs into the
+    // end of the file. Anything else (an unknown opcode, a bad TXN count, a
+    // record followed by more bytes) is corruption, and cutting there would
+    // drop the committed records after it.
+    auto expectTornTail = [&]() {
+        CHECK_RET(in.eof(), "Corrupt WAL record at offset " + std::to_string(complete) +
+                                " in " + filename_);
+    };
     std::string cmd;
-    while (true) {
-        if (!(in >> cmd)) {
+    while (in >> cmd) {
+        if (cmd == "TXN") {
+            // Buffer the batch; apply it only once its COMMIT has been read
+            size_t count = 0;
+            in >> count;
+            std::vector<ConcurrentHashMap::BatchWrite> batch;
+            std::string op;
+            for (size_t i = 0; i < count && in >> op; ++i) {
+                ConcurrentHashMap::BatchWrite w;
+                if (!readRecord(in, fileBytes, op, w)) {
+                    break;
+                }
+                batch.push_back(std::move(w));
+            }
+            if (!in || batch.size() != count || !(in >> op) || op != "COMMIT" || in.get() != '\n') {
+                // The batch never committed
+                expectTornTail();
+                break;
+            }
+            store.commitBatch({}, batch);
+            publish(batch);
+            complete = in.tellg();
+            continue;
+        }
+        ConcurrentHashMap::BatchWrite w;
+        if (!readRecord(in, fileBytes, cmd, w) || in.get() != '\n') {
+            expectTornTail();
             break;
         }
-        if (cmd == "PUT") {
-            std::string key, value;
-            in >> key >> value;
-            store.put(key, value);
-        } else if (cmd == "REMOVE") {
-            std::string key;
-            in >> key;
-            store.remove(key);
+        if (w.remove) {
+            store.remove(w.key);
+        } else {
+            store.put(w.key, w.value, w.expireAtMs);
         }
+        publish({w});
+        complete = in.tellg();
+    }
+    // Cut off a torn tail so that records appended from now on follow the
+    // last complete one and are replayed on the next restart
+    struct stat st;
+    if (::stat(filename_.c_str(), &st) == 0 && st.st_size > complete) {
+        walStream_.flush();
+        CHECK_RET(::truncate(filename_.c_str(), complete) == 0,
+                  "Failed to truncate torn WAL tail: " + filename_);
     }
 }
 
+/******************************************************************************
+ * SortedColumnIndex
+ *****************************************************************************/
+void SortedColumnIndex::build(const int *data, size_t size) {
+    std::vector<size_t> order(size);
+    for (size_t i = 0; i < size; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [data](size_t a, size_t b) { return data[a] < data[b]; });
+    values_.resize(size);
+    rows_ = std::move(order);
+    for (size_t i = 0; i < size; ++i) {
+        values_[i] = data[rows_[i]];
+    }
+    deltaValues_.clear();
+    deltaRows_.clear();
+}
+
+void SortedColumnIndex::append(int value, size_t row) {
+    // upper_bound keeps equal values in row order
+    auto pos = std::upper_bound(deltaValues_.begin(), deltaValues_.end(), value);
+    const size_t at = static_cast<size_t>(pos - deltaValues_.begin());
+    deltaValues_.insert(pos, value);
+    deltaRows_.insert(deltaRows_.begin() + at, row);
+
+    // Merge at sqrt(n), but never more often than every 1024 appends
+    const size_t limit = std::max<size_t>(
+        1024, static_cast<size_t>(std::sqrt(static_cast<double>(values_.size()))));
+    if (deltaValues_.size() > limit) {
+        mergeDelta();
+    }
+}
+
+void SortedColumnIndex::mergeDelta() {
+    std::vector<int> values;
+    std::vector<size_t> rows;
+    values.reserve(size());
+    rows.reserve(size());
+    size_t i = 0, j = 0;
+    while (i < values_.size() || j < deltaValues_.size()) {
+        // Delta rows were appended later, so they go after equal main values
+        const bool takeMain = j == deltaValues_.size() ||
+                              (i < values_.size() && values_[i] <= deltaValues_[j]);
+        if (takeMain) {
+            values.push_back(values_[i]);
+            rows.push_back(rows_[i++]);
+        } else {
+            values.push_back(deltaValues_[j]);
+            rows.push_back(deltaRows_[j++]);
+        }
+    }
+    values_ = std::move(values);
+    rows_ = std::move(rows);
+    deltaValues_.clear();
+    deltaRows_.clear();
+}
+
+size_t SortedColumnIndex::countLessThan(int value) const {
+    return static_cast<size_t>(
+        (std::lower_bound(values_.begin(), values_.end(), value) - values_.begin()) +
+        (std::lower_bound(deltaValues_.begin(), deltaValues_.end(), value) - deltaValues_.begin()));
+}
+
+size_t SortedColumnIndex::countInRange(int lo, int hi) const {
+    if (lo >= hi) {
+        return 0;
+    }
+    return countLessThan(hi) - countLessThan(lo);
+}
+
+std::vector<size_t> SortedColumnIndex::rowsInRange(int lo, int hi) const {
+    std::vector<size_t> out;
+    if (lo >= hi) {
+        return out;
+    }
+    auto collect = [&](const std::vector<int> &values, const std::vector<size_t> &rows) {
+        auto first = std::lower_bound(values.begin(), values.end(), lo);
+        auto last = std::lower_bound(first, values.end(), hi);
+        out.insert(out.end(), rows.begin() + (first - values.begin()),
+                   rows.begin() + (last - values.begin()));
+    };
+    collect(values_, rows_);
+    collect(deltaValues_, deltaRows_);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
 /******************************************************************************
  * ColumnarTable
  *****************************************************************************/
 void ColumnarTable::addRow(const std::vector<int> &row) {
+    if (isMapped()) {
+        throw std::logic_error("addRow on memory-mapped ColumnarTable");
+    }
     if (columns_.empty()) {
         columns_.resize(row.size());
     }
@@ -120,77 +1202,240 @@ void ColumnarTable::addRow(const std::vector<int> &row) {
     }
     for (size_t i = 0; i < row.size(); ++i) {
         columns_[i].push_back(row[i]);
+        if (i < indexes_.size() && indexes_[i]) {
+            indexes_[i]->append(row[i], columns_[i].size() - 1);
+        }
+    }
+}
+
+size_t ColumnarTable::countLessThan(const int *data, size_t size, int value) {
+    size_t count = 0;
+    size_t i = 0;
+    // Lane compares yield -1 per match, so subtracting them counts matches.
+    // Lane counters are drained before they can overflow.
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi32(value);
+    while (i + 8 <= size) {
+        __m256i acc = _mm256_setzero_si256();
+        const size_t blockEnd = i + std::min<size_t>((size - i) / 8, 1u << 30) * 8;
+        for (; i < blockEnd; i += 8) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            acc = _mm256_sub_epi32(acc, _mm256_cmpgt_epi32(needle, x));
+        }
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        for (uint32_t lane : lanes) count += lane;
+    }
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi32(value);
+    while (i + 4 <= size) {
+        __m128i acc = _mm_setzero_si128();
+        const size_t blockEnd = i + std::min<size_t>((size - i) / 4, 1u << 30) * 4;
+        for (; i < blockEnd; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            acc = _mm_sub_epi32(acc, _mm_cmplt_epi32(x, needle));
+        }
+        alignas(16) uint32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        for (uint32_t lane : lanes) count += lane;
+    }
+#endif
+    // Scalar tail (or whole column on targets without SSE2)
+    for (; i < size; ++i) {
+        count += static_cast<size_t>(data[i] < value);
     }
+    return count;
 }
 
 size_t ColumnarTable::filterLessThan(size_t colIndex, int value) const {
+    if (hasIndex(colIndex)) {
+        return indexes_[colIndex]->countLessThan(value);
+    }
+    if (isMapped()) {
+        if (colIndex >= mapped_.size()) {
+            return 0;
+        }
+        // Zone maps let whole chunks be counted or skipped without paging them in
+        const MappedColumn &col = mapped_[colIndex];
+        const auto &zones = col.zoneMaps();
+        size_t count = 0;
+        for (size_t c = 0; c < zones.size(); ++c) {
+            const size_t begin = c * col.chunkRows();
+            const size_t rows = std::min(col.chunkRows(), col.size() - begin);
+            if (zones[c].max < value) {
+                count += rows;
+            } else if (zones[c].min < value) {
+                count += countLessThan(col.data() + begin, rows, value);
+            }
+        }
+        return count;
+    }
     if (colIndex >= columns_.size()) {
         return 0;
     }
     const auto &col = columns_[colIndex];
-    size_t count = 0;
-    for (int cell : col) {
-        if (cell < value) {
-            ++count;
-        }
-    }
-    return count;
+    return countLessThan(col.data(), col.size(), value);
 }
 
 const std::vector<int>& ColumnarTable::getColumn(size_t colIndex) const {
     return columns_.at(colIndex);
 }
 
+const int* ColumnarTable::columnData(size_t colIndex) const {
+    if (isMapped()) {
+        return colIndex < mapped_.size() ? mapped_[colIndex].data() : nullptr;
+    }
+    return colIndex < columns_.size() ? columns_[colIndex].data() : nullptr;
+}
+
 size_t ColumnarTable::getNumRows() const {
     // Assuming all columns are same length
+    if (isMapped()) return mapped_[0].size();
     if (columns_.empty()) return 0;
     return columns_[0].size();
 }
 
-/******************************************************************************
- * GPUAcceleratedAnalytics
- *****************************************************************************/
-size_t GPUAcceleratedAnalytics::filterLessThanGPU(const std::vector<int> &col, int value) {
-#ifdef USE_CUDA
-    // Example kernel
-    auto gpuFilterKernel = [] __global__ (const int* d_col, size_t size, int v, int* d_result){
-        int idx = blockIdx.x * blockDim.x + threadIdx.x;
-        if (idx < size) {
-            if (d_col[idx] < v) {
-                atomicAdd(d_result, 1);
-            }
+size_t ColumnarTable::getNumColumns() const {
+    return isMapped() ? mapped_.size() : columns_.size();
+}
+
+static std::string columnFilePath(const std::string &dir, size_t colIndex) {
+    return dir + "/col_" + std::to_string(colIndex) + ".dcol";
+}
+
+bool ColumnarTable::saveColumns(const std::string &dir, size_t chunkRows) const {
+    if (isMapped()) {
+        return false;
+    }
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        const auto &col = columns_[i];
+        if (!ColumnFile::write(columnFilePath(dir, i), col.data(), col.size(), chunkRows)) {
+            return false;
         }
-    };
+    }
+    // Drop stale trailing columns from a previous, wider save
+    for (size_t i = columns_.size(); ; ++i) {
+        if (::remove(columnFilePath(dir, i).c_str()) != 0) {
+            break;
+        }
+    }
+    return true;
+}
 
-    int *d_col = nullptr;
-    int *d_result = nullptr;
-    int h_result = 0;
-    const size_t size = col.size();
+bool ColumnarTable::openMapped(const std::string &dir) {
+    std::vector<MappedColumn> mapped;
+    while (true) {
+        MappedColumn col;
+        if (!col.open(columnFilePath(dir, mapped.size()))) {
+            break;
+        }
+        if (!mapped.empty() && col.size() != mapped[0].size()) {
+            return false;
+        }
+        mapped.push_back(std::move(col));
+    }
+    if (mapped.empty()) {
+        return false;
+    }
+    columns_.clear();
+    indexes_.clear();
+    mapped_ = std::move(mapped);
+    return true;
+}
 
-    cudaMalloc(&d_col, size * sizeof(int));
-    cudaMalloc(&d_result, sizeof(int));
-    cudaMemset(d_result, 0, sizeof(int));
+bool ColumnarTable::isMapped() const {
+    return !mapped_.empty();
+}
 
-    cudaMemcpy(d_col, col.data(), size * sizeof(int), cudaMemcpyHostToDevice);
+size_t ColumnarTable::columnSize(size_t colIndex) const {
+    if (isMapped()) {
+        return colIndex < mapped_.size() ? mapped_[colIndex].size() : 0;
+    }
+    return colIndex < columns_.size() ? columns_[colIndex].size() : 0;
+}
 
-    int blockSize = 256;
-    int gridSize = (size + blockSize - 1) / blockSize;
+bool ColumnarTable::createIndex(size_t colIndex) {
+    const int *data = columnData(colIndex);
+    if (data == nullptr) {
+        return false;
+    }
+    if (indexes_.size() <= colIndex) {
+        indexes_.resize(colIndex + 1);
+    }
+    auto index = std::make_unique<SortedColumnIndex>();
+    index->build(data, columnSize(colIndex));
+    indexes_[colIndex] = std::move(index);
+    return true;
+}
 
-    gpuFilterKernel<<<gridSize, blockSize>>>(d_col, size, value, d_result);
-    cudaMemcpy(&h_result, d_result, sizeof(int), cudaMemcpyDeviceToHost);
+void ColumnarTable::dropIndex(size_t colIndex) {
+    if (colIndex < indexes_.size()) {
+        indexes_[colIndex].reset();
+    }
+}
 
-    cudaFree(d_col);
-    cudaFree(d_result);
+bool ColumnarTable::hasIndex(size_t colIndex) const {
+    return colIndex < indexes_.size() && indexes_[colIndex] != nullptr;
+}
 
-    return static_cast<size_t>(h_result);
-#else
-    // Fallback if no CUDA
-    size_t count = 0;
-    for (auto &v : col) {
-        if (v < value) {
-            ++count;
+size_t ColumnarTable::countInRange(size_t colIndex, int lo, int hi) const {
+    if (hasIndex(colIndex)) {
+        return indexes_[colIndex]->countInRange(lo, hi);
+    }
+    if (lo >= hi) {
+        return 0;
+    }
+    return filterLessThan(colIndex, hi) - filterLessThan(colIndex, lo);
+}
+
+std::vector<size_t> ColumnarTable::rowsInRange(size_t colIndex, int lo, int hi) const {
+    if (hasIndex(colIndex)) {
+        return indexes_[colIndex]->rowsInRange(lo, hi);
+    }
+    std::vector<size_t> rows;
+    const int *data = columnData(colIndex);
+    const size_t size = columnSize(colIndex);
+    for (size_t i = 0; data != nullptr && i < size; ++i) {
+        if (data[i] >= lo && data[i] < hi) {
+            rows.push_back(i);
         }
     }
-    return count;
+    return rows;
+}
+
+/******************************************************************************
+ * GPUAcceleratedAnalytics
+ *****************************************************************************/
+namespace {
+std::mutex g_acceleratorMtx;
+std::shared_ptr<AnalyticsAccelerator> g_accelerator;
+
+std::shared_ptr<AnalyticsAccelerator> makeDefaultAccelerator() {
+#ifdef USE_CUDA
+    if (CudaAccelerator::deviceAvailable()) {
+        return std::make_shared<CudaAccelerator>();
+    }
 #endif
+    return std::make_shared<CpuParallelAccelerator>();
+}
+} // namespace
+
+std::shared_ptr<AnalyticsAccelerator> GPUAcceleratedAnalytics::accelerator() {
+    std::lock_guard<std::mutex> lock(g_acceleratorMtx);
+    if (!g_accelerator) {
+        g_accelerator = makeDefaultAccelerator();
+    }
+    return g_accelerator;
+}
+
+void GPUAcceleratedAnalytics::setAccelerator(std::shared_ptr<AnalyticsAccelerator> accel) {
+    std::lock_guard<std::mutex> lock(g_acceleratorMtx);
+    g_accelerator = std::move(accel);
+}
+
+size_t GPUAcceleratedAnalytics::filterLessThanGPU(const std::vector<int> &col, int value) {
+    return accelerator()->filterLessThan(col.data(), col.size(), value);
 }
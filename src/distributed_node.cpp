@@ -1,16 +1,137 @@
 #include "distributed_node.hpp"
+#include "net_util.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <sys/time.h>
+
+// Largest value PUTBLOB accepts
+static const size_t kMaxBlobBytes = 256u << 20;
+// A stalled blob transfer gives up its worker after this long
+static const int kTransferTimeoutSec = 5;
+
+static std::string putMessage(const std::string &key, const std::string &value, uint64_t ttlMs) {
+    const std::string ttl = ttlMs > 0 ? " PX " + std::to_string(ttlMs) : std::string();
+    if (value.empty() || value.find_first_of(" \t\r\n") != std::string::npos) {
+        return "PUTBLOB " + key + " " + std::to_string(value.size()) + ttl + "\n" + value;
+    }
+    return "PUT " + key + " " + value + ttl + "\n";
+}
+
+// Optional "EX seconds | PX milliseconds" suffix of PUT/PUTBLOB, in ms. With
+// ack, PUT's optional trailing ACK flag is parsed too.
+static uint64_t parseTtl(std::istringstream &args, bool *ack = nullptr) {
+    std::string option;
+    uint64_t ttl = 0;
+    if (!(args >> option)) {
+        return 0;
+    }
+    if (ack != nullptr && option == "ACK") {
+        *ack = true;
+        return 0;
+    }
+    if (!(args >> ttl)) {
+        return 0;
+    }
+    std::string flag;
+    if (ack != nullptr && args >> flag) {
+        *ack = flag == "ACK";
+    }
+    if (option == "EX") {
+        return ttl * 1000;
+    }
+    return option == "PX" ? ttl : 0;
+}
+
+// A CDC sequence number: base-10 digits only. strtoull alone would read
+// "abc" as 0, the oldest retained event, and accept signs and trailing junk.
+static bool parseCursor(const std::string &token, uint64_t &seq) {
+    if (token.empty() || token.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    errno = 0;
+    seq = std::strtoull(token.c_str(), nullptr, 10);
+    return errno != ERANGE;
+}
+
+static ConcurrentHashMap::Options withNodeHooks(ConcurrentHashMap::Options opts,
+                                                MetricsRegistry &metrics,
+                                                std::function<void(const std::string&)> onErase) {
+    opts.metrics = &metrics;
+    if (opts.onErase) {
+        opts.onErase = [caller = std::move(opts.onErase),
+                        node = std::move(onErase)](const std::string &key) {
+            caller(key);
+            node(key);
+        };
+    } else {
+        opts.onErase = std::move(onErase);
+    }
+    return opts;
+}
+
+static LatencyHistogram* queueWait(MetricsRegistry &metrics, const std::string &pool) {
+    return &metrics.histogram("threadpool_queue_wait_seconds{pool=\"" + pool + "\"}",
+                              "Time tasks wait in a worker pool queue");
+}
+
+// With a memory cap, the change feed may hold up to an eighth of it on top
+static size_t feedBytes(const ConcurrentHashMap::Options &opts) {
+    return opts.maxMemoryBytes > 0
+        ? std::min(ChangeFeed::kDefaultRetainBytes, opts.maxMemoryBytes / 8)
+        : ChangeFeed::kDefaultRetainBytes;
+}
+
+static size_t defaultWorkerCount() {
+    size_t n = std::thread::hardware_concurrency();
+    return n == 0 ? 2 : n;
+}
 
 DistributedNode::DistributedNode(const std::string &nodeName,
                                  const std::string &walFile,
-                                 int port)
-    : nodeName_(nodeName), wal_(walFile), port_(port), stop_(false)
+                                 int port,
+                                 const ConcurrentHashMap::Options &storeOptions)
+    : nodeName_(nodeName), dataStore_(withNodeHooks(storeOptions, metrics_,
+          // Expiry and eviction are not logged, so trackers and watchers
+          // hear of them only through this hook
+          [this](const std::string &key) { publishRemove(key); })),
+      changeFeed_(65536, 256, feedBytes(storeOptions)), wal_(walFile, &metrics_),
+      port_(port), serverSock_(-1), stop_(false),
+      queryPool_(defaultWorkerCount(), queueWait(metrics_, "query")), capture_(nullptr),
+      hotKeyThreshold_(32), replicationFactor_(1),
+      replicationPool_(1, queueWait(metrics_, "replication")),
+      transferPool_(2, queueWait(metrics_, "transfer")),
+      queryReplyPool_(2, queueWait(metrics_, "query_reply"))
 {
-    // Replay WAL to restore data
+    registerMetrics();
+
+    // Replay WAL to restore data, keeping its tail for CDC consumers
+    wal_.attachFeed(&changeFeed_);
     wal_.replay(dataStore_);
 
+    // Listen before returning so clients can connect as soon as we exist
+    serverSock_ = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_RET(serverSock_ >= 0, "Failed to create server socket");
+
+    int opt = 1;
+    setsockopt(serverSock_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    addr.sin_addr.s_addr = INADDR_ANY;
+
+    CHECK_RET(bind(serverSock_, (struct sockaddr*)&addr, sizeof(addr)) >= 0,
+              "Failed to bind server socket");
+    CHECK_RET(listen(serverSock_, SOMAXCONN) >= 0, "Failed to listen on server socket");
+
     // Start the server thread
     serverThread_ = std::thread(&DistributedNode::runServer, this);
+    maintenanceThread_ = std::thread(&DistributedNode::runMaintenance, this);
 }
 
 DistributedNode::~DistributedNode() {
@@ -20,73 +141,309 @@ DistributedNode::~DistributedNode() {
     if (serverThread_.joinable()) {
         serverThread_.join();
     }
+    if (maintenanceThread_.joinable()) {
+        maintenanceThread_.join();
+    }
+    // Transfer and replication workers are joined later, during member
+    // destruction, and a PUTBLOB still running publishes through
+    // invalidate(): leave it no closed (or reused) descriptor to send to
+    std::lock_guard<std::mutex> lock(trackingMtx_);
+    for (int sock : trackers_) {
+        close(sock);
+    }
+    trackers_.clear();
+    leasedKeys_.clear();
+}
+
+void DistributedNode::registerMetrics() {
+    static const char *kCommands[] = {
+        "PUT", "REMOVE", "GET", "QUERY", "SCAN", "STATS", "GETS", "CAS", "INCR", "DECR",
+        "APPEND", "TRACK", "WATCH", "PUTBLOB", "GETBLOB", "CDC", "TRACE", "other"};
+    for (const char *cmd : kCommands) {
+        const std::string label = "{cmd=\"" + std::string(cmd) + "\"}";
+        commandMetrics_[cmd] = {
+            cmd,
+            &metrics_.counter("node_requests_total" + label, "Requests served by command"),
+            &metrics_.histogram("node_request_seconds" + label,
+                                "Time from reading a request to finishing its reply")};
+    }
+    replicationLag_ = &metrics_.histogram("node_replication_lag_seconds",
+                                          "Time from queueing a write for replicas to delivering it");
+    replicationFailures_ = &metrics_.counter("node_replication_failures_total",
+                                             "Replica deliveries that failed to connect or send");
+
+    metrics_.gauge("kv_keys", "Live keys in the store", [this] {
+        return static_cast<double>(dataStore_.size());
+    });
+    metrics_.gauge("kv_memory_bytes", "Approximate bytes held by keys and values", [this] {
+        return static_cast<double>(dataStore_.memoryUsage());
+    });
+    metrics_.counter("kv_evictions_total", "Keys evicted to stay under the memory limit", [this] {
+        return static_cast<double>(dataStore_.evictions());
+    });
+    metrics_.gauge("wal_last_sequence", "Sequence number of the newest WAL record", [this] {
+        return static_cast<double>(wal_.lastSequence());
+    });
+    metrics_.gauge("threadpool_pending_tasks{pool=\"query\"}", "Tasks queued in a worker pool", [this] {
+        return static_cast<double>(queryPool_.pending());
+    });
+    metrics_.gauge("threadpool_pending_tasks{pool=\"replication\"}", "Tasks queued in a worker pool", [this] {
+        return static_cast<double>(replicationPool_.pending());
+    });
+    metrics_.gauge("threadpool_pending_tasks{pool=\"transfer\"}", "Tasks queued in a worker pool", [this] {
+        return static_cast<double>(transferPool_.pending());
+    });
+    metrics_.gauge("threadpool_pending_tasks{pool=\"query_reply\"}", "Tasks queued in a worker pool", [this] {
+        return static_cast<double>(queryReplyPool_.pending());
+    });
+    metrics_.gauge("node_watchers", "Connections subscribed with WATCH", [this] {
+        return static_cast<double>(watchers());
+    });
+    metrics_.gauge("node_cdc_consumers", "Connections streaming the change feed", [this] {
+        return static_cast<double>(changeFeed_.consumers());
+    });
+    metrics_.gauge("cdc_retained_bytes", "Approximate bytes held by the change feed window", [this] {
+        return static_cast<double>(changeFeed_.retainedBytes());
+    });
 }
 
-void DistributedNode::put(const std::string &key, const std::string &value) {
-    dataStore_.put(key, value);
-    wal_.logPut(key, value);
+const DistributedNode::CommandMetrics& DistributedNode::commandMetrics(const std::string &cmd) const {
+    auto it = commandMetrics_.find(cmd);
+    return it != commandMetrics_.end() ? it->second : commandMetrics_.at("other");
+}
+
+void DistributedNode::put(const std::string &key, const std::string &value, uint64_t ttlMs) {
+    const uint64_t expireAtMs = ttlMs > 0 ? ConcurrentHashMap::nowMs() + ttlMs : 0;
+    dataStore_.put(key, value, expireAtMs, writeHook(), removeHook());
 }
 
 bool DistributedNode::get(const std::string &key, std::string &outVal) {
+    hotKeys_.record(key);
     return dataStore_.get(key, outVal);
 }
 
 void DistributedNode::removeKey(const std::string &key) {
-    dataStore_.remove(key);
-    wal_.logRemove(key);
+    dataStore_.remove(key, removeHook());
+}
+
+bool DistributedNode::get(const std::string &key, std::string &outVal, uint64_t &version) {
+    hotKeys_.record(key);
+    return dataStore_.get(key, outVal, version);
+}
+
+bool DistributedNode::compareAndSwap(const std::string &key, uint64_t expectedVersion,
+                                     const std::string &value, uint64_t &newVersion) {
+    return dataStore_.compareAndSwap(key, expectedVersion, value, newVersion, writeHook());
+}
+
+bool DistributedNode::increment(const std::string &key, int64_t delta, int64_t &result) {
+    return dataStore_.increment(key, delta, result, writeHook());
+}
+
+size_t DistributedNode::append(const std::string &key, const std::string &suffix) {
+    return dataStore_.append(key, suffix, writeHook());
+}
+
+Transaction DistributedNode::beginTransaction() {
+    return Transaction(dataStore_, [this](const std::vector<ConcurrentHashMap::BatchWrite> &writes) {
+        wal_.logBatch(writes);
+        const uint64_t now = ConcurrentHashMap::nowMs();
+        for (const auto &w : writes) {
+            if (w.remove) {
+                forwardToReplicas(w.key, "REMOVE " + w.key + "\n");
+                publishRemove(w.key);
+                continue;
+            }
+            const uint64_t ttlMs = w.expireAtMs == 0 ? 0
+                                 : (w.expireAtMs > now ? w.expireAtMs - now : 1);
+            forwardToReplicas(w.key, putMessage(w.key, w.value, ttlMs));
+            publishWrite(w.key, w.value);
+        }
+    });
+}
+
+ConcurrentHashMap::WriteHook DistributedNode::writeHook() {
+    return [this](const std::string &key, const std::string &value, uint64_t expireAtMs) {
+        wal_.logPut(key, value, expireAtMs);
+        // Replicas take the result, not the operation, so a replayed or
+        // duplicated forward cannot apply an increment twice
+        uint64_t ttlMs = 0;
+        if (expireAtMs != 0) {
+            const uint64_t now = ConcurrentHashMap::nowMs();
+            ttlMs = expireAtMs > now ? expireAtMs - now : 1;
+        }
+        forwardToReplicas(key, putMessage(key, value, ttlMs));
+        publishWrite(key, value);
+    };
+}
+
+ConcurrentHashMap::RemoveHook DistributedNode::removeHook() {
+    return [this](const std::string &key) {
+        wal_.logRemove(key);
+        forwardToReplicas(key, "REMOVE " + key + "\n");
+        publishRemove(key);
+    };
+}
+
+void DistributedNode::publishWrite(const std::string &key, const std::string &value) {
+    invalidate(key);
+    if (ChangeCaptureStream *capture = capture_.load(std::memory_order_acquire)) {
+        capture->publish(key, value);
+    }
+    watchHub_.publish(key, value, false);
+}
+
+void DistributedNode::publishRemove(const std::string &key) {
+    invalidate(key);
+    watchHub_.publish(key, "", true);
+}
+
+bool DistributedNode::scan(const std::string &start, const std::string &end, size_t limit,
+                           std::vector<std::pair<std::string, std::string>> &out,
+                           std::string &nextCursor) const {
+    return dataStore_.scan(start, end, limit, out, nextCursor);
 }
 
 std::string DistributedNode::getName() const {
     return nodeName_;
 }
 
+std::unique_ptr<ConcurrentHashMap::Snapshot> DistributedNode::snapshot() const {
+    return dataStore_.snapshot();
+}
+
 void DistributedNode::replicateTo(const std::string &targetHost,
                                   int targetPort,
                                   const std::string &key,
                                   const std::string &value)
 {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    CHECK_RET(sock >= 0, "Failed to create socket in replicateTo");
-
-    sockaddr_in servAddr;
-    std::memset(&servAddr, 0, sizeof(servAddr));
-    servAddr.sin_family = AF_INET;
-    servAddr.sin_port = htons(targetPort);
-    servAddr.sin_addr.s_addr = inet_addr(targetHost.c_str());
-
-    int c = connect(sock, (struct sockaddr *)&servAddr, sizeof(servAddr));
-    if (c < 0) {
-        // Could not connect; just close & return
-        close(sock);
+    int sock = connectTo(targetHost, targetPort);
+    if (sock < 0) {
+        // Could not connect; nothing to replicate to
         return;
     }
 
     std::string msg = "PUT " + key + " " + value + "\n";
-    ::send(sock, msg.data(), msg.size(), 0);
+    sendAll(sock, msg);
     close(sock);
 }
 
-void DistributedNode::runServer() {
-    int serverSock = socket(AF_INET, SOCK_STREAM, 0);
-    CHECK_RET(serverSock >= 0, "Failed to create server socket");
+void DistributedNode::setCluster(const std::vector<NodeAddress> &nodes,
+                                 size_t replicationFactor) {
+    std::lock_guard<std::mutex> lock(clusterMtx_);
+    ring_ = ConsistentHashRing();
+    peers_.clear();
+    for (const auto &node : nodes) {
+        ring_.addNode(node.name);
+        peers_[node.name] = node;
+    }
+    replicationFactor_ = replicationFactor;
+}
 
-    int opt = 1;
-    setsockopt(serverSock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+void DistributedNode::forwardToReplicas(const std::string &key, const std::string &msg) {
+    std::vector<NodeAddress> targets;
+    {
+        std::lock_guard<std::mutex> lock(clusterMtx_);
+        if (replicationFactor_ <= 1) {
+            return;
+        }
+        // Replicas receive writes from the owner only, so they never re-forward
+        std::vector<std::string> replicas = ring_.getNodes(key, replicationFactor_);
+        if (replicas.empty() || replicas[0] != nodeName_) {
+            return;
+        }
+        for (size_t i = 1; i < replicas.size(); ++i) {
+            targets.push_back(peers_[replicas[i]]);
+        }
+    }
+    const auto queued = std::chrono::steady_clock::now();
+    replicationPool_.enqueue([this, targets, msg, queued]() {
+        // Replicas apply PUTBLOB off their accept thread; waiting for its OK
+        // keeps a later write to the same key from overtaking it
+        const bool blob = msg.compare(0, 8, "PUTBLOB ") == 0;
+        for (const auto &target : targets) {
+            int sock = connectTo(target.host, target.port);
+            if (sock < 0) {
+                replicationFailures_->add();
+                continue;
+            }
+            if (!sendAll(sock, msg)) {
+                replicationFailures_->add();
+            } else if (blob) {
+                SocketReader reader(sock);
+                std::string ack;
+                reader.readLine(ack);
+            }
+            close(sock);
+        }
+        // Lag: queued here until the last replica has the write
+        replicationLag_->record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - queued).count()));
+    });
+}
 
-    sockaddr_in addr;
-    std::memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port_);
-    addr.sin_addr.s_addr = INADDR_ANY;
+bool DistributedNode::enableChangeCapture(std::vector<CaptureColumn> columns,
+                                          char delimiter) {
+    std::lock_guard<std::mutex> lock(captureMtx_);
+    if (captureOwner_) {
+        return false;
+    }
+    captureOwner_ = std::make_unique<ChangeCaptureStream>(std::move(columns), delimiter);
+    capture_.store(captureOwner_.get(), std::memory_order_release);
+    return true;
+}
 
-    CHECK_RET(bind(serverSock, (struct sockaddr*)&addr, sizeof(addr)) >= 0,
-              "Failed to bind server socket");
-    CHECK_RET(listen(serverSock, 10) >= 0, "Failed to listen on server socket");
+ChangeCaptureStream* DistributedNode::changeCapture() const {
+    return capture_.load(std::memory_order_acquire);
+}
+
+std::vector<HotKey> DistributedNode::hotKeys(size_t n) const {
+    return hotKeys_.top(n);
+}
+
+void DistributedNode::setHotKeyThreshold(uint64_t minCount) {
+    hotKeyThreshold_.store(minCount, std::memory_order_relaxed);
+}
+
+bool DistributedNode::leaseIfHot(const std::string &key) {
+    std::lock_guard<std::mutex> lock(trackingMtx_);
+    if (trackers_.empty() ||
+        !hotKeys_.isHot(key, hotKeyThreshold_.load(std::memory_order_relaxed))) {
+        return false;
+    }
+    // Leased before the value is read, so a racing write always invalidates
+    leasedKeys_.insert(key);
+    return true;
+}
+
+void DistributedNode::invalidate(const std::string &key) {
+    std::lock_guard<std::mutex> lock(trackingMtx_);
+    if (leasedKeys_.erase(key) == 0) {
+        return;
+    }
+    const std::string msg = "INVALIDATE " + key + "\n";
+    for (size_t i = 0; i < trackers_.size();) {
+        // A tracker that cannot take the message right now is dropped; the
+        // client then discards its whole near-cache, which is always safe
+        ssize_t n = ::send(trackers_[i], msg.data(), msg.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n != static_cast<ssize_t>(msg.size())) {
+            close(trackers_[i]);
+            trackers_[i] = trackers_.back();
+            trackers_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+    if (trackers_.empty()) {
+        leasedKeys_.clear();
+    }
+}
 
+void DistributedNode::runServer() {
     while (!stop_) {
         sockaddr_in clientAddr;
         socklen_t clientLen = sizeof(clientAddr);
-        int clientSock = accept(serverSock, (struct sockaddr*)&clientAddr, &clientLen);
+        int clientSock = accept(serverSock_, (struct sockaddr*)&clientAddr, &clientLen);
         if (clientSock < 0) {
             if (stop_) {
                 break;
@@ -95,42 +452,377 @@ void DistributedNode::runServer() {
         }
         handleClient(clientSock);
     }
-    close(serverSock);
+    close(serverSock_);
+}
+
+void DistributedNode::runMaintenance() {
+    static const auto kTick = std::chrono::milliseconds(10);
+    static const int kTicksPerDecay = 1000;
+    int ticks = 0;
+    while (!stop_) {
+        dataStore_.expire();
+        dataStore_.collectVersions();
+        if (++ticks == kTicksPerDecay) {
+            hotKeys_.decay();
+            ticks = 0;
+        }
+        std::this_thread::sleep_for(kTick);
+    }
 }
 
 void DistributedNode::handleClient(int clientSock) {
-    char buffer[1024];
-    std::memset(buffer, 0, sizeof(buffer));
-    int bytesRead = static_cast<int>(recv(clientSock, buffer, sizeof(buffer) - 1, 0));
-    if (bytesRead > 0) {
-        std::string request(buffer, bytesRead);
+    SocketReader reader(clientSock);
+    std::string request;
+    if (reader.readLine(request)) {
         std::istringstream iss(request);
         std::string cmd;
         iss >> cmd;
+        const CommandMetrics &m = commandMetrics(cmd);
+        m.requests->add();
+        // Blob transfers and queries are timed on their worker instead
+        const bool blob = cmd == "PUTBLOB" || cmd == "GETBLOB";
+        const bool offloaded = blob || cmd == "QUERY";
+        LatencyHistogram::Timer timer(offloaded ? nullptr : m.latency);
+        TRACE_SCOPE(m.name);
         if (cmd == "PUT") {
+            // PUT key value [EX seconds | PX milliseconds] [ACK]; with ACK,
+            // replies OK once the write is stored and logged
             std::string key, value;
+            bool ack = false;
             iss >> key >> value;
-            put(key, value);
+            put(key, value, parseTtl(iss, &ack));
+            if (ack) {
+                sendAll(clientSock, "OK\n");
+            }
         } else if (cmd == "REMOVE") {
             std::string key;
             iss >> key;
             removeKey(key);
         } else if (cmd == "GET") {
-            std::string key;
-            iss >> key;
+            // GET key [TRACKED]: TRACKED comes from clients holding a TRACK
+            // connection here, the only ones told about invalidations
+            std::string key, mode;
+            iss >> key >> mode;
             std::string val;
-            if (get(key, val)) {
-                std::string resp = "VALUE " + val + "\n";
+            const bool cacheable = mode == "TRACKED" && leaseIfHot(key);
+            if (!get(key, val)) {
+                std::string resp = "NOT_FOUND\n";
                 ::send(clientSock, resp.data(), resp.size(), 0);
+            } else if (!tokenSafe(val)) {
+                // The reply is parsed as tokens, so "a b" would read back as "a"
+                sendAll(clientSock, "ERROR binary value, use GETBLOB\n");
             } else {
-                std::string resp = "NOT_FOUND\n";
+                // CACHE: the reader may keep the value until it sees INVALIDATE
+                std::string resp = "VALUE " + val + (cacheable ? " CACHE\n" : "\n");
                 ::send(clientSock, resp.data(), resp.size(), 0);
             }
+        } else if (cmd == "SCAN") {
+            handleScan(clientSock, iss);
+        } else if (cmd == "STATS") {
+            handleStats(clientSock, iss);
+        } else if (cmd == "GETS" || cmd == "CAS" || cmd == "INCR" || cmd == "DECR" ||
+                   cmd == "APPEND") {
+            handleAtomic(clientSock, cmd, iss);
+        } else if (cmd == "TRACK") {
+            // Keep the connection open for INVALIDATE pushes
+            if (sendAll(clientSock, "OK\n")) {
+                std::lock_guard<std::mutex> lock(trackingMtx_);
+                trackers_.push_back(clientSock);
+                return;
+            }
+        } else if (cmd == "WATCH") {
+            // WATCH <key|prefix*>: the hub acknowledges and then owns the socket
+            std::string pattern;
+            if (iss >> pattern) {
+                watchHub_.subscribe(clientSock, pattern);
+                return;
+            }
+            sendAll(clientSock, "ERROR usage: WATCH <key|prefix*>\n");
+        } else if (blob) {
+            // Multi-megabyte bodies on slow connections would stall the
+            // accept loop, so transfers run on their own workers
+            transferPool_.enqueue([this, clientSock, reader, request, latency = m.latency,
+                                   name = m.name]() mutable {
+                LatencyHistogram::Timer timer(latency);
+                TRACE_SCOPE(name);
+                handleBlob(clientSock, reader, request);
+                close(clientSock);
+            });
+            return;
+        } else if (cmd == "QUERY") {
+            // Large SELECTs stream for as long as the client reads, so they
+            // run on their own workers rather than hold up the accept loop
+            // or blob transfers
+            queryReplyPool_.enqueue([this, clientSock, request, latency = m.latency,
+                                   name = m.name]() {
+                LatencyHistogram::Timer timer(latency);
+                TRACE_SCOPE(name);
+                handleQuery(clientSock, request);
+                close(clientSock);
+            });
+            return;
+        } else if (cmd == "TRACE") {
+            // TRACE: "TRACE len" then len bytes of Chrome trace JSON
+            if (kTracingEnabled) {
+                const std::string json = traceChromeJson();
+                sendAll(clientSock, "TRACE " + std::to_string(json.size()) + "\n", json.data(), json.size());
+            } else {
+                sendAll(clientSock, "ERROR tracing disabled\n");
+            }
+        } else if (cmd == "CDC") {
+            if (handleChangeFeed(clientSock, iss)) {
+                return;
+            }
         }
     }
     close(clientSock);
 }
 
+void DistributedNode::handleQuery(int clientSock, const std::string &request) {
+    AnalyticsQuery query;
+    if (!AnalyticsQuery::parse(request, query)) {
+        sendAll(clientSock, "ERROR malformed query\n");
+        return;
+    }
+    ChangeCaptureStream *capture = changeCapture();
+    if (capture == nullptr) {
+        sendAll(clientSock, "ERROR analytics disabled\n");
+        return;
+    }
+    auto resolve = [capture](const std::string &name) { return capture->columnIndex(name); };
+    // Each window of rows is scanned under the table's shared lock and sent
+    // after it is released, so a slow reader only ties up this worker; the
+    // send timeout drops a reader that stops altogether
+    timeval timeout{kTransferTimeoutSec, 0};
+    setsockopt(clientSock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    queryResponse([capture](const std::function<void(const ColumnarTable &)> &f) { capture->withTable(f); },
+                  query, resolve, &queryPool_,
+                  [clientSock](const std::string &piece) { return sendAll(clientSock, piece); });
+}
+
+/**
+ * PUTBLOB key len [EX seconds | PX milliseconds], then len raw bytes; replies OK
+ * GETBLOB key [LZ]; replies "BLOB len" then len raw bytes, or NOT_FOUND.
+ * With LZ, a value stored compressed without a dictionary is sent as is,
+ * as "BLOB len LZ" and the lzCompress encoding, for the client to decode.
+ * Values may hold any bytes. The body is read into one buffer without passing
+ * through the SocketReader staging buffer; storing, logging and forwarding it
+ * then copy it as for any PUT. Replies send header and value with one gather
+ * write.
+ */
+void DistributedNode::handleBlob(int clientSock, SocketReader &reader, const std::string &request) {
+    timeval timeout{kTransferTimeoutSec, 0};
+    setsockopt(clientSock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(clientSock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    std::istringstream iss(request);
+    std::string cmd, key;
+    iss >> cmd >> key;
+    if (cmd == "GETBLOB") {
+        std::string val, accept;
+        Codec codec = Codec::None;
+        iss >> accept;
+        hotKeys_.record(key);
+        if (!dataStore_.getStored(key, val, codec)) {
+            sendAll(clientSock, "NOT_FOUND\n");
+            return;
+        }
+        const bool passThrough = codec == Codec::LZ && accept == "LZ";
+        if (codec != Codec::None && !passThrough) {
+            std::string stored;
+            stored.swap(val);
+            CHECK_RET(lzDecompress(stored.data(), stored.size(), val,
+                                   dataStore_.compressionDictionary()),
+                      "Corrupt compressed value");
+        }
+        sendAll(clientSock, "BLOB " + std::to_string(val.size()) + (passThrough ? " LZ\n" : "\n"),
+                val.data(), val.size());
+        return;
+    }
+    size_t len = 0;
+    if (key.empty() || !(iss >> len)) {
+        sendAll(clientSock, "ERROR usage: PUTBLOB key len [EX seconds | PX milliseconds]\n");
+        return;
+    }
+    if (len > kMaxBlobBytes) {
+        sendAll(clientSock, "ERROR value too large\n");
+        return;
+    }
+    const uint64_t ttl = parseTtl(iss);
+    std::string value(len, '\0');
+    if (len > 0 && !reader.readExact(&value[0], len)) {
+        // Peer hung up or stalled mid-body: nothing is stored
+        return;
+    }
+    put(key, value, ttl);
+    sendAll(clientSock, "OK\n");
+}
+
+/**
+ * CDC <fromSeq|->
+ * Replies "OK <seq>" and then streams "CHANGE" lines from seq on the same
+ * connection. 0 starts at the oldest retained event, "-" after the newest.
+ * True if the change feed took over the socket.
+ */
+bool DistributedNode::handleChangeFeed(int clientSock, std::istringstream &args) {
+    std::string from;
+    uint64_t seq = 0;
+    if (!(args >> from) || (from != "-" && !parseCursor(from, seq))) {
+        sendAll(clientSock, "ERROR usage: CDC <fromSeq|->\n");
+        return false;
+    }
+    if (from == "-") {
+        seq = changeFeed_.lastSequence() + 1;
+    }
+    const uint64_t first = changeFeed_.firstSequence();
+    if (seq == 0) {
+        seq = first;
+    } else if (seq < first) {
+        sendAll(clientSock, "ERROR TRUNCATED " + std::to_string(first) + "\n");
+        return false;
+    }
+    if (!sendAll(clientSock, "OK " + std::to_string(seq) + "\n")) {
+        return false;
+    }
+    changeFeed_.subscribe(clientSock, seq);
+    return true;
+}
+
+/**
+ * SCAN <start|-> <end|-> <limit>
+ * Replies with one "ENTRY key value" line per pair, then "END <cursor|->".
+ * A value that is not one token (empty, or with whitespace) is sent as
+ * "ENTRYBLOB key len", then len raw bytes and a newline.
+ * Passing the cursor back as <start> fetches the next page.
+ */
+void DistributedNode::handleScan(int clientSock, std::istringstream &args) {
+    static const size_t kMaxScanLimit = 10000;
+    std::string start, end;
+    long long limit = 0;
+    if (!(args >> start >> end >> limit) || limit <= 0) {
+        sendAll(clientSock, "ERROR usage: SCAN <start|-> <end|-> <limit>\n");
+        return;
+    }
+    if (start == "-") start.clear();
+    if (end == "-") end.clear();
+
+    std::vector<std::pair<std::string, std::string>> entries;
+    std::string cursor;
+    if (!scan(start, end, std::min<size_t>(static_cast<size_t>(limit), kMaxScanLimit),
+              entries, cursor)) {
+        sendAll(clientSock, "ERROR ordered index disabled\n");
+        return;
+    }
+    std::string resp;
+    for (const auto &e : entries) {
+        if (tokenSafe(e.second)) {
+            resp += "ENTRY " + e.first + " " + e.second + "\n";
+        } else {
+            resp += "ENTRYBLOB " + e.first + " " + std::to_string(e.second.size()) + "\n" +
+                    e.second + "\n";
+        }
+    }
+    resp += "END " + (cursor.empty() ? std::string("-") : cursor) + "\n";
+    sendAll(clientSock, resp);
+}
+
+/**
+ * STATS              -> "STAT name value" per series, then "END"
+ * STATS PROMETHEUS   -> Prometheus text exposition, then "# EOF"
+ * STATS HOTKEYS [n]  -> "HOTKEY key count error" lines, most read first, then "END"
+ * Histogram series are in seconds.
+ */
+void DistributedNode::handleStats(int clientSock, std::istringstream &args) {
+    std::string what;
+    size_t n = 0;
+    args >> what;
+    if (what.empty()) {
+        std::string resp;
+        for (const auto &s : metrics_.snapshot()) {
+            char value[32];
+            std::snprintf(value, sizeof(value), "%.10g", s.second);
+            resp += "STAT " + s.first + " " + value + "\n";
+        }
+        resp += "END\n";
+        sendAll(clientSock, resp);
+        return;
+    }
+    if (what == "PROMETHEUS") {
+        sendAll(clientSock, metrics_.prometheusText() + "# EOF\n");
+        return;
+    }
+    if (what != "HOTKEYS") {
+        sendAll(clientSock, "ERROR usage: STATS [PROMETHEUS | HOTKEYS [n]]\n");
+        return;
+    }
+    if (!(args >> n)) {
+        n = 10;
+    }
+    std::string resp;
+    for (const auto &h : hotKeys(n)) {
+        resp += "HOTKEY " + h.key + " " + std::to_string(h.count) + " " +
+                std::to_string(h.error) + "\n";
+    }
+    resp += "END\n";
+    sendAll(clientSock, resp);
+}
+
+/**
+ * GETS key                 -> "VALUE v version" | "NOT_FOUND"
+ *                             (values that are not one token: "ERROR binary value")
+ * CAS key version value    -> "OK newVersion" | "CONFLICT" (version 0 = absent)
+ * INCR|DECR key [delta]    -> "INTEGER n" | "ERROR not an integer or overflow"
+ * APPEND key suffix        -> "INTEGER length"
+ */
+void DistributedNode::handleAtomic(int clientSock, const std::string &cmd,
+                                   std::istringstream &args) {
+    std::string key;
+    if (!(args >> key)) {
+        sendAll(clientSock, "ERROR missing key\n");
+        return;
+    }
+    if (cmd == "GETS") {
+        std::string val;
+        uint64_t version = 0;
+        if (!get(key, val, version)) {
+            sendAll(clientSock, "NOT_FOUND\n");
+        } else if (!tokenSafe(val)) {
+            sendAll(clientSock, "ERROR binary value, use GETBLOB\n");
+        } else {
+            sendAll(clientSock, "VALUE " + val + " " + std::to_string(version) + "\n");
+        }
+    } else if (cmd == "CAS") {
+        uint64_t expected = 0, version = 0;
+        std::string value;
+        if (!(args >> expected >> value)) {
+            sendAll(clientSock, "ERROR usage: CAS key version value\n");
+            return;
+        }
+        sendAll(clientSock, compareAndSwap(key, expected, value, version)
+                                ? "OK " + std::to_string(version) + "\n"
+                                : std::string("CONFLICT\n"));
+    } else if (cmd == "APPEND") {
+        std::string suffix;
+        if (!(args >> suffix)) {
+            sendAll(clientSock, "ERROR usage: APPEND key suffix\n");
+            return;
+        }
+        sendAll(clientSock, "INTEGER " + std::to_string(append(key, suffix)) + "\n");
+    } else {
+        int64_t delta = 1, result = 0;
+        if (!(args >> delta)) {
+            delta = 1;
+        }
+        // -INT64_MIN is not representable
+        const bool negatable = delta != std::numeric_limits<int64_t>::min();
+        if ((cmd == "DECR" && !negatable) ||
+            !increment(key, cmd == "DECR" ? -delta : delta, result)) {
+            sendAll(clientSock, "ERROR not an integer or overflow\n");
+            return;
+        }
+        sendAll(clientSock, "INTEGER " + std::to_string(result) + "\n");
+    }
+}
+
 /**
  * Helper to forcibly unblock accept() by connecting to this node.
  */
@@ -0,0 +1,201 @@
+#include "eviction.hpp"
+
+#include <algorithm>
+#include <functional>
+
+std::unique_ptr<EvictionPolicy> EvictionPolicy::create(EvictionKind kind, size_t expectedEntries) {
+    switch (kind) {
+    case EvictionKind::Clock:
+        return std::make_unique<ClockPolicy>();
+    case EvictionKind::TinyLFU:
+        return std::make_unique<TinyLfuPolicy>(expectedEntries);
+    default:
+        return std::make_unique<SampledLruPolicy>();
+    }
+}
+
+/******************************************************************************
+ * SampledLruPolicy
+ *****************************************************************************/
+SampledLruPolicy::SampledLruPolicy(size_t samples)
+    : samples_(samples), clock_(0), rng_(std::random_device{}()) {}
+
+void SampledLruPolicy::onInsert(const std::string &, EvictionMeta &meta) {
+    meta.stamp = ++clock_;
+}
+
+void SampledLruPolicy::onAccess(const std::string &, EvictionMeta &meta) {
+    meta.stamp = ++clock_;
+}
+
+size_t SampledLruPolicy::selectVictim(const std::vector<Resident> &residents) {
+    size_t victim = sample(residents.size());
+    // Ages rather than raw stamps, so the 32-bit clock may wrap
+    uint32_t oldest = clock_ - residents[victim].meta->stamp;
+    for (size_t s = 1; s < samples_; ++s) {
+        const size_t i = sample(residents.size());
+        const uint32_t age = clock_ - residents[i].meta->stamp;
+        if (age > oldest) {
+            victim = i;
+            oldest = age;
+        }
+    }
+    return victim;
+}
+
+/******************************************************************************
+ * ClockPolicy
+ *****************************************************************************/
+void ClockPolicy::onInsert(const std::string &, EvictionMeta &meta) {
+    // Unreferenced until read again, so one-hit keys go on the next sweep
+    meta.flags = 0;
+}
+
+void ClockPolicy::onAccess(const std::string &, EvictionMeta &meta) {
+    meta.flags = 1;
+}
+
+size_t ClockPolicy::selectVictim(const std::vector<Resident> &residents) {
+    // Evicting slot i moves the last resident into it, so the hand stays put
+    while (true) {
+        if (hand_ >= residents.size()) {
+            hand_ = 0;
+        }
+        EvictionMeta *meta = residents[hand_].meta;
+        if (meta->flags == 0) {
+            return hand_;
+        }
+        meta->flags = 0;
+        ++hand_;
+    }
+}
+
+/******************************************************************************
+ * FrequencySketch
+ *****************************************************************************/
+static constexpr size_t kSketchRows = 4;
+
+FrequencySketch::FrequencySketch(size_t expectedEntries) : additions_(0) {
+    size_t words = 64;
+    while (words < expectedEntries) {
+        words <<= 1;
+    }
+    table_.assign(words, 0);
+    mask_ = words - 1;
+    // Sample size of ~10 per expected entry before ageing, as in TinyLFU
+    resetAt_ = std::max<size_t>(expectedEntries, 64) * 10;
+}
+
+size_t FrequencySketch::index(size_t row, uint64_t hash) const {
+    uint64_t h = (hash + row) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+    return static_cast<size_t>(h) & mask_;
+}
+
+uint32_t FrequencySketch::counter(size_t row, uint64_t hash) const {
+    const int shift = static_cast<int>(((hash >> (row * 4)) & 15) * 4);
+    return static_cast<uint32_t>((table_[index(row, hash)] >> shift) & 15);
+}
+
+void FrequencySketch::increment(const std::string &key) {
+    const uint64_t hash = std::hash<std::string>()(key);
+    for (size_t row = 0; row < kSketchRows; ++row) {
+        const int shift = static_cast<int>(((hash >> (row * 4)) & 15) * 4);
+        uint64_t &word = table_[index(row, hash)];
+        if (((word >> shift) & 15) != 15) {
+            word += uint64_t(1) << shift;
+        }
+    }
+    if (++additions_ >= resetAt_) {
+        halve();
+    }
+}
+
+uint32_t FrequencySketch::estimate(const std::string &key) const {
+    const uint64_t hash = std::hash<std::string>()(key);
+    uint32_t freq = 15;
+    for (size_t row = 0; row < kSketchRows; ++row) {
+        freq = std::min(freq, counter(row, hash));
+    }
+    return freq;
+}
+
+void FrequencySketch::halve() {
+    for (auto &word : table_) {
+        word = (word >> 1) & 0x7777777777777777ULL;
+    }
+    additions_ /= 2;
+}
+
+/******************************************************************************
+ * TinyLfuPolicy
+ *****************************************************************************/
+// flags: window marker plus the 31-bit insert sequence number
+static constexpr uint32_t kInWindow = 0x80000000u;
+static constexpr uint32_t kSequenceMask = 0x7FFFFFFFu;
+
+TinyLfuPolicy::TinyLfuPolicy(size_t expectedEntries)
+    : sketch_(expectedEntries), inserts_(0) {}
+
+void TinyLfuPolicy::onInsert(const std::string &key, EvictionMeta &meta) {
+    SampledLruPolicy::onInsert(key, meta);
+    meta.flags = kInWindow | (++inserts_ & kSequenceMask);
+    sketch_.increment(key);
+}
+
+void TinyLfuPolicy::onAccess(const std::string &key, EvictionMeta &meta) {
+    SampledLruPolicy::onAccess(key, meta);
+    sketch_.increment(key);
+}
+
+size_t TinyLfuPolicy::selectVictim(const std::vector<Resident> &residents) {
+    const uint32_t window = static_cast<uint32_t>(std::max<size_t>(residents.size() / 100, 1));
+    const size_t none = residents.size();
+    size_t mainVictim = none, candidate = none, hottest = none, fallback = none;
+    uint32_t mainAge = 0, candidateAge = 0, hottestFreq = 0;
+    for (size_t s = 0; s < samples_; ++s) {
+        const size_t i = sample(residents.size());
+        const EvictionMeta *meta = residents[i].meta;
+        const uint32_t age = clock_ - meta->stamp;
+        if (meta->flags & kInWindow) {
+            if (((inserts_ - meta->flags) & kSequenceMask) < window) {
+                fallback = i;
+                continue;
+            }
+            // Left the window: least recently used one competes for admission
+            if (candidate == none || age > candidateAge) {
+                candidate = i;
+                candidateAge = age;
+            }
+            const uint32_t freq = sketch_.estimate(*residents[i].key);
+            if (hottest == none || freq > hottestFreq) {
+                hottest = i;
+                hottestFreq = freq;
+            }
+        } else if (mainVictim == none || age > mainAge) {
+            mainVictim = i;
+            mainAge = age;
+        }
+    }
+    if (candidate != none) {
+        const uint32_t candidateFreq = sketch_.estimate(*residents[candidate].key);
+        if (mainVictim == none) {
+            // No main-region key sampled (e.g. it is still filling): admit the
+            // most popular graduate and let the least recent one go
+            if (hottest != candidate && hottestFreq > candidateFreq) {
+                residents[hottest].meta->flags = 0;
+            }
+            return candidate;
+        }
+        if (candidateFreq > sketch_.estimate(*residents[mainVictim].key)) {
+            residents[candidate].meta->flags = 0;
+            return mainVictim;
+        }
+        return candidate;
+    }
+    if (mainVictim != none) {
+        return mainVictim;
+    }
+    // Only window keys were sampled (tiny shard): evict one of them anyway
+    return fallback;
+}
@@ -0,0 +1,102 @@
+#include "hot_keys.hpp"
+
+#include <algorithm>
+
+/******************************************************************************
+ * HotKeyTracker
+ *****************************************************************************/
+HotKeyTracker::HotKeyTracker(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {
+    heap_.reserve(capacity_);
+}
+
+void HotKeyTracker::record(const std::string &key) {
+    std::unique_lock<std::mutex> lock(mtx_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+    auto it = pos_.find(key);
+    if (it != pos_.end()) {
+        ++heap_[it->second].count;
+        siftDown(it->second);
+        return;
+    }
+    if (heap_.size() < capacity_) {
+        heap_.push_back({key, 1, 0});
+        pos_[key] = heap_.size() - 1;
+        siftUp(heap_.size() - 1);
+        return;
+    }
+    // Space-Saving: the newcomer inherits the minimum count as its error bound
+    HotKey &min = heap_[0];
+    pos_.erase(min.key);
+    min.key = key;
+    min.error = min.count;
+    ++min.count;
+    pos_[key] = 0;
+    siftDown(0);
+}
+
+bool HotKeyTracker::isHot(const std::string &key, uint64_t minCount) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = pos_.find(key);
+    return it != pos_.end() && heap_[it->second].count >= minCount;
+}
+
+std::vector<HotKey> HotKeyTracker::top(size_t n) const {
+    std::vector<HotKey> out;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        out = heap_;
+    }
+    std::sort(out.begin(), out.end(),
+              [](const HotKey &a, const HotKey &b) { return a.count > b.count; });
+    if (out.size() > n) {
+        out.resize(n);
+    }
+    return out;
+}
+
+void HotKeyTracker::decay() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // Halving every count keeps the heap order intact
+    for (auto &h : heap_) {
+        h.count /= 2;
+        h.error /= 2;
+    }
+}
+
+void HotKeyTracker::swapSlots(size_t a, size_t b) {
+    std::swap(heap_[a], heap_[b]);
+    pos_[heap_[a].key] = a;
+    pos_[heap_[b].key] = b;
+}
+
+void HotKeyTracker::siftUp(size_t i) {
+    while (i > 0) {
+        const size_t parent = (i - 1) / 2;
+        if (heap_[parent].count <= heap_[i].count) {
+            break;
+        }
+        swapSlots(parent, i);
+        i = parent;
+    }
+}
+
+void HotKeyTracker::siftDown(size_t i) {
+    while (true) {
+        const size_t left = 2 * i + 1;
+        const size_t right = left + 1;
+        size_t smallest = i;
+        if (left < heap_.size() && heap_[left].count < heap_[smallest].count) {
+            smallest = left;
+        }
+        if (right < heap_.size() && heap_[right].count < heap_[smallest].count) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        swapSlots(i, smallest);
+        i = smallest;
+    }
+}
@@ -0,0 +1,207 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <set>
+
+namespace {
+
+// "name{labels}" -> ("name", "labels")
+std::pair<std::string, std::string> splitSeries(const std::string &series) {
+    const size_t brace = series.find('{');
+    if (brace == std::string::npos) {
+        return {series, std::string()};
+    }
+    return {series.substr(0, brace), series.substr(brace + 1, series.size() - brace - 2)};
+}
+
+// Series name with a suffix on the metric name and optionally one more label
+std::string seriesWith(const std::string &series, const std::string &suffix,
+                       const std::string &extraLabel = std::string()) {
+    const auto parts = splitSeries(series);
+    std::string labels = parts.second;
+    if (!extraLabel.empty()) {
+        labels += (labels.empty() ? "" : ",") + extraLabel;
+    }
+    return parts.first + suffix + (labels.empty() ? "" : "{" + labels + "}");
+}
+
+std::string formatNumber(double v) {
+    if (std::isinf(v)) {
+        return v > 0 ? "+Inf" : "-Inf";
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.10g", v);
+    return buf;
+}
+
+} // namespace
+
+/******************************************************************************
+ * Counter
+ *****************************************************************************/
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto &s : stripes_) {
+        total += s.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/******************************************************************************
+ * LatencyHistogram
+ *****************************************************************************/
+size_t LatencyHistogram::bucketOf(uint64_t nanos) {
+    if (nanos < (uint64_t(1) << kMinExp)) {
+        return 0;
+    }
+    const unsigned exp = 63 - static_cast<unsigned>(__builtin_clzll(nanos));
+    if (exp >= kMaxExp) {
+        return kBuckets - 1;
+    }
+    // The two bits below the leading one pick the linear sub-bucket
+    const size_t sub = (nanos >> (exp - 2)) & (kSubBuckets - 1);
+    return 1 + (exp - kMinExp) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::upperBound(size_t i) {
+    if (i == 0) {
+        return (uint64_t(1) << kMinExp) - 1;
+    }
+    if (i >= kBuckets - 1) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    const unsigned exp = kMinExp + static_cast<unsigned>((i - 1) / kSubBuckets);
+    const uint64_t sub = (i - 1) % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << (exp - 2)) - 1;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snap;
+    for (const auto &s : stripes_) {
+        for (size_t i = 0; i < kBuckets; ++i) {
+            const uint64_t n = s.counts[i].load(std::memory_order_relaxed);
+            snap.counts[i] += n;
+            snap.count += n;
+        }
+        snap.sumNanos += s.sumNanos.load(std::memory_order_relaxed);
+    }
+    return snap;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets - 1; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return upperBound(i);
+        }
+    }
+    // Overflow bucket: report its lower bound
+    return uint64_t(1) << kMaxExp;
+}
+
+/******************************************************************************
+ * MetricsRegistry
+ *****************************************************************************/
+MetricsRegistry::Metric& MetricsRegistry::add(const std::string &name, Kind kind,
+                                              const std::string &help) {
+    auto it = metrics_.find(name);
+    if (it == metrics_.end()) {
+        it = metrics_.emplace(name, Metric{kind, help, nullptr, nullptr, nullptr}).first;
+    }
+    return it->second;
+}
+
+Counter& MetricsRegistry::counter(const std::string &name, const std::string &help) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Metric &m = add(name, Kind::Counter, help);
+    if (!m.counter) {
+        m.counter.reset(new Counter());
+    }
+    return *m.counter;
+}
+
+LatencyHistogram& MetricsRegistry::histogram(const std::string &name, const std::string &help) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Metric &m = add(name, Kind::Histogram, help);
+    if (!m.histogram) {
+        m.histogram.reset(new LatencyHistogram());
+    }
+    return *m.histogram;
+}
+
+void MetricsRegistry::counter(const std::string &name, const std::string &help,
+                              std::function<double()> fn) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    add(name, Kind::Counter, help).read = std::move(fn);
+}
+
+void MetricsRegistry::gauge(const std::string &name, const std::string &help,
+                            std::function<double()> fn) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    add(name, Kind::Gauge, help).read = std::move(fn);
+}
+
+std::vector<std::pair<std::string, double>> MetricsRegistry::snapshot() const {
+    std::vector<std::pair<std::string, double>> out;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &kv : metrics_) {
+        const Metric &m = kv.second;
+        if (m.kind != Kind::Histogram) {
+            out.emplace_back(kv.first, m.read ? m.read() : static_cast<double>(m.counter->value()));
+            continue;
+        }
+        const LatencyHistogram::Snapshot snap = m.histogram->snapshot();
+        out.emplace_back(seriesWith(kv.first, "_count"), static_cast<double>(snap.count));
+        out.emplace_back(seriesWith(kv.first, "_sum"), snap.sumNanos / 1e9);
+        const std::pair<const char*, double> quantiles[] = {
+            {"_p50", 50}, {"_p90", 90}, {"_p99", 99}, {"_p999", 99.9}};
+        for (const auto &q : quantiles) {
+            out.emplace_back(seriesWith(kv.first, q.first), snap.percentile(q.second) / 1e9);
+        }
+    }
+    return out;
+}
+
+std::string MetricsRegistry::prometheusText() const {
+    std::string out;
+    std::set<std::string> described;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &kv : metrics_) {
+        const Metric &m = kv.second;
+        const std::string family = splitSeries(kv.first).first;
+        if (described.insert(family).second) {
+            static const char *kTypes[] = {"counter", "gauge", "histogram"};
+            out += "# HELP " + family + " " + m.help + "\n";
+            out += "# TYPE " + family + " " + kTypes[static_cast<int>(m.kind)] + "\n";
+        }
+        if (m.kind != Kind::Histogram) {
+            out += kv.first + " " +
+                   formatNumber(m.read ? m.read() : static_cast<double>(m.counter->value())) + "\n";
+            continue;
+        }
+        // Cumulative buckets at each power of two, in seconds
+        const LatencyHistogram::Snapshot snap = m.histogram->snapshot();
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < LatencyHistogram::kBuckets - 1; ++i) {
+            cumulative += snap.counts[i];
+            if (i % LatencyHistogram::kSubBuckets != 0) {
+                continue;
+            }
+            const double le = (LatencyHistogram::upperBound(i) + 1) / 1e9;
+            out += seriesWith(kv.first, "_bucket", "le=\"" + formatNumber(le) + "\"") + " " +
+                   std::to_string(cumulative) + "\n";
+        }
+        out += seriesWith(kv.first, "_bucket", "le=\"+Inf\"") + " " + std::to_string(snap.count) + "\n";
+        out += seriesWith(kv.first, "_sum") + " " + formatNumber(snap.sumNanos / 1e9) + "\n";
+        out += seriesWith(kv.first, "_count") + " " + std::to_string(snap.count) + "\n";
+    }
+    return out;
+}
@@ -0,0 +1,164 @@
+#include "net_util.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+bool lineSafe(const std::string &value) {
+    return value.find_first_of("\r\n") == std::string::npos;
+}
+
+bool tokenSafe(const std::string &value) {
+    return !value.empty() && value.find_first_of(" \t\r\n\v\f") == std::string::npos;
+}
+
+int connectTo(const std::string &host, int port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr(host.c_str());
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+bool sendAll(int sock, const void *data, size_t len) {
+    TRACE_SCOPE("net.send");
+    const char *p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = ::send(sock, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool sendAll(int sock, const std::string &data) {
+    return sendAll(sock, data.data(), data.size());
+}
+
+bool sendAll(int sock, const std::string &header, const void *body, size_t len) {
+    TRACE_SCOPE("net.send");
+    iovec iov[2] = {
+        {const_cast<char*>(header.data()), header.size()},
+        {const_cast<void*>(body), len},
+    };
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    while (iov[0].iov_len + iov[1].iov_len > 0) {
+        ssize_t n = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        // Advance past what was written, possibly into the body
+        for (size_t i = 0; i < 2 && n > 0; ++i) {
+            const size_t take = std::min(static_cast<size_t>(n), iov[i].iov_len);
+            iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + take;
+            iov[i].iov_len -= take;
+            n -= static_cast<ssize_t>(take);
+        }
+        if (iov[0].iov_len == 0) {
+            msg.msg_iov = &iov[1];
+            msg.msg_iovlen = 1;
+        }
+    }
+    return true;
+}
+
+/******************************************************************************
+ * SocketReader
+ *****************************************************************************/
+bool SocketReader::fill() {
+    while (true) {
+        ssize_t n = ::recv(sock_, buf_, sizeof(buf_), 0);
+        if (n > 0) {
+            pos_ = 0;
+            end_ = static_cast<size_t>(n);
+            return true;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return false;
+    }
+}
+
+bool SocketReader::readLine(std::string &line, size_t maxLen) {
+    TRACE_SCOPE("net.recv");
+    line.clear();
+    while (true) {
+        if (pos_ == end_ && !fill()) {
+            return !line.empty();
+        }
+        const char *start = buf_ + pos_;
+        const char *nl = static_cast<const char*>(std::memchr(start, '\n', end_ - pos_));
+        const size_t take = nl ? static_cast<size_t>(nl - start) : end_ - pos_;
+        line.append(start, take);
+        pos_ += take;
+        if (line.size() > maxLen) {
+            return false;
+        }
+        if (nl) {
+            ++pos_;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            return true;
+        }
+    }
+}
+
+bool SocketReader::readExact(void *out, size_t len) {
+    TRACE_SCOPE("net.recv");
+    char *dst = static_cast<char*>(out);
+    while (len > 0) {
+        if (pos_ == end_ && len >= sizeof(buf_)) {
+            // Nothing buffered: skip the copy through buf_
+            ssize_t n = ::recv(sock_, dst, len, 0);
+            if (n > 0) {
+                dst += n;
+                len -= static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (pos_ == end_ && !fill()) {
+            return false;
+        }
+        const size_t take = std::min(len, end_ - pos_);
+        std::memcpy(dst, buf_ + pos_, take);
+        pos_ += take;
+        dst += take;
+        len -= take;
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+#include "ordered_index.hpp"
+
+/******************************************************************************
+ * OrderedKeyIndex
+ *****************************************************************************/
+OrderedKeyIndex::Node::Node(const std::string &k, int h)
+    : key(k), height(h), next(new std::atomic<Node*>[h])
+{
+    for (int i = 0; i < h; ++i) {
+        next[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+OrderedKeyIndex::OrderedKeyIndex()
+    : head_(new Node(std::string(), kMaxHeight)), height_(1), size_(0),
+      rng_(std::random_device{}()) {}
+
+OrderedKeyIndex::~OrderedKeyIndex() {
+    Node *n = head_;
+    while (n != nullptr) {
+        Node *next = n->next[0].load(std::memory_order_relaxed);
+        delete n;
+        n = next;
+    }
+}
+
+int OrderedKeyIndex::randomHeight() {
+    // p = 1/4 per level keeps towers short (~1.33 pointers per key)
+    int h = 1;
+    while (h < kMaxHeight && (rng_() & 3) == 0) {
+        ++h;
+    }
+    return h;
+}
+
+OrderedKeyIndex::Node* OrderedKeyIndex::findGreaterOrEqual(const std::string &target,
+                                                           Node **preds) const {
+    Node *x = head_;
+    for (int level = height_.load(std::memory_order_acquire) - 1; level >= 0; --level) {
+        while (true) {
+            Node *next = x->next[level].load(std::memory_order_acquire);
+            if (next == nullptr || next->key >= target) {
+                break;
+            }
+            x = next;
+        }
+        if (preds != nullptr) {
+            preds[level] = x;
+        }
+    }
+    return x->next[0].load(std::memory_order_acquire);
+}
+
+bool OrderedKeyIndex::insert(const std::string &key) {
+    std::lock_guard<std::mutex> lock(writeMtx_);
+    Node *preds[kMaxHeight];
+    Node *found = findGreaterOrEqual(key, preds);
+    if (found != nullptr && found->key == key) {
+        return false;
+    }
+
+    const int h = randomHeight();
+    const int current = height_.load(std::memory_order_relaxed);
+    for (int level = current; level < h; ++level) {
+        preds[level] = head_;
+    }
+    Node *node = new Node(key, h);
+    for (int level = 0; level < h; ++level) {
+        node->next[level].store(preds[level]->next[level].load(std::memory_order_relaxed),
+                                std::memory_order_relaxed);
+    }
+    // Publish bottom-up so a reader that finds the node at any level
+    // can always continue from it at lower levels
+    for (int level = 0; level < h; ++level) {
+        preds[level]->next[level].store(node, std::memory_order_release);
+    }
+    if (h > current) {
+        height_.store(h, std::memory_order_release);
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool OrderedKeyIndex::remove(const std::string &key) {
+    std::lock_guard<std::mutex> lock(writeMtx_);
+    Node *preds[kMaxHeight];
+    Node *node = findGreaterOrEqual(key, preds);
+    if (node == nullptr || node->key != key) {
+        return false;
+    }
+    // Unlink top-down; node->next stays intact for readers already on it
+    for (int level = node->height - 1; level >= 0; --level) {
+        preds[level]->next[level].store(node->next[level].load(std::memory_order_relaxed),
+                                        std::memory_order_release);
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    epochs_.retire(node);
+    return true;
+}
+
+bool OrderedKeyIndex::contains(const std::string &key) const {
+    EpochManager::Guard guard(epochs_);
+    Node *node = findGreaterOrEqual(key, nullptr);
+    return node != nullptr && node->key == key;
+}
+
+std::vector<std::string> OrderedKeyIndex::scan(const std::string &start, const std::string &end,
+                                               size_t limit) const {
+    std::vector<std::string> keys;
+    EpochManager::Guard guard(epochs_);
+    Node *node = findGreaterOrEqual(start, nullptr);
+    while (node != nullptr && keys.size() < limit) {
+        if (!end.empty() && node->key >= end) {
+            break;
+        }
+        keys.push_back(node->key);
+        node = node->next[0].load(std::memory_order_acquire);
+    }
+    return keys;
+}
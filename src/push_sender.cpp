@@ -0,0 +1,104 @@
+#include "push_sender.hpp"
+#include "concurrency.hpp"
+
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/******************************************************************************
+ * PushSender
+ *****************************************************************************/
+PushSender::PushSender() : wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    CHECK_RET(wakeFd_ >= 0, "Failed to create push sender eventfd");
+}
+
+PushSender::~PushSender() {
+    stopSender();
+    close(wakeFd_);
+}
+
+void PushSender::startSender() {
+    if (!thread_.joinable()) {
+        thread_ = std::thread(&PushSender::run, this);
+    }
+}
+
+void PushSender::stopSender() {
+    stop_ = true;
+    wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void PushSender::wake() {
+    // Paired RMWs: a caller that finds the flag already set is ordered before
+    // the sender's next exchange(false), so its work is picked up
+    if (!wakePending_.exchange(true)) {
+        const uint64_t one = 1;
+        ssize_t ignored = write(wakeFd_, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void PushSender::run() {
+    std::vector<pollfd> fds;
+    std::vector<Connection*> polled;
+    std::vector<Connection*> done;
+    while (!stop_) {
+        polled.clear();
+        collect(polled);
+        fds.assign(1, pollfd{wakeFd_, POLLIN, 0});
+        for (Connection *c : polled) {
+            const bool pending = !c->outbox.empty() || backlog(*c);
+            fds.push_back(pollfd{c->sock, static_cast<short>(POLLIN | (pending ? POLLOUT : 0)), 0});
+        }
+        if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) {
+            break;
+        }
+        uint64_t drained;
+        if (read(wakeFd_, &drained, sizeof(drained)) < 0) {
+            // EAGAIN: woken by a socket, not by wake()
+        }
+        wakePending_.exchange(false);
+
+        done.clear();
+        for (size_t i = 0; i < polled.size(); ++i) {
+            Connection *c = polled[i];
+            bool alive = true;
+            if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                // Peers send nothing once subscribed; EOF or error means gone
+                char buf[256];
+                const ssize_t n = recv(c->sock, buf, sizeof(buf), MSG_DONTWAIT);
+                alive = n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+            }
+            if (alive) {
+                fill(*c);
+                alive = sendOutbox(*c) && !(c->closing && c->outbox.empty());
+            }
+            if (!alive) {
+                done.push_back(c);
+            }
+        }
+        if (!done.empty()) {
+            drop(done);
+        }
+    }
+}
+
+bool PushSender::sendOutbox(Connection &conn) {
+    while (!conn.outbox.empty()) {
+        const ssize_t n = ::send(conn.sock, conn.outbox.data(), conn.outbox.size(),
+                                 MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            conn.outbox.erase(0, static_cast<size_t>(n));
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    return true;
+}
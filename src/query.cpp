@@ -0,0 +1,393 @@
+#include "query.hpp"
+#include "net_util.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <future>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+
+const char *kAggNames[] = {"COUNT", "SUM", "MIN", "MAX", "AVG", "SELECT"};
+const char *kOpNames[] = {"LT", "LE", "GT", "GE", "EQ", "NE"};
+
+// Rows per task handed to the pool, and per mask block inside a task
+constexpr size_t kRangeRows = 64 * 1024;
+constexpr size_t kBlockRows = 1024;
+// Values per binary batch on the wire
+constexpr size_t kBatchValues = 4096;
+// Rows a streamed query scans per table lock hold; bounds the reply bytes
+// buffered between the scan and the socket to 4 bytes per row
+constexpr size_t kWindowRows = 4 * kRangeRows;
+
+template <size_t N>
+bool lookupName(const char *const (&names)[N], const std::string &token, int &out) {
+    for (size_t i = 0; i < N; ++i) {
+        if (token == names[i]) {
+            out = static_cast<int>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseInt(const std::string &token, int &out) {
+    if (token.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    long v = std::strtol(token.c_str(), &end, 10);
+    if (*end != '\0' || errno == ERANGE || v < INT_MIN || v > INT_MAX) {
+        return false;
+    }
+    out = static_cast<int>(v);
+    return true;
+}
+
+void putU32(std::string &out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+}
+
+void putI64(std::string &out, int64_t v) {
+    const uint64_t u = static_cast<uint64_t>(v);
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>((u >> (8 * i)) & 0xFF));
+    }
+}
+
+uint64_t getLE(const unsigned char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) {
+        v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+struct BoundPredicate {
+    const int *data;
+    CompareOp op;
+    int value;
+};
+
+// Clears mask[i] for every row in [0, n) that fails the predicate
+void applyPredicate(const BoundPredicate &p, size_t begin, size_t n, unsigned char *mask) {
+    const int *d = p.data + begin;
+    const int v = p.value;
+    switch (p.op) {
+    case CompareOp::LT: for (size_t i = 0; i < n; ++i) mask[i] &= d[i] <  v; break;
+    case CompareOp::LE: for (size_t i = 0; i < n; ++i) mask[i] &= d[i] <= v; break;
+    case CompareOp::GT: for (size_t i = 0; i < n; ++i) mask[i] &= d[i] >  v; break;
+    case CompareOp::GE: for (size_t i = 0; i < n; ++i) mask[i] &= d[i] >= v; break;
+    case CompareOp::EQ: for (size_t i = 0; i < n; ++i) mask[i] &= d[i] == v; break;
+    case CompareOp::NE: for (size_t i = 0; i < n; ++i) mask[i] &= d[i] != v; break;
+    }
+}
+
+QueryResult scanRange(const int *target, const std::vector<BoundPredicate> &preds,
+                      bool select, size_t begin, size_t end) {
+    QueryResult r;
+    unsigned char mask[kBlockRows];
+    for (size_t b = begin; b < end; b += kBlockRows) {
+        const size_t n = std::min(kBlockRows, end - b);
+        std::fill(mask, mask + n, 1);
+        for (const auto &p : preds) {
+            applyPredicate(p, b, n, mask);
+        }
+        const int *vals = target + b;
+        for (size_t i = 0; i < n; ++i) {
+            if (mask[i]) {
+                const int v = vals[i];
+                ++r.count;
+                r.sum += v;
+                r.min = std::min(r.min, v);
+                r.max = std::max(r.max, v);
+                if (select) {
+                    r.values.push_back(v);
+                }
+            }
+        }
+    }
+    return r;
+}
+
+} // namespace
+
+/******************************************************************************
+ * AnalyticsQuery
+ *****************************************************************************/
+bool AnalyticsQuery::parse(const std::string &line, AnalyticsQuery &out) {
+    std::istringstream iss(line);
+    std::string cmd, agg, column;
+    if (!(iss >> cmd >> agg >> column) || cmd != "QUERY") {
+        return false;
+    }
+    AnalyticsQuery q;
+    int aggIndex = 0;
+    if (!lookupName(kAggNames, agg, aggIndex)) {
+        return false;
+    }
+    q.agg = static_cast<QueryAgg>(aggIndex);
+    q.column = column;
+
+    std::string keyword;
+    if (iss >> keyword) {
+        if (keyword != "WHERE") {
+            return false;
+        }
+        do {
+            std::string col, op, value;
+            int opIndex = 0;
+            QueryPredicate pred;
+            if (!(iss >> col >> op >> value) || !lookupName(kOpNames, op, opIndex) ||
+                !parseInt(value, pred.value)) {
+                return false;
+            }
+            pred.column = col;
+            pred.op = static_cast<CompareOp>(opIndex);
+            q.where.push_back(pred);
+            if (!(iss >> keyword)) {
+                break;
+            }
+            if (keyword != "AND") {
+                return false;
+            }
+        } while (true);
+    }
+    out = std::move(q);
+    return true;
+}
+
+std::string AnalyticsQuery::toString() const {
+    std::string s = std::string("QUERY ") + kAggNames[static_cast<int>(agg)] + " " + column;
+    for (size_t i = 0; i < where.size(); ++i) {
+        s += (i == 0) ? " WHERE " : " AND ";
+        s += where[i].column + " " + kOpNames[static_cast<int>(where[i].op)] + " " +
+             std::to_string(where[i].value);
+    }
+    return s;
+}
+
+/******************************************************************************
+ * QueryResult
+ *****************************************************************************/
+void QueryResult::merge(const QueryResult &other) {
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    values.insert(values.end(), other.values.begin(), other.values.end());
+}
+
+/******************************************************************************
+ * Execution
+ *****************************************************************************/
+bool executeQuery(const ColumnarTable &table, const AnalyticsQuery &query,
+                  const ColumnResolver &resolve, ThreadPool *pool,
+                  QueryResult &out,
+                  const std::function<void(const std::vector<int> &)> &onBatch,
+                  size_t beginRow, size_t endRow) {
+    const int targetIndex = resolve(query.column);
+    if (targetIndex < 0) {
+        return false;
+    }
+    for (const auto &p : query.where) {
+        if (resolve(p.column) < 0) {
+            return false;
+        }
+    }
+    // Declared columns have no storage until the first row: empty result
+    if (table.getNumRows() == 0) {
+        return true;
+    }
+    const int *target = table.columnData(targetIndex);
+    if (target == nullptr) {
+        return false;
+    }
+    std::vector<BoundPredicate> preds;
+    for (const auto &p : query.where) {
+        const int *data = table.columnData(resolve(p.column));
+        if (data == nullptr) {
+            return false;
+        }
+        preds.push_back({data, p.op, p.value});
+    }
+
+    const bool select = query.agg == QueryAgg::Select;
+    const size_t rows = std::min(table.getNumRows(), endRow);
+    if (beginRow >= rows) {
+        return true;
+    }
+    const size_t numRanges = (rows - beginRow + kRangeRows - 1) / kRangeRows;
+
+    auto consume = [&](QueryResult &&partial) {
+        if (onBatch && select) {
+            onBatch(partial.values);
+            partial.values.clear();
+        }
+        out.merge(partial);
+    };
+
+    if (pool == nullptr || numRanges <= 1) {
+        for (size_t r = 0; r < numRanges; ++r) {
+            const size_t begin = beginRow + r * kRangeRows;
+            consume(scanRange(target, preds, select, begin, std::min(rows, begin + kRangeRows)));
+        }
+        return true;
+    }
+
+    // Ranges run in parallel and are consumed in order, so onBatch sees
+    // early ranges while later ones are still scanning
+    std::vector<std::future<QueryResult>> parts;
+    parts.reserve(numRanges);
+    for (size_t r = 0; r < numRanges; ++r) {
+        const size_t begin = beginRow + r * kRangeRows;
+        const size_t end = std::min(rows, begin + kRangeRows);
+        parts.push_back(pool->enqueue([target, &preds, select, begin, end]() {
+            return scanRange(target, preds, select, begin, end);
+        }));
+    }
+    for (auto &f : parts) {
+        consume(f.get());
+    }
+    return true;
+}
+
+void queryResponse(const TableAccess &withTable, const AnalyticsQuery &query,
+                   const ColumnResolver &resolve, ThreadPool *pool,
+                   const std::function<bool(const std::string &)> &emit) {
+    std::vector<std::string> columns{query.column};
+    for (const auto &p : query.where) {
+        columns.push_back(p.column);
+    }
+    for (const auto &c : columns) {
+        if (resolve(c) < 0) {
+            emit("ERROR unknown column " + c + "\n");
+            return;
+        }
+    }
+
+    // Rows appended while the reply streams are left for the next query
+    size_t rows = 0;
+    withTable([&](const ColumnarTable &table) { rows = table.getNumRows(); });
+
+    // The RESULT line waits for the first window so a late unknown-column
+    // error can still replace it
+    bool started = false;
+    QueryResult result;
+    std::string pending;
+    size_t begin = 0;
+    do {
+        const size_t end = std::min(rows, begin + kWindowRows);
+        pending.clear();
+        bool ok = false;
+        withTable([&](const ColumnarTable &table) {
+            ok = executeQuery(table, query, resolve, pool, result, [&](const std::vector<int> &vals) {
+                for (size_t i = 0; i < vals.size(); i += kBatchValues) {
+                    const size_t n = std::min(kBatchValues, vals.size() - i);
+                    pending.reserve(pending.size() + 4 + 4 * n);
+                    putU32(pending, static_cast<uint32_t>(n));
+                    for (size_t j = 0; j < n; ++j) {
+                        putU32(pending, static_cast<uint32_t>(vals[i + j]));
+                    }
+                }
+            }, begin, end);
+        });
+        if (!ok) {
+            if (!started) {
+                emit("ERROR unknown column " + query.column + "\n");
+            }
+            return;
+        }
+        // Sent with the table lock released
+        if (!started) {
+            started = true;
+            pending.insert(0, std::string("RESULT ") + kAggNames[static_cast<int>(query.agg)] + "\n");
+        }
+        if (!pending.empty() && !emit(pending)) {
+            return;
+        }
+        begin = end;
+    } while (begin < rows);
+
+    std::string tail;
+    putU32(tail, 0);
+    putI64(tail, static_cast<int64_t>(result.count));
+    putI64(tail, result.sum);
+    putI64(tail, result.min);
+    putI64(tail, result.max);
+    emit(tail);
+}
+
+/******************************************************************************
+ * QueryCoordinator
+ *****************************************************************************/
+QueryCoordinator::QueryCoordinator(std::vector<std::pair<std::string, int>> nodes)
+    : nodes_(std::move(nodes)) {}
+
+bool QueryCoordinator::queryNode(const std::string &host, int port,
+                                 const AnalyticsQuery &query, QueryResult &out) {
+    int sock = connectTo(host, port);
+    if (sock < 0) {
+        return false;
+    }
+    bool ok = sendAll(sock, query.toString() + "\n");
+    SocketReader reader(sock);
+    std::string line;
+    ok = ok && reader.readLine(line) && line.compare(0, 7, "RESULT ") == 0;
+
+    QueryResult partial;
+    while (ok) {
+        unsigned char hdr[4];
+        if (!reader.readExact(hdr, sizeof(hdr))) {
+            ok = false;
+            break;
+        }
+        const uint32_t n = static_cast<uint32_t>(getLE(hdr, 4));
+        if (n == 0) {
+            break;
+        }
+        std::vector<unsigned char> raw(static_cast<size_t>(n) * 4);
+        ok = reader.readExact(raw.data(), raw.size());
+        for (size_t i = 0; ok && i < n; ++i) {
+            partial.values.push_back(static_cast<int>(static_cast<uint32_t>(getLE(&raw[i * 4], 4))));
+        }
+    }
+    unsigned char agg[32];
+    ok = ok && reader.readExact(agg, sizeof(agg));
+    close(sock);
+    if (!ok) {
+        return false;
+    }
+    partial.count = getLE(agg, 8);
+    partial.sum = static_cast<int64_t>(getLE(agg + 8, 8));
+    partial.min = static_cast<int>(static_cast<int64_t>(getLE(agg + 16, 8)));
+    partial.max = static_cast<int>(static_cast<int64_t>(getLE(agg + 24, 8)));
+    out.merge(partial);
+    return true;
+}
+
+bool QueryCoordinator::execute(const AnalyticsQuery &query, QueryResult &out) const {
+    std::vector<std::future<std::pair<bool, QueryResult>>> replies;
+    replies.reserve(nodes_.size());
+    for (const auto &node : nodes_) {
+        replies.push_back(std::async(std::launch::async, [&query, node]() {
+            QueryResult partial;
+            bool ok = queryNode(node.first, node.second, query, partial);
+            return std::make_pair(ok, std::move(partial));
+        }));
+    }
+    bool allOk = true;
+    for (auto &f : replies) {
+        auto reply = f.get();
+        allOk = allOk && reply.first;
+        if (reply.first) {
+            out.merge(reply.second);
+        }
+    }
+    return allOk;
+}
@@ -0,0 +1,154 @@
+#include "timing_wheel.hpp"
+
+#include <algorithm>
+
+/******************************************************************************
+ * TimingWheel
+ *****************************************************************************/
+TimingWheel::TimingWheel(uint64_t nowMs) : slots_{}, current_(nowMs), count_(0), levelCount_{} {}
+
+TimingWheel::~TimingWheel() {
+    release();
+}
+
+TimingWheel::TimingWheel(TimingWheel &&other) noexcept : TimingWheel(other.current_) {
+    *this = std::move(other);
+}
+
+TimingWheel& TimingWheel::operator=(TimingWheel &&other) noexcept {
+    if (this != &other) {
+        release();
+        std::copy(&other.slots_[0][0], &other.slots_[0][0] + kLevels * kSlots, &slots_[0][0]);
+        std::copy(other.levelCount_, other.levelCount_ + kLevels, levelCount_);
+        current_ = other.current_;
+        count_ = other.count_;
+        std::fill(&other.slots_[0][0], &other.slots_[0][0] + kLevels * kSlots, nullptr);
+        std::fill(other.levelCount_, other.levelCount_ + kLevels, 0);
+        other.count_ = 0;
+    }
+    return *this;
+}
+
+void TimingWheel::release() {
+    for (auto &level : slots_) {
+        for (Timer *&head : level) {
+            while (head != nullptr) {
+                Timer *next = head->next;
+                delete head;
+                head = next;
+            }
+        }
+    }
+    std::fill(levelCount_, levelCount_ + kLevels, 0);
+    count_ = 0;
+}
+
+TimingWheel::Timer* TimingWheel::schedule(const std::string *key, uint64_t expireAtMs) {
+    Timer *timer = new Timer();
+    timer->key = key;
+    timer->expireAtMs = expireAtMs;
+    place(timer, current_ + 1);
+    ++count_;
+    return timer;
+}
+
+void TimingWheel::reschedule(Timer *timer, uint64_t expireAtMs) {
+    unlink(timer);
+    timer->expireAtMs = expireAtMs;
+    place(timer, current_ + 1);
+}
+
+void TimingWheel::cancel(Timer *timer) {
+    if (timer->level != kFired) {
+        unlink(timer);
+        --count_;
+    }
+    delete timer;
+}
+
+void TimingWheel::unlink(Timer *timer) {
+    if (timer->prev != nullptr) {
+        timer->prev->next = timer->next;
+    } else {
+        slots_[timer->level][timer->slot] = timer->next;
+    }
+    if (timer->next != nullptr) {
+        timer->next->prev = timer->prev;
+    }
+    --levelCount_[timer->level];
+}
+
+void TimingWheel::place(Timer *timer, uint64_t earliest) {
+    const uint64_t due = std::max(timer->expireAtMs, earliest);
+    // The highest digit in which `due` differs from now picks the level: the
+    // timer's slot there is reached before `due`, within one rotation
+    const uint64_t diff = due ^ current_;
+    const int level = diff == 0 ? 0
+        : std::min((63 - __builtin_clzll(diff)) / kSlotBits, kLevels - 1);
+    const int shift = level * kSlotBits;
+    // Top level: slot s is next visited at the first hand position above now
+    // congruent to s, so deadlines past one rotation are clamped to it and
+    // re-placed when it comes around
+    const uint64_t hand = std::min(due >> shift, (current_ >> shift) + kSlots);
+    const size_t slot = hand & (kSlots - 1);
+    Timer *&head = slots_[level][slot];
+    timer->prev = nullptr;
+    timer->next = head;
+    if (head != nullptr) {
+        head->prev = timer;
+    }
+    head = timer;
+    timer->level = static_cast<uint32_t>(level);
+    timer->slot = static_cast<uint32_t>(slot);
+    ++levelCount_[level];
+}
+
+void TimingWheel::advance(uint64_t nowMs, std::vector<Timer*> &due, size_t limit) {
+    while (current_ < nowMs && count_ != 0) {
+        if (due.size() >= limit) {
+            // Resume from this tick on the next call
+            return;
+        }
+        // Nothing happens before the lowest non-empty level's hand moves, so
+        // idle stretches are skipped instead of walked tick by tick
+        int lowest = 0;
+        while (levelCount_[lowest] == 0) {
+            ++lowest;
+        }
+        const uint64_t nextMove = current_ | ((uint64_t(1) << (lowest * kSlotBits)) - 1);
+        if (nextMove > current_) {
+            current_ = std::min(nextMove, nowMs);
+            continue;
+        }
+        const uint64_t tick = ++current_;
+        // Cascade every level whose hand moves on this tick, top down, so the
+        // timers land in lower levels before those are processed
+        int top = 0;
+        while (top + 1 < kLevels && (tick & ((uint64_t(1) << ((top + 1) * kSlotBits)) - 1)) == 0) {
+            ++top;
+        }
+        for (int level = top; level >= 1; --level) {
+            Timer *&slot = slots_[level][(tick >> (level * kSlotBits)) & (kSlots - 1)];
+            Timer *moving = slot;
+            slot = nullptr;
+            while (moving != nullptr) {
+                Timer *next = moving->next;
+                --levelCount_[level];
+                place(moving, tick);
+                moving = next;
+            }
+        }
+        Timer *&slot = slots_[0][tick & (kSlots - 1)];
+        for (Timer *t = slot; t != nullptr;) {
+            Timer *next = t->next;
+            t->prev = t->next = nullptr;
+            t->level = kFired;
+            due.push_back(t);
+            --count_;
+            --levelCount_[0];
+            t = next;
+        }
+        slot = nullptr;
+    }
+    current_ = std::max(current_, nowMs);
+}
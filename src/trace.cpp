@@ -0,0 +1,193 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Ring slots, a power of two. One is always the writer's next slot, so a
+// dump returns at most kEventsPerThread - 1 events per thread.
+constexpr size_t kEventsPerThread = 16384;
+constexpr uint64_t kReadable = kEventsPerThread - 1;
+
+// Flight recorder: when full, the owning thread overwrites its oldest events,
+// so a dump always holds the most recent ones. Slots are written and read
+// field by field through relaxed atomics; the reader validates what it copied
+// against `head` afterwards, seqlock style, and discards events the writer may
+// have been overwriting meanwhile.
+struct EventRing {
+    struct Slot {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> end{0};
+    };
+
+    Slot slots[kEventsPerThread];
+    // Events ever written; only the owning thread stores it
+    std::atomic<uint64_t> head{0};
+    // Next event to read; only the reader touches it
+    uint64_t tail = 0;
+
+    void push(const TraceEvent &ev) {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        // Orders the previous head store before the slot stores below: a
+        // reader that sees any of them also sees head >= h
+        std::atomic_thread_fence(std::memory_order_release);
+        Slot &slot = slots[h & (kEventsPerThread - 1)];
+        slot.name.store(ev.name, std::memory_order_relaxed);
+        slot.start.store(ev.start, std::memory_order_relaxed);
+        slot.end.store(ev.end, std::memory_order_relaxed);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Appends the events recorded since the last drain, oldest first; returns
+    // how many were overwritten before they could be read
+    uint64_t drain(std::vector<TraceEvent> &out) {
+        const uint64_t h = head.load(std::memory_order_acquire);
+        uint64_t from = std::max(tail, h > kReadable ? h - kReadable : 0);
+        const size_t base = out.size();
+        for (uint64_t i = from; i < h; ++i) {
+            const Slot &slot = slots[i & (kEventsPerThread - 1)];
+            out.push_back({slot.name.load(std::memory_order_relaxed),
+                           slot.start.load(std::memory_order_relaxed),
+                           slot.end.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // The writer may be storing event `after`, into event
+        // after - kEventsPerThread's slot; everything from that one back is suspect
+        const uint64_t after = head.load(std::memory_order_relaxed);
+        if (after >= from + kEventsPerThread) {
+            const uint64_t valid = after - kEventsPerThread + 1;
+            const size_t stale = static_cast<size_t>(std::min(valid, h) - from);
+            out.erase(out.begin() + base, out.begin() + base + stale);
+            from += stale;
+        }
+        const uint64_t lost = from - tail;
+        tail = h;
+        return lost;
+    }
+};
+
+// One per thread that has recorded an event; the thread is the only
+// writer, traceChromeJson() (under the registry lock) the only reader
+struct ThreadTrace {
+    EventRing events;
+    uint32_t tid = 0;
+    // Set when the thread exits; its buffer is freed once drained
+    std::atomic<bool> retired{false};
+};
+
+struct Registry {
+    std::mutex mtx;
+    std::vector<std::unique_ptr<ThreadTrace>> threads;
+};
+
+// Never destroyed: threads may still exit (and retire) after static teardown
+Registry& registry() {
+    static Registry *reg = new Registry;
+    return *reg;
+}
+
+std::atomic<uint64_t> droppedEvents{0};
+
+// A raw timestamp paired with steady_clock. Two anchors give the tick rate,
+// so no calibration pause is needed.
+struct ClockAnchor {
+    uint64_t ticks;
+    std::chrono::steady_clock::time_point time;
+};
+
+ClockAnchor anchorNow() {
+    return {traceTimestamp(), std::chrono::steady_clock::now()};
+}
+
+const ClockAnchor traceStart = anchorNow();
+
+struct ThreadSlot {
+    ThreadTrace *trace = nullptr;
+    ~ThreadSlot() {
+        if (trace != nullptr) {
+            trace->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadSlot threadSlot;
+
+ThreadTrace& threadTrace() {
+    if (threadSlot.trace == nullptr) {
+        auto trace = std::make_unique<ThreadTrace>();
+        trace->tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+        threadSlot.trace = trace.get();
+        std::lock_guard<std::mutex> lock(registry().mtx);
+        registry().threads.push_back(std::move(trace));
+    }
+    return *threadSlot.trace;
+}
+
+void appendJsonString(std::string &out, const char *s) {
+    out += '"';
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            out += '\\';
+        }
+        out += *s;
+    }
+    out += '"';
+}
+
+} // namespace
+
+void traceRecord(const char *name, uint64_t start, uint64_t end) {
+    threadTrace().events.push({name, start, end});
+}
+
+uint64_t traceDropped() {
+    return droppedEvents.load(std::memory_order_relaxed);
+}
+
+std::string traceChromeJson() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+
+    const ClockAnchor now = anchorNow();
+    const double elapsedUs = std::chrono::duration<double, std::micro>(now.time - traceStart.time).count();
+    const double ticks = static_cast<double>(now.ticks - traceStart.ticks);
+    const double usPerTick = ticks > 0 ? elapsedUs / ticks : 0.0;
+    const int pid = static_cast<int>(::getpid());
+
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    char numbers[128];
+    std::vector<TraceEvent> events;
+    for (auto it = reg.threads.begin(); it != reg.threads.end();) {
+        ThreadTrace &trace = **it;
+        // Read before draining: a retired thread records nothing more
+        const bool retired = trace.retired.load(std::memory_order_acquire);
+        events.clear();
+        droppedEvents.fetch_add(trace.events.drain(events), std::memory_order_relaxed);
+        for (const TraceEvent &ev : events) {
+            out += first ? "{\"name\":" : ",{\"name\":";
+            first = false;
+            appendJsonString(out, ev.name);
+            const double ts = static_cast<double>(static_cast<int64_t>(ev.start - traceStart.ticks)) * usPerTick;
+            std::snprintf(numbers, sizeof(numbers),
+                          ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                          ts, (ev.end - ev.start) * usPerTick, pid, trace.tid);
+            out += numbers;
+        }
+        if (retired) {
+            it = reg.threads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    out += "],\"displayTimeUnit\":\"ns\"}\n";
+    return out;
+}
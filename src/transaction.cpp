@@ -0,0 +1,56 @@
+#include "transaction.hpp"
+
+#include <utility>
+
+/******************************************************************************
+ * Transaction
+ *****************************************************************************/
+Transaction::Transaction(ConcurrentHashMap &map, ConcurrentHashMap::CommitHook onCommit)
+    : map_(&map), onCommit_(std::move(onCommit)) {}
+
+const ConcurrentHashMap::BatchWrite* Transaction::findWrite(const std::string &key) const {
+    // Latest write wins; transactions are small, so a linear scan is cheapest
+    for (auto it = writes_.rbegin(); it != writes_.rend(); ++it) {
+        if (it->key == key) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+bool Transaction::get(const std::string &key, std::string &outVal) {
+    if (const ConcurrentHashMap::BatchWrite *w = findWrite(key)) {
+        if (w->remove) {
+            return false;
+        }
+        outVal = w->value;
+        return true;
+    }
+    uint64_t version = 0;
+    const bool found = map_->get(key, outVal, version);
+    bool seen = false;
+    for (const auto &r : reads_) {
+        seen = seen || r.first == key;
+    }
+    // The first read is the one the transaction's decisions were based on
+    if (!seen) {
+        reads_.emplace_back(key, found ? version : 0);
+    }
+    return found;
+}
+
+void Transaction::put(const std::string &key, const std::string &value, uint64_t expireAtMs) {
+    writes_.push_back({key, value, expireAtMs, false});
+}
+
+void Transaction::remove(const std::string &key) {
+    writes_.push_back({key, std::string(), 0, true});
+}
+
+bool Transaction::commit() {
+    if (done_) {
+        return false;
+    }
+    done_ = true;
+    return map_->commitBatch(reads_, writes_, onCommit_);
+}
@@ -0,0 +1,147 @@
+#include "watch.hpp"
+#include "net_util.hpp"
+
+#include <algorithm>
+#include <unistd.h>
+
+/******************************************************************************
+ * WatchHub
+ *****************************************************************************/
+WatchHub::Subscriber::Subscriber(int s, const std::string &p, size_t capacity)
+    : Connection(s), pattern(p), prefix(!p.empty() && p.back() == '*'), queue(capacity)
+{
+    if (prefix) {
+        pattern.pop_back();
+    }
+}
+
+bool WatchHub::Subscriber::matches(const std::string &key) const {
+    return prefix ? key.compare(0, pattern.size(), pattern) == 0 : key == pattern;
+}
+
+WatchHub::WatchHub(size_t queueCapacity, size_t maxPendingKeys)
+    : queueCapacity_(queueCapacity), maxPendingKeys_(maxPendingKeys), list_(new SubscriberList())
+{
+}
+
+WatchHub::~WatchHub() {
+    stopSender();
+    SubscriberList *list = list_.load();
+    for (Subscriber *sub : list->subs) {
+        close(sub->sock);
+        delete sub;
+    }
+    delete list;
+}
+
+void WatchHub::subscribe(int sock, const std::string &pattern) {
+    std::lock_guard<std::mutex> lock(regMtx_);
+    startSender();
+    SubscriberList *old = list_.load();
+    SubscriberList *next = new SubscriberList(*old);
+    Subscriber *sub = new Subscriber(sock, pattern, queueCapacity_);
+    sub->outbox = "OK\n";
+    next->subs.push_back(sub);
+    list_.store(next, std::memory_order_release);
+    epochs_.retire(old);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    // The sender only learns about new sockets (and sends OK) when it wakes
+    wake();
+}
+
+void WatchHub::drop(const std::vector<Connection*> &conns) {
+    std::lock_guard<std::mutex> lock(regMtx_);
+    SubscriberList *old = list_.load();
+    SubscriberList *next = new SubscriberList();
+    for (Subscriber *s : old->subs) {
+        if (std::find(conns.begin(), conns.end(), s) == conns.end()) {
+            next->subs.push_back(s);
+        }
+    }
+    list_.store(next, std::memory_order_release);
+    count_.fetch_sub(conns.size(), std::memory_order_relaxed);
+    // Publishers may still be pushing into the queues under a Guard
+    epochs_.retire(old);
+    for (Connection *conn : conns) {
+        close(conn->sock);
+        epochs_.retire(static_cast<Subscriber*>(conn));
+    }
+}
+
+void WatchHub::publish(const std::string &key, const std::string &value, bool removed) {
+    if (count_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    bool queued = false;
+    {
+        EpochManager::Guard guard(epochs_);
+        for (Subscriber *sub : list_.load(std::memory_order_acquire)->subs) {
+            if (!sub->matches(key)) {
+                continue;
+            }
+            if (!sub->queue.tryPush(WatchEvent{key, value, removed})) {
+                sub->overflowed.store(true, std::memory_order_relaxed);
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+            queued = true;
+        }
+    }
+    if (queued) {
+        wake();
+    }
+}
+
+void WatchHub::collect(std::vector<Connection*> &out) {
+    // Only the sender thread removes subscribers, so the pointers stay valid
+    EpochManager::Guard guard(epochs_);
+    for (Subscriber *sub : list_.load(std::memory_order_acquire)->subs) {
+        out.push_back(sub);
+    }
+}
+
+bool WatchHub::backlog(const Connection &conn) const {
+    return !static_cast<const Subscriber&>(conn).order.empty();
+}
+
+void WatchHub::drain(Subscriber &sub) {
+    WatchEvent event;
+    while (sub.queue.tryPop(event)) {
+        auto it = sub.pending.find(event.key);
+        if (it != sub.pending.end()) {
+            // Coalesce: only the latest change to a key is delivered
+            it->second = std::move(event);
+        } else if (sub.pending.size() >= maxPendingKeys_) {
+            sub.overflowed.store(true, std::memory_order_relaxed);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            sub.order.push_back(event.key);
+            sub.pending.emplace(event.key, std::move(event));
+        }
+    }
+}
+
+void WatchHub::fill(Connection &conn) {
+    static const size_t kMaxOutbox = 64 * 1024;
+    Subscriber &sub = static_cast<Subscriber&>(conn);
+    drain(sub);
+    // Format only as much as the socket is taking; the rest stays pending,
+    // where later changes to the same keys still coalesce
+    size_t taken = 0;
+    while (taken < sub.order.size() && sub.outbox.size() < kMaxOutbox) {
+        auto it = sub.pending.find(sub.order[taken++]);
+        const WatchEvent &event = it->second;
+        if (event.removed) {
+            sub.outbox += "DELETE " + event.key + "\n";
+        } else if (lineSafe(event.value)) {
+            sub.outbox += "UPDATE " + event.key + " " + event.value + "\n";
+        } else {
+            sub.outbox += "UPDATEBLOB " + event.key + " " + std::to_string(event.value.size()) +
+                          "\n" + event.value + "\n";
+        }
+        sub.pending.erase(it);
+    }
+    sub.order.erase(sub.order.begin(), sub.order.begin() + taken);
+    if (sub.overflowed.exchange(false, std::memory_order_relaxed)) {
+        sub.outbox += "OVERFLOW\n";
+    }
+}
@@ -1,7 +1,13 @@
 #ifdef UNIT_TEST
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <thread>
 #include <vector>
 #include <string>
 #include <chrono>          // <-- for high_resolution_clock
@@ -10,6 +16,14 @@
 #include "datastore.hpp"
 #include "distributed_node.hpp"
 #include "concurrency.hpp"
+#include "accelerator.hpp"
+#include "net_util.hpp"
+#include "client.hpp"
+#include "hot_keys.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "transaction.hpp"
+#include "change_feed.hpp"
 
 
 // ---------------------------------------------------------
@@ -62,6 +76,21 @@ TEST(ConsistentHashRingTest, MultipleNodes) {
     }
 }
 
+TEST(ConsistentHashRingTest, ReplicaSetStartsAtOwner) {
+    ConsistentHashRing ring;
+    ring.addNode("nodeA");
+    ring.addNode("nodeB");
+    ring.addNode("nodeC");
+    for (int i = 0; i < 20; ++i) {
+        std::string key = "Key" + std::to_string(i);
+        std::vector<std::string> replicas = ring.getNodes(key, 5);
+        ASSERT_EQ(replicas.size(), (size_t)3);
+        EXPECT_EQ(replicas[0], ring.getNode(key));
+        std::sort(replicas.begin(), replicas.end());
+        EXPECT_TRUE(std::unique(replicas.begin(), replicas.end()) == replicas.end());
+    }
+}
+
 // ----------------------------------------------------------
 // 2) ConcurrentHashMap
 // ----------------------------------------------------------
@@ -91,6 +120,653 @@ TEST(ConcurrentHashMapTest, MultiplePuts) {
     EXPECT_EQ(val, "zval");
 }
 
+TEST(ConcurrentHashMapTest, RangeScanWithCursor) {
+    ConcurrentHashMap::Options ordered;
+    ordered.orderedIndex = true;
+    ConcurrentHashMap map(ordered);
+    for (const char *k : {"AAPL:1", "AAPL:2", "AAPL:3", "AMZN:1", "IBM:1"}) {
+        map.put(k, std::string("v_") + k);
+    }
+    map.put("AAPL:2", "updated");
+    map.remove("AAPL:3");
+
+    std::vector<std::pair<std::string, std::string>> page;
+    std::string cursor;
+    const std::string end = ConcurrentHashMap::prefixEnd("AAPL:");
+    ASSERT_TRUE(map.scan("AAPL:", end, 1, page, cursor));
+    ASSERT_EQ(page.size(), (size_t)1);
+    EXPECT_EQ(page[0].first, "AAPL:1");
+    EXPECT_EQ(cursor, "AAPL:2");
+
+    page.clear();
+    ASSERT_TRUE(map.scan(cursor, end, 10, page, cursor));
+    ASSERT_EQ(page.size(), (size_t)1);
+    EXPECT_EQ(page[0].first, "AAPL:2");
+    EXPECT_EQ(page[0].second, "updated");
+    EXPECT_TRUE(cursor.empty());
+
+    page.clear();
+    ASSERT_TRUE(map.scan("", "", 100, page, cursor));
+    EXPECT_EQ(page.size(), (size_t)4);
+
+    // The ordered index is opt-in
+    ConcurrentHashMap unordered;
+    EXPECT_FALSE(unordered.scan("", "", 10, page, cursor));
+}
+
+TEST(ConcurrentHashMapTest, ScanDuringConcurrentWrites) {
+    ConcurrentHashMap::Options ordered;
+    ordered.orderedIndex = true;
+    ConcurrentHashMap map(ordered);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int i = 0; i < 20000; ++i) {
+            std::string key = "k" + std::to_string(i % 500);
+            if (i % 3 == 0) {
+                map.remove(key);
+            } else {
+                map.put(key, "v");
+            }
+        }
+        done = true;
+    });
+    while (!done) {
+        std::vector<std::pair<std::string, std::string>> page;
+        std::string cursor;
+        ASSERT_TRUE(map.scan("", "", 1000, page, cursor));
+        for (size_t i = 1; i < page.size(); ++i) {
+            ASSERT_LT(page[i - 1].first, page[i].first);
+        }
+    }
+    writer.join();
+}
+
+TEST(ConcurrentHashMapTest, ArtEngineMatchesHashEngine) {
+    ConcurrentHashMap::Options opts;
+    opts.engine = ConcurrentHashMap::Engine::ART;
+    ConcurrentHashMap art(opts);
+    ConcurrentHashMap::Options ordered;
+    ordered.orderedIndex = true;
+    ConcurrentHashMap hash(ordered);
+    for (int i = 0; i < 3000; ++i) {
+        std::string key = "user:" + std::to_string(i % 1000) + (i % 7 == 0 ? "" : ":x");
+        if (i % 5 == 0) {
+            EXPECT_EQ(art.remove(key), hash.remove(key));
+        } else {
+            art.put(key, std::to_string(i));
+            hash.put(key, std::to_string(i));
+        }
+    }
+    EXPECT_EQ(art.size(), hash.size());
+
+    std::vector<std::pair<std::string, std::string>> a, h;
+    std::string cursorA, cursorH;
+    const std::string end = ConcurrentHashMap::prefixEnd("user:1");
+    ASSERT_TRUE(art.scan("user:1", end, 100000, a, cursorA));
+    ASSERT_TRUE(hash.scan("user:1", end, 100000, h, cursorH));
+    EXPECT_EQ(a, h);
+    EXPECT_FALSE(a.empty());
+}
+
+TEST(AdaptiveRadixTreeTest, PrefixKeysAndNodeGrowth) {
+    AdaptiveRadixTree tree;
+    // Keys that are prefixes of each other, the empty key and embedded '\0'
+    std::vector<std::string> keys = {"", "A", "AB", "ABC", "ABD", std::string("A\0B", 3), "B"};
+    for (int b = 0; b < 256; ++b) {
+        keys.push_back("wide" + std::string(1, static_cast<char>(b)));
+    }
+    for (const auto &k : keys) {
+        EXPECT_TRUE(tree.insert(new ArtLeaf(k)));
+    }
+    ArtLeaf dup("AB");
+    EXPECT_FALSE(tree.insert(&dup));
+    EXPECT_EQ(tree.size(), keys.size());
+    for (const auto &k : keys) {
+        ASSERT_NE(tree.lookup(k), nullptr);
+        EXPECT_EQ(tree.lookup(k)->key, k);
+    }
+    EXPECT_EQ(tree.lookup("ABCD"), nullptr);
+
+    std::vector<std::string> sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    EXPECT_EQ(tree.scan("", "", keys.size()), sorted);
+    std::vector<std::string> ab = {"AB", "ABC", "ABD"};
+    EXPECT_EQ(tree.scan("AB", "AC", 10), ab);
+
+    EXPECT_TRUE(tree.remove("AB"));
+    EXPECT_FALSE(tree.remove("AB"));
+    EXPECT_EQ(tree.lookup("AB"), nullptr);
+    ASSERT_NE(tree.lookup("ABC"), nullptr);
+    EXPECT_TRUE(tree.remove("ABC"));
+    EXPECT_TRUE(tree.remove("ABD"));
+    EXPECT_TRUE(tree.scan("AB", "AC", 10).empty());
+    ASSERT_NE(tree.lookup("A"), nullptr);
+}
+
+TEST(AdaptiveRadixTreeTest, ConcurrentReadersAndWriters) {
+    AdaptiveRadixTree tree;
+    const int kKeys = 2000;
+    for (int i = 0; i < kKeys; i += 2) {
+        tree.insert(new ArtLeaf("k" + std::to_string(i)));
+    }
+    std::atomic<bool> done(false);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; ++t) {
+        writers.emplace_back([&tree, t]() {
+            // Each writer owns the odd keys congruent to its id, so inserts and
+            // removes of one key never race with each other
+            for (int round = 0; round < 20; ++round) {
+                for (int i = 1 + 2 * t; i < kKeys; i += 4) {
+                    std::string key = "k" + std::to_string(i);
+                    if (round % 2 == 0) {
+                        tree.insert(new ArtLeaf(key));
+                    } else {
+                        tree.remove(key);
+                    }
+                }
+            }
+        });
+    }
+    std::thread reader([&]() {
+        while (!done) {
+            for (int i = 0; i < kKeys; i += 2) {
+                ArtLeaf *leaf = tree.lookup("k" + std::to_string(i));
+                ASSERT_NE(leaf, nullptr);
+            }
+            std::vector<std::string> all = tree.scan("", "", kKeys);
+            for (size_t i = 1; i < all.size(); ++i) {
+                ASSERT_LT(all[i - 1], all[i]);
+            }
+        }
+    });
+    for (auto &w : writers) {
+        w.join();
+    }
+    done = true;
+    reader.join();
+    EXPECT_EQ(tree.size(), (size_t)kKeys / 2);
+}
+
+TEST(ConcurrentHashMapTest, MemoryCapWithEachPolicy) {
+    for (auto kind : {EvictionKind::SampledLRU, EvictionKind::Clock, EvictionKind::TinyLFU}) {
+        ConcurrentHashMap::Options opts;
+        opts.numShards = 4;
+        opts.maxMemoryBytes = 64 * 1024;
+        opts.eviction = kind;
+        ConcurrentHashMap map(opts);
+        const std::string value(100, 'x');
+        std::string val;
+        for (int i = 0; i < 5000; ++i) {
+            map.put("key" + std::to_string(i), value);
+            // A small hot set that is read constantly
+            map.get("key" + std::to_string(i % 10), val);
+        }
+        EXPECT_LE(map.memoryUsage(), opts.maxMemoryBytes);
+        EXPECT_GT(map.evictions(), (size_t)4000);
+        EXPECT_EQ(map.size() + map.evictions(), (size_t)5000);
+        int hot = 0;
+        for (int i = 0; i < 10; ++i) {
+            hot += map.get("key" + std::to_string(i), val);
+        }
+        EXPECT_GE(hot, 8) << "policy " << static_cast<int>(kind);
+        // The newest write is never its own victim
+        EXPECT_TRUE(map.get("key4999", val));
+    }
+}
+
+TEST(ConcurrentHashMapTest, PluggableEvictionPolicy) {
+    // Always evicts the oldest resident slot
+    struct FirstSlotPolicy : EvictionPolicy {
+        void onInsert(const std::string &, EvictionMeta &) override {}
+        void onAccess(const std::string &, EvictionMeta &) override {}
+        size_t selectVictim(const std::vector<Resident> &) override { return 0; }
+    };
+    ConcurrentHashMap::Options opts;
+    opts.numShards = 1;
+    // Room for three entries: 2-byte key, 1-byte value, 64 bytes overhead each
+    opts.maxMemoryBytes = 3 * (2 + 1 + 64);
+    opts.evictionFactory = []() { return std::make_unique<FirstSlotPolicy>(); };
+    ConcurrentHashMap map(opts);
+    map.put("k1", "a");
+    map.put("k2", "b");
+    map.put("k3", "c");
+    map.put("k4", "d");
+    std::string val;
+    EXPECT_FALSE(map.get("k1", val));
+    EXPECT_TRUE(map.get("k4", val));
+    EXPECT_EQ(map.evictions(), (size_t)1);
+
+    // A tombstone picked as victim frees its history, but its key is already
+    // gone: no eviction is counted and nothing is reported erased
+    std::vector<std::string> erased;
+    opts.onErase = [&](const std::string &key) { erased.push_back(key); };
+    ConcurrentHashMap withSnapshot(opts);
+    withSnapshot.put("k1", "a");
+    withSnapshot.put("k2", "b");
+    auto snap = withSnapshot.snapshot();
+    withSnapshot.remove("k1");
+    withSnapshot.put("k3", "c");
+    withSnapshot.put("k4", "d");
+    EXPECT_EQ(std::count(erased.begin(), erased.end(), "k1"), 0);
+    EXPECT_EQ(withSnapshot.evictions(), erased.size());
+    EXPECT_FALSE(snap->get("k1", val));
+}
+
+TEST(TimingWheelTest, FiresEachTimerOnceAcrossLevels) {
+    const uint64_t start = 1000;
+    TimingWheel wheel(start);
+    // Deltas landing in every level, plus one beyond the wheel's range
+    std::vector<uint64_t> deltas = {1, 255, 256, 300, 70000, 20000000, (uint64_t(1) << 33)};
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        keys.push_back("k" + std::to_string(i));
+    }
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        wheel.schedule(&keys[i], start + deltas[i]);
+    }
+    const std::string overdue = "overdue";
+    wheel.schedule(&overdue, start - 10);
+    EXPECT_EQ(wheel.size(), deltas.size() + 1);
+
+    // Fired timers keep key and deadline until cancelled
+    std::vector<TimingWheel::Timer*> due;
+    auto drain = [&]() {
+        for (TimingWheel::Timer *timer : due) {
+            wheel.cancel(timer);
+        }
+        due.clear();
+    };
+    wheel.advance(start + 1, due);
+    ASSERT_EQ(due.size(), (size_t)2);
+    for (size_t i = 1; i < deltas.size(); ++i) {
+        drain();
+        wheel.advance(start + deltas[i] - 1, due);
+        EXPECT_TRUE(due.empty()) << "fired early: k" << i;
+        wheel.advance(start + deltas[i], due);
+        ASSERT_EQ(due.size(), (size_t)1);
+        EXPECT_EQ(*due[0]->key, keys[i]);
+        EXPECT_EQ(due[0]->expireAtMs, start + deltas[i]);
+    }
+    drain();
+    EXPECT_EQ(wheel.size(), (size_t)0);
+}
+
+TEST(TimingWheelTest, CancelAndReschedule) {
+    const uint64_t start = 1000;
+    TimingWheel wheel(start);
+    const std::string a = "a", b = "b", c = "c";
+    TimingWheel::Timer *ta = wheel.schedule(&a, start + 10);
+    TimingWheel::Timer *tb = wheel.schedule(&b, start + 10);
+    wheel.schedule(&c, start + 10);
+    wheel.cancel(ta);
+    wheel.reschedule(tb, start + 70000);
+    EXPECT_EQ(wheel.size(), (size_t)2);
+
+    // Fired timers keep key and deadline until cancelled
+    std::vector<TimingWheel::Timer*> due;
+    auto drain = [&]() {
+        for (TimingWheel::Timer *timer : due) {
+            wheel.cancel(timer);
+        }
+        due.clear();
+    };
+    wheel.advance(start + 10, due);
+    ASSERT_EQ(due.size(), (size_t)1);
+    EXPECT_EQ(*due[0]->key, "c");
+    drain();
+    wheel.advance(start + 70000, due);
+    ASSERT_EQ(due.size(), (size_t)1);
+    EXPECT_EQ(*due[0]->key, "b");
+
+    // A limit stops between ticks; the rest fire on the next call
+    std::vector<std::string> keys(5);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = "k" + std::to_string(i);
+        wheel.schedule(&keys[i], start + 70001 + i);
+    }
+    drain();
+    wheel.advance(start + 80000, due, 2);
+    EXPECT_EQ(due.size(), (size_t)2);
+    drain();
+    wheel.advance(start + 80000, due);
+    EXPECT_EQ(due.size(), (size_t)3);
+    drain();
+    EXPECT_EQ(wheel.size(), (size_t)0);
+}
+
+TEST(ConcurrentHashMapTest, AtomicOperations) {
+    ConcurrentHashMap map;
+    std::string val;
+    uint64_t v1 = 0, v2 = 0;
+    EXPECT_TRUE(map.compareAndSwap("doc", 0, "a", v1));
+    EXPECT_FALSE(map.compareAndSwap("doc", 0, "b", v2));
+    ASSERT_TRUE(map.get("doc", val, v2));
+    EXPECT_EQ(v2, v1);
+    EXPECT_TRUE(map.compareAndSwap("doc", v1, "b", v2));
+    EXPECT_NE(v2, v1);
+    EXPECT_FALSE(map.compareAndSwap("doc", v1, "c", v2));
+
+    EXPECT_EQ(map.append("doc", "cd"), (size_t)3);
+    ASSERT_TRUE(map.get("doc", val));
+    EXPECT_EQ(val, "bcd");
+    int64_t n = 0;
+    EXPECT_FALSE(map.increment("doc", 1, n));
+    map.put("max", std::to_string(std::numeric_limits<int64_t>::max()));
+    EXPECT_FALSE(map.increment("max", 1, n));
+
+    // Concurrent increments are never lost, and each write reaches the hook
+    std::atomic<int> logged{0};
+    auto hook = [&](const std::string &, const std::string &, uint64_t) { ++logged; };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&]() {
+            int64_t r;
+            for (int i = 0; i < 1000; ++i) {
+                map.increment("hits", 1, r, hook);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    ASSERT_TRUE(map.increment("hits", -10, n));
+    EXPECT_EQ(n, 3990);
+    EXPECT_EQ(logged.load(), 4000);
+}
+
+TEST(ConcurrentHashMapTest, PutAndRemoveHooksFollowMapOrder) {
+    // Racing puts and removes reach the hooks in the order the map applied them,
+    // so the last hooked write always matches the final state
+    ConcurrentHashMap map;
+    std::mutex logMtx;
+    std::string lastLogged;
+    auto onPut = [&](const std::string &, const std::string &value, uint64_t) {
+        std::lock_guard<std::mutex> lock(logMtx);
+        lastLogged = value;
+    };
+    auto onRemove = [&](const std::string &) {
+        std::lock_guard<std::mutex> lock(logMtx);
+        lastLogged.clear();
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 2000; ++i) {
+                if ((i + t) % 5 == 0) {
+                    map.remove("k", onRemove);
+                } else {
+                    map.put("k", std::to_string(t) + "-" + std::to_string(i), 0, onPut);
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    std::string val;
+    if (!map.get("k", val)) {
+        val.clear();
+    }
+    EXPECT_EQ(val, lastLogged);
+}
+
+TEST(TransactionTest, AbortsOnConflictAndConservesTotals) {
+    ConcurrentHashMap map;
+    map.put("x", "1");
+    Transaction stale(map);
+    std::string val;
+    ASSERT_TRUE(stale.get("x", val));
+    stale.put("x", "2");
+    stale.put("y", "2");
+    map.put("x", "5");
+    EXPECT_FALSE(stale.commit());
+    EXPECT_FALSE(map.get("y", val));
+
+    // Concurrent transfers between accounts; every commit is all-or-nothing
+    const int kAccounts = 8;
+    for (int i = 0; i < kAccounts; ++i) {
+        map.put("acct" + std::to_string(i), "100");
+    }
+    std::atomic<int> aborts{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 500; ++i) {
+                const std::string from = "acct" + std::to_string((t + i) % kAccounts);
+                const std::string to = "acct" + std::to_string((t * 3 + i + 1) % kAccounts);
+                if (from == to) continue;
+                while (true) {
+                    Transaction txn(map);
+                    std::string a, b;
+                    txn.get(from, a);
+                    txn.get(to, b);
+                    txn.put(from, std::to_string(std::stoi(a) - 1));
+                    txn.put(to, std::to_string(std::stoi(b) + 1));
+                    if (txn.commit()) break;
+                    ++aborts;
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    int total = 0;
+    for (int i = 0; i < kAccounts; ++i) {
+        ASSERT_TRUE(map.get("acct" + std::to_string(i), val));
+        total += std::stoi(val);
+    }
+    EXPECT_EQ(total, kAccounts * 100);
+}
+
+TEST(SnapshotTest, SeesPointInTimeView) {
+    ConcurrentHashMap::Options ordered;
+    ordered.orderedIndex = true;
+    ConcurrentHashMap::Options art;
+    art.engine = ConcurrentHashMap::Engine::ART;
+    for (const auto &opts : {ordered, ConcurrentHashMap::Options(), art}) {
+        ConcurrentHashMap map(opts);
+        for (int i = 0; i < 100; ++i) {
+            map.put("k" + std::to_string(i), "old");
+        }
+        auto snap = map.snapshot();
+        for (int i = 0; i < 100; ++i) {
+            map.put("k" + std::to_string(i), "new");
+            map.put("k" + std::to_string(i), "newer");
+        }
+        map.remove("k7");
+        map.put("added", "x");
+        EXPECT_EQ(map.size(), (size_t)100);
+
+        std::string val;
+        EXPECT_FALSE(snap->get("added", val));
+        ASSERT_TRUE(snap->get("k7", val));
+        EXPECT_EQ(val, "old");
+        EXPECT_FALSE(map.get("k7", val));
+        size_t seen = 0;
+        snap->forEach([&](const std::string &, const std::string &value) {
+            EXPECT_EQ(value, "old");
+            ++seen;
+        });
+        EXPECT_EQ(seen, (size_t)100);
+        EXPECT_GT(map.retainedVersions(), (size_t)0);
+
+        // Nothing is freed while the snapshot is open
+        EXPECT_EQ(map.collectVersions(), (size_t)0);
+        snap.reset();
+        EXPECT_GT(map.collectVersions(), (size_t)0);
+        EXPECT_EQ(map.retainedVersions(), (size_t)0);
+        EXPECT_EQ(map.size(), (size_t)100);
+        ASSERT_TRUE(map.get("k8", val));
+        EXPECT_EQ(val, "newer");
+    }
+}
+
+TEST(SnapshotTest, ConsistentTotalsDuringTransfers) {
+    ConcurrentHashMap map;
+    const int kAccounts = 16;
+    for (int i = 0; i < kAccounts; ++i) {
+        map.put("acct" + std::to_string(i), "100");
+    }
+    std::atomic<bool> stop{false};
+    std::thread writer([&]() {
+        for (int i = 0; !stop; ++i) {
+            Transaction txn(map);
+            const std::string from = "acct" + std::to_string(i % kAccounts);
+            const std::string to = "acct" + std::to_string((i * 7 + 3) % kAccounts);
+            std::string a, b;
+            if (from == to || !txn.get(from, a) || !txn.get(to, b)) continue;
+            txn.put(from, std::to_string(std::stoi(a) - 1));
+            txn.put(to, std::to_string(std::stoi(b) + 1));
+            txn.commit();
+            if (i % 64 == 0) map.collectVersions();
+        }
+    });
+    for (int round = 0; round < 50; ++round) {
+        auto snap = map.snapshot();
+        int total = 0;
+        snap->forEach([&](const std::string &, const std::string &value) {
+            total += std::stoi(value);
+            // Let the writer run mid-scan
+            std::this_thread::yield();
+        });
+        EXPECT_EQ(total, kAccounts * 100);
+    }
+    stop = true;
+    writer.join();
+}
+
+TEST(ConcurrentHashMapTest, KeysExpire) {
+    for (auto engine : {ConcurrentHashMap::Engine::Hash, ConcurrentHashMap::Engine::ART}) {
+        ConcurrentHashMap::Options opts;
+        opts.engine = engine;
+        ConcurrentHashMap map(opts);
+        const uint64_t now = ConcurrentHashMap::nowMs();
+        map.put("short", "1", now + 30);
+        map.put("long", "2", now + 60000);
+        map.put("renewed", "3", now + 30);
+        map.put("renewed", "4");
+        map.put("past", "5", now - 1);
+
+        std::string val;
+        EXPECT_TRUE(map.get("short", val));
+        EXPECT_FALSE(map.get("past", val));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        // Lazy: invisible to reads before expire() has run
+        EXPECT_FALSE(map.get("short", val));
+        EXPECT_EQ(map.size(), (size_t)3);
+        EXPECT_EQ(map.expire(), (size_t)1);
+        EXPECT_EQ(map.size(), (size_t)2);
+        EXPECT_TRUE(map.get("long", val));
+        EXPECT_TRUE(map.get("renewed", val));
+        EXPECT_EQ(val, "4");
+    }
+}
+
+TEST(ConcurrentHashMapTest, PastExpiryRunsRemoveHooks) {
+    ConcurrentHashMap map;
+    std::vector<std::string> events;
+    auto onWrite = [&](const std::string &key, const std::string &, uint64_t) {
+        events.push_back("put " + key);
+    };
+    auto onRemove = [&](const std::string &key) { events.push_back("remove " + key); };
+    const uint64_t now = ConcurrentHashMap::nowMs();
+    map.put("k", "1", 0, onWrite, onRemove);
+    map.put("k", "2", now - 1, onWrite, onRemove);
+    EXPECT_EQ(events, (std::vector<std::string>{"put k", "remove k"}));
+
+    std::vector<ConcurrentHashMap::BatchWrite> committed;
+    ASSERT_TRUE(map.commitBatch({}, {{"a", "1", now - 1, false}, {"b", "2", 0, false}},
+                                [&](const std::vector<ConcurrentHashMap::BatchWrite> &writes) {
+                                    committed = writes;
+                                }));
+    ASSERT_EQ(committed.size(), (size_t)2);
+    EXPECT_TRUE(committed[0].remove);
+    EXPECT_TRUE(committed[0].value.empty());
+    EXPECT_FALSE(committed[1].remove);
+    std::string val;
+    EXPECT_FALSE(map.get("a", val));
+    EXPECT_TRUE(map.get("b", val));
+}
+
+TEST(ConcurrentHashMapTest, RePutKeepsOneTimerPerKey) {
+    for (auto engine : {ConcurrentHashMap::Engine::Hash, ConcurrentHashMap::Engine::ART}) {
+        ConcurrentHashMap::Options opts;
+        opts.engine = engine;
+        opts.numShards = 1;
+        ConcurrentHashMap map(opts);
+        const uint64_t now = ConcurrentHashMap::nowMs();
+        map.put("k", "v");
+        const size_t plain = map.memoryUsage();
+        map.put("k", "v", now + 60000);
+        const size_t timed = map.memoryUsage();
+        EXPECT_EQ(timed, plain + TimingWheel::kTimerBytes);
+        // Each re-put moves the key's one timer instead of adding another
+        for (int i = 0; i < 10000; ++i) {
+            map.put("k", "v", now + 60000 + i % 500);
+        }
+        EXPECT_EQ(map.memoryUsage(), timed);
+        map.put("k", "v");
+        EXPECT_EQ(map.memoryUsage(), plain);
+        map.put("k", "v", now + 20);
+        map.remove("k");
+        EXPECT_EQ(map.memoryUsage(), (size_t)0);
+
+        map.put("gone", "v", ConcurrentHashMap::nowMs() + 20);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        EXPECT_EQ(map.expire(), (size_t)1);
+        EXPECT_EQ(map.memoryUsage(), (size_t)0);
+    }
+}
+
+TEST(ConcurrentHashMapTest, CompressesLargeValues) {
+    // Codec round trips, including matches that reach into the dictionary
+    std::vector<std::string> samples;
+    for (int i = 0; i < 200; ++i) {
+        samples.push_back("{\"user\":" + std::to_string(i) + ",\"status\":\"active\",\"region\":\"eu-west\"}");
+    }
+    auto dict = CompressionDictionary::train(samples);
+    ASSERT_FALSE(dict->bytes().empty());
+    std::string packed, plain;
+    const std::string text = samples[7] + samples[8] + std::string(300, 'x');
+    ASSERT_TRUE(lzCompress(text, packed));
+    ASSERT_TRUE(lzDecompress(packed.data(), packed.size(), plain));
+    EXPECT_EQ(plain, text);
+    EXPECT_FALSE(lzCompress(samples[7], packed));
+    ASSERT_TRUE(lzCompress(samples[7], packed, dict.get()));
+    EXPECT_FALSE(lzDecompress(packed.data(), packed.size(), plain));
+    ASSERT_TRUE(lzDecompress(packed.data(), packed.size(), plain, dict.get()));
+    EXPECT_EQ(plain, samples[7]);
+    packed.resize(packed.size() / 2);
+    EXPECT_FALSE(lzDecompress(packed.data(), packed.size(), plain, dict.get()));
+
+    ConcurrentHashMap raw;
+    ConcurrentHashMap::Options opts;
+    opts.compressMinBytes = 32;
+    opts.compressionDictionary = dict;
+    ConcurrentHashMap map(opts);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        raw.put("k" + std::to_string(i), samples[i]);
+        map.put("k" + std::to_string(i), samples[i]);
+    }
+    map.put("short", "tiny");
+    // ~47-byte records shrink to ~13 bytes against the dictionary
+    EXPECT_GT(raw.memoryUsage(), map.memoryUsage() + samples.size() * 25);
+
+    std::string val;
+    Codec codec;
+    ASSERT_TRUE(map.getStored("k3", val, codec));
+    EXPECT_EQ(codec, Codec::LZDict);
+    ASSERT_TRUE(map.getStored("short", val, codec));
+    EXPECT_EQ(codec, Codec::None);
+    auto snap = map.snapshot();
+    EXPECT_EQ(map.append("k3", "!"), samples[3].size() + 1);
+    ASSERT_TRUE(map.get("k3", val));
+    EXPECT_EQ(val, samples[3] + "!");
+    ASSERT_TRUE(snap->get("k3", val));
+    EXPECT_EQ(val, samples[3]);
+}
+
 // ----------------------------------------------------------
 // 3) WriteAheadLog (WAL)
 // ----------------------------------------------------------
@@ -119,6 +795,199 @@ TEST(WALTest, Replay) {
     }
 }
 
+TEST(WALTest, ReplayKeepsAbsoluteExpiry) {
+    {
+        std::ofstream ofs("test_wal_ttl.log", std::ios::trunc);
+    }
+    const uint64_t now = ConcurrentHashMap::nowMs();
+    {
+        WriteAheadLog wal("test_wal_ttl.log");
+        wal.logPut("lapsed", "1", now - 1000);
+        wal.logPut("live", "2", now + 60000);
+    }
+    ConcurrentHashMap store;
+    WriteAheadLog walReader("test_wal_ttl.log");
+    walReader.replay(store);
+    std::string val;
+    EXPECT_FALSE(store.get("lapsed", val));
+    EXPECT_TRUE(store.get("live", val));
+    EXPECT_EQ(store.size(), (size_t)1);
+}
+
+TEST(WALTest, ReplaySkipsUncommittedBatch) {
+    {
+        std::ofstream ofs("test_wal_txn.log", std::ios::trunc);
+    }
+    {
+        WriteAheadLog wal("test_wal_txn.log");
+        wal.logPut("a", "0");
+        wal.logBatch({{"a", "1"}, {"b", "1"}, {"old", "", 0, true}});
+    }
+    {
+        // Crash mid-append: the second batch has no COMMIT
+        std::ofstream torn("test_wal_txn.log", std::ios::app);
+        torn << "TXN 2\nPUT a 2\nPUT b 2\n";
+    }
+    std::string val;
+    {
+        ConcurrentHashMap store;
+        store.put("old", "x");
+        WriteAheadLog walReader("test_wal_txn.log");
+        walReader.replay(store);
+        ASSERT_TRUE(store.get("a", val));
+        EXPECT_EQ(val, "1");
+        ASSERT_TRUE(store.get("b", val));
+        EXPECT_EQ(val, "1");
+        EXPECT_FALSE(store.get("old", val));
+        EXPECT_EQ(walReader.lastSequence(), (uint64_t)4);
+        // Appended after the torn batch has been cut off
+        walReader.logPut("c", "3");
+    }
+    // The write survives the next restart and sequence numbers keep rising
+    ConcurrentHashMap store;
+    WriteAheadLog walReader("test_wal_txn.log");
+    walReader.replay(store);
+    ASSERT_TRUE(store.get("c", val));
+    EXPECT_EQ(val, "3");
+    ASSERT_TRUE(store.get("a", val));
+    EXPECT_EQ(val, "1");
+    EXPECT_EQ(walReader.lastSequence(), (uint64_t)5);
+}
+
+TEST(WALTest, ReplayRefusesCorruptRecordBeforeCommittedOnes) {
+    {
+        std::ofstream ofs("test_wal_corrupt.log", std::ios::trunc);
+        ofs << "PUT a 1\nXPUT b 2\nPUT c 3\nTXN 1\nPUT d 4\nCOMMIT\n";
+    }
+    const auto sizeBefore = std::ifstream("test_wal_corrupt.log", std::ios::ate).tellg();
+    EXPECT_EXIT({
+        ConcurrentHashMap store;
+        WriteAheadLog walReader("test_wal_corrupt.log");
+        walReader.replay(store);
+        std::exit(0);
+    }, ::testing::ExitedWithCode(EXIT_FAILURE), "Corrupt WAL record at offset 8");
+    // Nothing after the corrupt record was cut off
+    EXPECT_EQ(std::ifstream("test_wal_corrupt.log", std::ios::ate).tellg(), sizeBefore);
+
+    {
+        std::ofstream ofs("test_wal_corrupt.log", std::ios::trunc);
+        ofs << "PUT a 1\nTXN x\nPUT c 3\n";
+    }
+    EXPECT_EXIT({
+        ConcurrentHashMap store;
+        WriteAheadLog walReader("test_wal_corrupt.log");
+        walReader.replay(store);
+        std::exit(0);
+    }, ::testing::ExitedWithCode(EXIT_FAILURE), "Corrupt WAL record");
+
+    // A blob length past the end of the file is never allocated
+    {
+        std::ofstream ofs("test_wal_corrupt.log", std::ios::trunc);
+        ofs << "PUT a 1\nPUTBLOB b 0 99999999999999\nxyz\nPUT c 3\n";
+    }
+    EXPECT_EXIT({
+        ConcurrentHashMap store;
+        WriteAheadLog walReader("test_wal_corrupt.log");
+        walReader.replay(store);
+        std::exit(0);
+    }, ::testing::ExitedWithCode(EXIT_FAILURE), "Corrupt WAL record at offset 8");
+
+    // ...but a blob body cut short by a crash is still a torn tail
+    {
+        std::ofstream ofs("test_wal_corrupt.log", std::ios::trunc);
+        ofs << "PUT a 1\nPUTBLOB b 0 100\nxyz";
+    }
+    ConcurrentHashMap store;
+    WriteAheadLog walReader("test_wal_corrupt.log");
+    walReader.replay(store);
+    std::string val;
+    EXPECT_TRUE(store.get("a", val));
+    EXPECT_FALSE(store.get("b", val));
+    EXPECT_EQ(std::ifstream("test_wal_corrupt.log", std::ios::ate).tellg(), 8);
+}
+
+TEST(WALTest, SequenceNumbersFeedChangeFeed) {
+    {
+        std::ofstream ofs("test_wal_feed.log", std::ios::trunc);
+    }
+    {
+        WriteAheadLog wal("test_wal_feed.log");
+        for (int i = 0; i < 8; ++i) {
+            wal.logPut("k" + std::to_string(i), std::to_string(i));
+        }
+        wal.logBatch({{"a", "1"}, {"k0", "", 0, true}});
+        EXPECT_EQ(wal.lastSequence(), (uint64_t)10);
+    }
+    // Replay restores the same numbering; only the last 4 events are retained
+    ChangeFeed feed(4);
+    ConcurrentHashMap store;
+    WriteAheadLog wal("test_wal_feed.log");
+    wal.attachFeed(&feed);
+    wal.replay(store);
+    wal.logPut("b", "2", 12345);
+    EXPECT_EQ(feed.firstSequence(), (uint64_t)8);
+    EXPECT_EQ(feed.lastSequence(), (uint64_t)11);
+
+    std::vector<ChangeEvent> events;
+    EXPECT_FALSE(feed.read(7, 10, events));
+    ASSERT_TRUE(feed.read(9, 2, events));
+    ASSERT_EQ(events.size(), (size_t)2);
+    EXPECT_EQ(events[0].key, "a");
+    EXPECT_EQ(events[1].op, ChangeEvent::Op::Remove);
+    EXPECT_TRUE(feed.waitFor(11, std::chrono::milliseconds(0)));
+    EXPECT_FALSE(feed.waitFor(12, std::chrono::milliseconds(1)));
+
+    // Wire round trip keeps the expiry and the value
+    ChangeEvent parsed;
+    events.clear();
+    ASSERT_TRUE(feed.read(11, 1, events));
+    ASSERT_TRUE(ChangeEvent::parse(events[0].format(), parsed));
+    EXPECT_EQ(parsed.seq, (uint64_t)11);
+    EXPECT_EQ(parsed.expireAtMs, (uint64_t)12345);
+    EXPECT_EQ(parsed.value, "2");
+    // Values with line breaks are framed by length
+    events[0].value = "two\nlines";
+    const std::string framed = events[0].format();
+    size_t blobLen = 0;
+    ASSERT_TRUE(ChangeEvent::parse(framed.substr(0, framed.find('\n')), parsed, &blobLen));
+    EXPECT_EQ(blobLen, (size_t)9);
+}
+
+TEST(ChangeFeedTest, WindowIsBoundedByBytes) {
+    ChangeFeed feed(1000, 16, 64 * 1024);
+    const std::string value(10 * 1024, 'v');
+    for (uint64_t seq = 1; seq <= 20; ++seq) {
+        ChangeEvent e;
+        e.seq = seq;
+        e.key = "k" + std::to_string(seq);
+        e.value = value;
+        std::vector<ChangeEvent> events;
+        events.push_back(std::move(e));
+        feed.append(std::move(events));
+    }
+    EXPECT_LE(feed.retainedBytes(), (size_t)64 * 1024);
+    EXPECT_EQ(feed.lastSequence(), (uint64_t)20);
+    const uint64_t first = feed.firstSequence();
+    EXPECT_GT(first, (uint64_t)1);
+    std::vector<ChangeEvent> events;
+    EXPECT_FALSE(feed.read(first - 1, 1, events));
+    ASSERT_TRUE(feed.read(first, 100, events));
+    EXPECT_EQ(events.size(), (size_t)(21 - first));
+    EXPECT_EQ(events.back().value, value);
+
+    // A record over the whole budget empties the window instead of pinning it
+    ChangeEvent big;
+    big.seq = 21;
+    big.key = "big";
+    big.value.assign(128 * 1024, 'b');
+    std::vector<ChangeEvent> batch;
+    batch.push_back(std::move(big));
+    feed.append(std::move(batch));
+    EXPECT_EQ(feed.retainedBytes(), (size_t)0);
+    EXPECT_EQ(feed.firstSequence(), (uint64_t)22);
+    EXPECT_EQ(feed.lastSequence(), (uint64_t)21);
+}
+
 // ----------------------------------------------------------
 // 4) ColumnarTable
 // ----------------------------------------------------------
@@ -163,6 +1032,87 @@ TEST(ColumnarTableTest, GetColumn) {
     EXPECT_EQ(t.getColumn(1)[2], 300);
 }
 
+TEST(ColumnarTableTest, MappedColumnFiles) {
+    ColumnarTable t;
+    for (int i = 0; i < 5000; ++i) {
+        t.addRow({i, 5000 - i});
+    }
+    const std::string dir = "/tmp/dist_tests_columns_" + std::to_string(::getpid());
+    // 1024-row chunks => 5 chunks per column, most pruned by zone maps
+    ASSERT_TRUE(t.saveColumns(dir, 1024));
+
+    ColumnarTable mapped;
+    ASSERT_TRUE(mapped.openMapped(dir));
+    EXPECT_TRUE(mapped.isMapped());
+    EXPECT_EQ(mapped.getNumRows(), (size_t)5000);
+    EXPECT_EQ(mapped.getNumColumns(), (size_t)2);
+    EXPECT_EQ(mapped.filterLessThan(0, 2500), t.filterLessThan(0, 2500));
+    EXPECT_EQ(mapped.filterLessThan(1, 1), t.filterLessThan(1, 1));
+    EXPECT_EQ(mapped.filterLessThan(0, 100000), (size_t)5000);
+    EXPECT_THROW(mapped.addRow({1, 2}), std::logic_error);
+
+    // Saving over mapped files replaces them; the old mapping keeps reading
+    // the old contents instead of faulting past a truncated end
+    ColumnarTable small;
+    small.addRow({1, 2});
+    ASSERT_TRUE(small.saveColumns(dir, 1024));
+    EXPECT_EQ(mapped.filterLessThan(0, 100000), (size_t)5000);
+    ColumnarTable reopened;
+    ASSERT_TRUE(reopened.openMapped(dir));
+    EXPECT_EQ(reopened.getNumRows(), (size_t)1);
+
+    ColumnarTable missing;
+    EXPECT_FALSE(missing.openMapped("no_such_dir"));
+
+    // A corrupt row count is rejected rather than mapped past the data
+    const std::string col0 = dir + "/col_0.dcol";
+    {
+        std::fstream f(col0, std::ios::in | std::ios::out | std::ios::binary);
+        const uint64_t rows = (uint64_t(1) << 62) + 1;
+        f.seekp(offsetof(ColumnFileHeader, numRows));
+        f.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    }
+    ColumnarTable corrupt;
+    EXPECT_FALSE(corrupt.openMapped(dir));
+
+    std::remove(col0.c_str());
+    std::remove((dir + "/col_1.dcol").c_str());
+    ::rmdir(dir.c_str());
+}
+
+TEST(ColumnarTableTest, SortedIndexMaintainedOnAppend) {
+    ColumnarTable t;
+    for (int i = 0; i < 3000; ++i) {
+        t.addRow({(i * 37) % 1000, i});
+    }
+    ASSERT_TRUE(t.createIndex(0));
+    EXPECT_TRUE(t.hasIndex(0));
+    EXPECT_FALSE(t.createIndex(5));
+
+    // Enough appends to force at least one delta merge
+    for (int i = 3000; i < 6000; ++i) {
+        t.addRow({(i * 37) % 1000, i});
+    }
+    const auto &col = t.getColumn(0);
+    size_t expected = 0;
+    std::vector<size_t> expectedRows;
+    for (size_t r = 0; r < col.size(); ++r) {
+        if (col[r] >= 100 && col[r] < 110) {
+            ++expected;
+            expectedRows.push_back(r);
+        }
+    }
+    EXPECT_EQ(t.countInRange(0, 100, 110), expected);
+    EXPECT_EQ(t.rowsInRange(0, 100, 110), expectedRows);
+    EXPECT_EQ(t.filterLessThan(0, 500), ColumnarTable::countLessThan(col.data(), col.size(), 500));
+
+    // Same answers from the scan path
+    t.dropIndex(0);
+    EXPECT_FALSE(t.hasIndex(0));
+    EXPECT_EQ(t.countInRange(0, 100, 110), expected);
+    EXPECT_EQ(t.rowsInRange(0, 100, 110), expectedRows);
+}
+
 // ----------------------------------------------------------
 // 5) GPUAcceleratedAnalytics
 // ----------------------------------------------------------
@@ -172,6 +1122,66 @@ TEST(GPUAcceleratedAnalyticsTest, FallbackOrGPU) {
     EXPECT_EQ(cnt, (size_t)2); // 5 and 10 are < 15
 }
 
+TEST(GPUAcceleratedAnalyticsTest, CpuParallelMatchesScalar) {
+    // Large enough to take the multi-threaded path, odd size to hit the tail
+    std::vector<int> col(CpuParallelAccelerator::kMinParallelRows * 2 + 7);
+    size_t expected = 0;
+    for (size_t i = 0; i < col.size(); ++i) {
+        col[i] = static_cast<int>((i * 7919) % 10007) - 5000;
+        expected += col[i] < 123 ? 1 : 0;
+    }
+    CpuParallelAccelerator cpu(4);
+    EXPECT_EQ(cpu.filterLessThan(col.data(), col.size(), 123), expected);
+    EXPECT_EQ(ColumnarTable::countLessThan(col.data(), col.size(), 123), expected);
+    EXPECT_EQ(GPUAcceleratedAnalytics::filterLessThanGPU(col, 123), expected);
+}
+
+TEST(GPUAcceleratedAnalyticsTest, ResidentBuffersAndBatchedPredicates) {
+    CpuParallelAccelerator accel(2);
+    std::vector<int> prices = {10, 20, 30, 40, 50};
+    std::vector<int> volumes = {5, 500, 5000};
+    AcceleratorBuffer p = accel.upload(prices.data(), prices.size());
+    AcceleratorBuffer v = accel.upload(volumes.data(), volumes.size());
+    ASSERT_NE(p, (AcceleratorBuffer)0);
+    EXPECT_EQ(accel.bufferSize(v), (size_t)3);
+
+    std::vector<size_t> counts;
+    ASSERT_TRUE(accel.countLessThan({{p, 25}, {v, 1000}, {p, 100}, {p, 0}}, counts));
+    EXPECT_EQ(counts, (std::vector<size_t>{2, 2, 5, 0}));
+
+    // Appends extend the resident copy; later host changes do not leak in
+    std::vector<int> more = {1, 2};
+    ASSERT_TRUE(accel.append(p, more.data(), more.size()));
+    prices[0] = 1000;
+    ASSERT_TRUE(accel.countLessThan({{p, 25}}, counts));
+    EXPECT_EQ(counts[0], (size_t)4);
+
+    accel.release(p);
+    EXPECT_FALSE(accel.countLessThan({{p, 25}}, counts));
+    EXPECT_FALSE(accel.append(p, more.data(), more.size()));
+}
+
+TEST(GPUAcceleratedAnalyticsTest, PluggableAccelerator) {
+    struct FixedAccelerator : AnalyticsAccelerator {
+        const char* name() const override { return "fixed"; }
+        AcceleratorBuffer upload(const int *, size_t) override { return 1; }
+        bool append(AcceleratorBuffer, const int *, size_t) override { return true; }
+        void release(AcceleratorBuffer) override {}
+        size_t bufferSize(AcceleratorBuffer) const override { return 0; }
+        bool countLessThan(const std::vector<LessThanPredicate> &preds,
+                           std::vector<size_t> &counts) override {
+            counts.assign(preds.size(), 42);
+            return true;
+        }
+    };
+    GPUAcceleratedAnalytics::setAccelerator(std::make_shared<FixedAccelerator>());
+    EXPECT_STREQ(GPUAcceleratedAnalytics::accelerator()->name(), "fixed");
+    EXPECT_EQ(GPUAcceleratedAnalytics::filterLessThanGPU({1, 2, 3}, 10), (size_t)42);
+
+    GPUAcceleratedAnalytics::setAccelerator(nullptr);
+    EXPECT_EQ(GPUAcceleratedAnalytics::filterLessThanGPU({1, 2, 3}, 3), (size_t)2);
+}
+
 // ----------------------------------------------------------
 // 6) DistributedNode
 // ----------------------------------------------------------
@@ -193,9 +1203,860 @@ TEST(DistributedNodeTest, BasicOps) {
     EXPECT_FALSE(node.get("Alpha", val));
 }
 
+TEST(DistributedNodeTest, ScanCommand) {
+    {
+        std::ofstream ofs("test_wal_scan.log", std::ios::trunc);
+    }
+    ConcurrentHashMap::Options ordered;
+    ordered.orderedIndex = true;
+    DistributedNode node("ScanNode", "test_wal_scan.log", 6005, ordered);
+    node.put("AAPL:1", "1");
+    node.put("AAPL:2", "2");
+    node.put("IBM:1", "3");
+
+    int sock = connectTo("127.0.0.1", 6005);
+    ASSERT_GE(sock, 0);
+    ASSERT_TRUE(sendAll(sock, "SCAN AAPL: AAPL; 1\n"));
+    SocketReader reader(sock);
+    std::string line;
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(line, "ENTRY AAPL:1 1");
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(line, "END AAPL:2");
+    close(sock);
+
+    // Values that are not one token are length-prefixed by SCAN and refused by GET
+    node.put("AAPL:3", "x y");
+    sock = connectTo("127.0.0.1", 6005);
+    ASSERT_GE(sock, 0);
+    ASSERT_TRUE(sendAll(sock, "SCAN AAPL:3 AAPL; 5\n"));
+    SocketReader blobReader(sock);
+    ASSERT_TRUE(blobReader.readLine(line));
+    EXPECT_EQ(line, "ENTRYBLOB AAPL:3 3");
+    ASSERT_TRUE(blobReader.readLine(line));
+    EXPECT_EQ(line, "x y");
+    ASSERT_TRUE(blobReader.readLine(line));
+    EXPECT_EQ(line, "END -");
+    close(sock);
+    sock = connectTo("127.0.0.1", 6005);
+    ASSERT_GE(sock, 0);
+    ASSERT_TRUE(sendAll(sock, "GET AAPL:3\n"));
+    SocketReader getReader(sock);
+    ASSERT_TRUE(getReader.readLine(line));
+    EXPECT_EQ(line, "ERROR binary value, use GETBLOB");
+    close(sock);
+}
+
+TEST(DistributedNodeTest, ClientScanMergesNodes) {
+    std::vector<NodeAddress> cluster = {
+        {"ScanA", "127.0.0.1", 6016},
+        {"ScanB", "127.0.0.1", 6017},
+    };
+    ConcurrentHashMap::Options ordered;
+    ordered.orderedIndex = true;
+    std::vector<std::unique_ptr<DistributedNode>> nodes;
+    for (const auto &addr : cluster) {
+        const std::string wal = "test_wal_" + addr.name + ".log";
+        std::ofstream(wal, std::ios::trunc);
+        nodes.push_back(std::make_unique<DistributedNode>(addr.name, wal, addr.port, ordered));
+        nodes.back()->setCluster(cluster, 1);
+    }
+    DataStoreClient client(cluster);
+    for (int i = 10; i < 40; ++i) {
+        ASSERT_TRUE(client.put("k" + std::to_string(i), "v" + std::to_string(i)));
+    }
+    std::vector<std::pair<std::string, std::string>> page;
+    ASSERT_TRUE(client.scan("k15", "", 8, page));
+    ASSERT_EQ(page.size(), (size_t)8);
+    for (size_t i = 0; i < page.size(); ++i) {
+        EXPECT_EQ(page[i].first, "k" + std::to_string(15 + i));
+        EXPECT_EQ(page[i].second, "v" + std::to_string(15 + i));
+    }
+    ASSERT_TRUE(client.scan("k36", "k38", 10, page));
+    EXPECT_EQ(page.size(), (size_t)2);
+    ASSERT_TRUE(client.putBlob("k40", "two\nlines"));
+    ASSERT_TRUE(client.scan("k39", "", 10, page));
+    ASSERT_EQ(page.size(), (size_t)2);
+    EXPECT_EQ(page[1].second, "two\nlines");
+}
+
+TEST(DistributedNodeTest, PutWithTTLOverWire) {
+    {
+        std::ofstream ofs("test_wal_ttl_node.log", std::ios::trunc);
+    }
+    DistributedNode node("TTLNode", "test_wal_ttl_node.log", 6006);
+    int sock = connectTo("127.0.0.1", 6006);
+    ASSERT_GE(sock, 0);
+    ASSERT_TRUE(sendAll(sock, "PUT session abc PX 30\n"));
+    close(sock);
+
+    std::string val;
+    for (int i = 0; i < 100 && !node.get("session", val); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_FALSE(node.get("session", val));
+
+    // ACK: the reply arrives only after the write is stored
+    DataStoreClient client({{"TTLNode", "127.0.0.1", 6006}});
+    ASSERT_TRUE(client.putAcked("acked", "1"));
+    EXPECT_TRUE(node.get("acked", val));
+    ASSERT_TRUE(client.putAcked("acked", "2", 60000));
+    ASSERT_TRUE(node.get("acked", val));
+    EXPECT_EQ(val, "2");
+}
+
+TEST(HotKeyTrackerTest, FindsHeavyHittersInNoise) {
+    HotKeyTracker tracker(16);
+    for (int i = 0; i < 20000; ++i) {
+        tracker.record("noise" + std::to_string(i));
+        if (i % 4 == 0) tracker.record("AAPL");
+        if (i % 10 == 0) tracker.record("TSLA");
+    }
+    std::vector<HotKey> top = tracker.top(2);
+    ASSERT_EQ(top.size(), (size_t)2);
+    EXPECT_EQ(top[0].key, "AAPL");
+    EXPECT_EQ(top[1].key, "TSLA");
+    // Space-Saving never underestimates
+    EXPECT_GE(top[0].count, (uint64_t)5000);
+    EXPECT_LE(top[0].count - top[0].error, (uint64_t)5000);
+    EXPECT_TRUE(tracker.isHot("AAPL", 1000));
+    tracker.decay();
+    EXPECT_FALSE(tracker.isHot("AAPL", top[0].count));
+}
+
+TEST(DistributedNodeTest, HotKeyStatsAndNearCache) {
+    {
+        std::ofstream ofs("test_wal_nearcache.log", std::ios::trunc);
+    }
+    DistributedNode node("CacheNode", "test_wal_nearcache.log", 6007);
+    node.setHotKeyThreshold(3);
+    DataStoreClient::Options opts;
+    opts.nearCache = true;
+    DataStoreClient client({{"CacheNode", "127.0.0.1", 6007}}, opts);
+    for (int i = 0; i < 200 && !client.nearCacheReady(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_TRUE(client.nearCacheReady());
+
+    node.put("AAPL", "179");
+    node.put("IBM", "140");
+    std::string val;
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(client.get("AAPL", val));
+        EXPECT_EQ(val, "179");
+    }
+    ASSERT_TRUE(client.get("IBM", val));
+    EXPECT_EQ(client.nearCacheSize(), (size_t)1);
+    EXPECT_GT(client.nearCacheHits(), (size_t)0);
+
+    // Plain readers of a hot key are not offered a lease
+    int sock = connectTo("127.0.0.1", 6007);
+    ASSERT_GE(sock, 0);
+    ASSERT_TRUE(sendAll(sock, "GET AAPL\n"));
+    SocketReader reader(sock);
+    std::string line;
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(line, "VALUE 179");
+    close(sock);
+
+    std::vector<HotKey> hot;
+    ASSERT_TRUE(client.hotKeys("CacheNode", 5, hot));
+    ASSERT_FALSE(hot.empty());
+    EXPECT_EQ(hot[0].key, "AAPL");
+
+    // A write anywhere invalidates the cached copy
+    node.put("AAPL", "180");
+    bool fresh = false;
+    for (int i = 0; i < 200 && !fresh; ++i) {
+        fresh = client.get("AAPL", val) && val == "180";
+        if (!fresh) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(fresh);
+}
+
+TEST(MetricsTest, CountersAndHistogramsMergeThreads) {
+    MetricsRegistry registry;
+    Counter &ops = registry.counter("ops_total", "Operations");
+    LatencyHistogram &latency = registry.histogram("op_seconds", "Operation time");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 12; ++t) {
+        threads.emplace_back([&]() {
+            for (uint64_t i = 1; i <= 1000; ++i) {
+                ops.add();
+                latency.record(i * 1000);  // 1 us .. 1 ms
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    EXPECT_EQ(ops.value(), (uint64_t)12000);
+    EXPECT_EQ(&registry.counter("ops_total", "Operations"), &ops);
+
+    const LatencyHistogram::Snapshot snap = latency.snapshot();
+    EXPECT_EQ(snap.count, (uint64_t)12000);
+    EXPECT_EQ(snap.sumNanos, (uint64_t)12 * 500500 * 1000);
+    // Bucket upper bounds are within 25% of the true percentile
+    for (double p : {50.0, 90.0, 99.0}) {
+        const double exact = p * 10 * 1000;
+        EXPECT_GE(snap.percentile(p), exact);
+        EXPECT_LE(snap.percentile(p), exact * 1.25);
+    }
+}
+
+TEST(MetricsTest, PrometheusTextFormat) {
+    MetricsRegistry registry;
+    registry.counter("req_total{cmd=\"GET\"}", "Requests").add(3);
+    registry.counter("req_total{cmd=\"PUT\"}", "Requests").add(2);
+    registry.gauge("queue_depth", "Queued tasks", []() { return 7.0; });
+    registry.histogram("wait_seconds", "Wait").record(1500);
+
+    const std::string text = registry.prometheusText();
+    EXPECT_NE(text.find("# TYPE req_total counter\nreq_total{cmd=\"GET\"} 3\nreq_total{cmd=\"PUT\"} 2\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("# TYPE queue_depth gauge\nqueue_depth 7\n"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE wait_seconds histogram\n"), std::string::npos);
+    EXPECT_NE(text.find("wait_seconds_bucket{le=\"1.024e-06\"} 0\n"), std::string::npos);
+    EXPECT_NE(text.find("wait_seconds_bucket{le=\"2.048e-06\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("wait_seconds_bucket{le=\"+Inf\"} 1\nwait_seconds_sum 1.5e-06\nwait_seconds_count 1\n"),
+              std::string::npos);
+}
+
+TEST(TraceTest, ChromeJsonDrainsThreadBuffers) {
+    traceChromeJson();  // discard events from earlier tests
+    {
+        TraceScope outer("test.outer");
+        TraceScope inner("test.inner");
+    }
+    std::thread worker([]() { TraceScope scope("test.worker"); });
+    worker.join();
+
+    const std::string json = traceChromeJson();
+    EXPECT_EQ(json.compare(0, 16, "{\"traceEvents\":["), 0);
+    for (const char *name : {"test.outer", "test.inner", "test.worker"}) {
+        EXPECT_NE(json.find("{\"name\":\"" + std::string(name) + "\",\"ph\":\"X\",\"ts\":"),
+                  std::string::npos) << name;
+    }
+    // Inner closes first, so it is recorded before outer
+    EXPECT_LT(json.find("test.inner"), json.find("test.outer"));
+    // Drained events are not returned again
+    EXPECT_EQ(traceChromeJson(), "{\"traceEvents\":[],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+TEST(TraceTest, FullBufferKeepsNewestEvents) {
+    traceChromeJson();
+    const uint64_t droppedBefore = traceDropped();
+    traceRecord("test.oldest", 1, 2);
+    for (int i = 0; i < 20000; ++i) {
+        traceRecord("test.filler", 1, 2);
+    }
+    traceRecord("test.newest", 1, 2);
+
+    const std::string json = traceChromeJson();
+    EXPECT_EQ(json.find("test.oldest"), std::string::npos);
+    EXPECT_NE(json.find("test.newest"), std::string::npos);
+    size_t events = 0;
+    for (size_t pos = json.find("\"ph\":\"X\""); pos != std::string::npos;
+         pos = json.find("\"ph\":\"X\"", pos + 1)) {
+        ++events;
+    }
+    EXPECT_EQ(events, 16383u);
+    EXPECT_EQ(traceDropped() - droppedBefore, 20002u - 16383u);
+}
+
+TEST(DistributedNodeTest, StatsCommandReportsMetrics) {
+    {
+        std::ofstream ofs("test_wal_stats.log", std::ios::trunc);
+    }
+    DistributedNode node("StatsNode", "test_wal_stats.log", 6018);
+    DataStoreClient client({{"StatsNode", "127.0.0.1", 6018}});
+    std::string val;
+    ASSERT_TRUE(client.put("AAPL", "179"));
+    ASSERT_TRUE(client.get("AAPL", val));
+    EXPECT_FALSE(client.get("MSFT", val));
+
+    std::vector<std::pair<std::string, double>> stats;
+    ASSERT_TRUE(client.stats("StatsNode", stats));
+    std::map<std::string, double> byName(stats.begin(), stats.end());
+    EXPECT_EQ(byName["node_requests_total{cmd=\"PUT\"}"], 1);
+    EXPECT_EQ(byName["node_requests_total{cmd=\"GET\"}"], 2);
+    EXPECT_EQ(byName["node_request_seconds_count{cmd=\"GET\"}"], 2);
+    EXPECT_EQ(byName["kv_get_misses_total"], 1);
+    EXPECT_EQ(byName["kv_keys"], 1);
+    EXPECT_EQ(byName["wal_records_total"], 1);
+    EXPECT_EQ(byName["wal_flush_seconds_count"], 1);
+    EXPECT_GT(byName["node_request_seconds_p99{cmd=\"PUT\"}"], 0);
+
+    int sock = connectTo("127.0.0.1", 6018);
+    ASSERT_GE(sock, 0);
+    ASSERT_TRUE(sendAll(sock, "STATS PROMETHEUS\n"));
+    SocketReader reader(sock);
+    std::string line, text;
+    while (reader.readLine(line) && line != "# EOF") {
+        text += line + "\n";
+    }
+    close(sock);
+    EXPECT_NE(text.find("# TYPE node_request_seconds histogram"), std::string::npos);
+    EXPECT_NE(text.find("kv_ops_total{op=\"put\"} 1\n"), std::string::npos);
+}
+
+TEST(DistributedNodeTest, OwnerReplicatesAndReadsSpread) {
+    std::vector<NodeAddress> cluster = {
+        {"ReplicaA", "127.0.0.1", 6008},
+        {"ReplicaB", "127.0.0.1", 6009},
+        {"ReplicaC", "127.0.0.1", 6010},
+    };
+    std::vector<std::unique_ptr<DistributedNode>> nodes;
+    for (const auto &addr : cluster) {
+        const std::string wal = "test_wal_" + addr.name + ".log";
+        std::ofstream(wal, std::ios::trunc);
+        nodes.push_back(std::make_unique<DistributedNode>(addr.name, wal, addr.port));
+        nodes.back()->setCluster(cluster, 3);
+    }
+    DataStoreClient::Options opts;
+    opts.readReplicas = 3;
+    DataStoreClient client(cluster, opts);
+    ASSERT_TRUE(client.put("AAPL", "179"));
+
+    // Every replica converges on the owner's write
+    std::string val;
+    for (auto &node : nodes) {
+        bool replicated = false;
+        for (int i = 0; i < 200 && !replicated; ++i) {
+            replicated = node->get("AAPL", val) && val == "179";
+            if (!replicated) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        EXPECT_TRUE(replicated) << node->getName();
+    }
+
+    for (int i = 0; i < 60; ++i) {
+        ASSERT_TRUE(client.get("AAPL", val));
+        EXPECT_EQ(val, "179");
+    }
+    const std::vector<size_t> reads = client.readsPerNode();
+    EXPECT_GE(std::count_if(reads.begin(), reads.end(), [](size_t n) { return n > 0; }), 2);
+
+    // Removes are forwarded the same way
+    ASSERT_TRUE(client.remove("AAPL"));
+    for (auto &node : nodes) {
+        bool removed = false;
+        for (int i = 0; i < 200 && !removed; ++i) {
+            removed = !node->get("AAPL", val);
+            if (!removed) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        EXPECT_TRUE(removed) << node->getName();
+    }
+}
+
+TEST(DistributedNodeTest, AtomicCommandsOverWire) {
+    {
+        std::ofstream ofs("test_wal_atomic.log", std::ios::trunc);
+    }
+    {
+        DistributedNode node("AtomicNode", "test_wal_atomic.log", 6011);
+        DataStoreClient client({{"AtomicNode", "127.0.0.1", 6011}});
+        int64_t n = 0;
+        ASSERT_TRUE(client.increment("visits", 5, n));
+        ASSERT_TRUE(client.increment("visits", -2, n));
+        EXPECT_EQ(n, 3);
+
+        std::string val;
+        uint64_t version = 0, next = 0;
+        ASSERT_TRUE(client.getWithVersion("visits", val, version));
+        EXPECT_EQ(val, "3");
+        EXPECT_TRUE(client.compareAndSwap("visits", version, "10", &next));
+        EXPECT_FALSE(client.compareAndSwap("visits", version, "11"));
+
+        size_t length = 0;
+        ASSERT_TRUE(client.append("log", "ab", &length));
+        ASSERT_TRUE(client.append("log", "cd", &length));
+        EXPECT_EQ(length, (size_t)4);
+        EXPECT_FALSE(client.increment("log", 1, n));
+    }
+    // One WAL record per successful operation, replayed to the final values
+    std::ifstream in("test_wal_atomic.log");
+    EXPECT_EQ(std::count(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(), '\n'), 5);
+    ConcurrentHashMap store;
+    WriteAheadLog wal("test_wal_atomic.log");
+    wal.replay(store);
+    std::string val;
+    ASSERT_TRUE(store.get("visits", val));
+    EXPECT_EQ(val, "10");
+    ASSERT_TRUE(store.get("log", val));
+    EXPECT_EQ(val, "abcd");
+}
+
+TEST(DistributedNodeTest, WatchPushesUpdates) {
+    {
+        std::ofstream ofs("test_wal_watch.log", std::ios::trunc);
+    }
+    DistributedNode node("WatchNode", "test_wal_watch.log", 6012);
+    int prefixSock = connectTo("127.0.0.1", 6012);
+    int exactSock = connectTo("127.0.0.1", 6012);
+    ASSERT_GE(prefixSock, 0);
+    ASSERT_GE(exactSock, 0);
+    SocketReader prefixReader(prefixSock), exactReader(exactSock);
+    std::string line;
+    ASSERT_TRUE(sendAll(prefixSock, "WATCH user:*\n"));
+    ASSERT_TRUE(prefixReader.readLine(line));
+    EXPECT_EQ(line, "OK");
+    ASSERT_TRUE(sendAll(exactSock, "WATCH user:2\n"));
+    ASSERT_TRUE(exactReader.readLine(line));
+    EXPECT_EQ(line, "OK");
+
+    node.put("order:1", "ignored");
+    node.put("user:1", "alice");
+    node.put("user:2", "bob");
+    node.removeKey("user:1");
+
+    // UPDATE user:1 may be coalesced into its DELETE if the sender lags
+    std::vector<std::string> lines;
+    bool deleted = false, updated = false;
+    while (!(deleted && updated) && lines.size() < 3 && prefixReader.readLine(line)) {
+        lines.push_back(line);
+        deleted = deleted || line == "DELETE user:1";
+        updated = updated || line == "UPDATE user:2 bob";
+    }
+    EXPECT_TRUE(deleted && updated);
+    for (const auto &l : lines) {
+        EXPECT_TRUE(l == "UPDATE user:1 alice" || l == "UPDATE user:2 bob" || l == "DELETE user:1") << l;
+    }
+    ASSERT_TRUE(exactReader.readLine(line));
+    EXPECT_EQ(line, "UPDATE user:2 bob");
+
+    // A subscriber that hangs up is dropped by the sender
+    close(exactSock);
+    for (int i = 0; i < 200 && node.watchers() > 1; ++i) {
+        node.put("user:2", "carol");
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(node.watchers(), (size_t)1);
+    close(prefixSock);
+}
+
+TEST(DistributedNodeTest, WatchFollowsStoreOrderUnderConcurrentWrites) {
+    {
+        std::ofstream ofs("test_wal_watch_order.log", std::ios::trunc);
+    }
+    DistributedNode node("WatchOrderNode", "test_wal_watch_order.log", 6019);
+    int sock = connectTo("127.0.0.1", 6019);
+    ASSERT_GE(sock, 0);
+    SocketReader reader(sock);
+    std::string line;
+    ASSERT_TRUE(sendAll(sock, "WATCH w:*\n"));
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(line, "OK");
+
+    // 800 changes fit the subscriber's queue, so none is dropped
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&node, t]() {
+            for (int i = 0; i < 200; ++i) {
+                node.put("w:hot", std::to_string(t) + "-" + std::to_string(i));
+            }
+        });
+    }
+    for (auto &w : writers) {
+        w.join();
+    }
+    node.put("w:end", "1");
+
+    // Pushes for one key follow the store's order, so the last one seen
+    // before the end marker is the stored value
+    std::string last;
+    while (reader.readLine(line) && line != "UPDATE w:end 1") {
+        EXPECT_NE(line, "OVERFLOW");
+        if (line.compare(0, 13, "UPDATE w:hot ") == 0) {
+            last = line.substr(13);
+        }
+    }
+    std::string stored;
+    ASSERT_TRUE(node.get("w:hot", stored));
+    EXPECT_EQ(last, stored);
+    close(sock);
+}
+
+TEST(DistributedNodeTest, WatchPushesExpiry) {
+    {
+        std::ofstream ofs("test_wal_watch_expiry.log", std::ios::trunc);
+    }
+    DistributedNode node("WatchExpiryNode", "test_wal_watch_expiry.log", 6020);
+    int sock = connectTo("127.0.0.1", 6020);
+    ASSERT_GE(sock, 0);
+    SocketReader reader(sock);
+    std::string line;
+    ASSERT_TRUE(sendAll(sock, "WATCH s:1\n"));
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(line, "OK");
+
+    // The maintenance thread erases the key once its TTL lapses
+    node.put("s:1", "abc", 30);
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(line, "UPDATE s:1 abc");
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(line, "DELETE s:1");
+    close(sock);
+}
+
+TEST(DistributedNodeTest, ChangeFeedResumesFromCursor) {
+    {
+        std::ofstream ofs("test_wal_cdc.log", std::ios::trunc);
+    }
+    const NodeAddress addr{"CdcNode", "127.0.0.1", 6013};
+    uint64_t cursor = 0;
+    {
+        DistributedNode node(addr.name, "test_wal_cdc.log", addr.port);
+        node.put("a", "1");
+        node.put("b", "2");
+        node.removeKey("a");
+
+        // A malformed cursor is refused rather than read as 0 (oldest event)
+        for (const char *bad : {"abc", "12x", "-5", "+3", "99999999999999999999999"}) {
+            int sock = connectTo(addr.host, addr.port);
+            ASSERT_GE(sock, 0);
+            SocketReader raw(sock);
+            std::string line;
+            ASSERT_TRUE(sendAll(sock, std::string("CDC ") + bad + "\n"));
+            ASSERT_TRUE(raw.readLine(line));
+            EXPECT_EQ(line, "ERROR usage: CDC <fromSeq|->") << bad;
+            close(sock);
+        }
+
+        ChangeFeedReader reader(addr, 0);
+        ChangeEvent e;
+        ASSERT_TRUE(reader.next(e));
+        EXPECT_EQ(e.seq, (uint64_t)1);
+        EXPECT_EQ(e.key, "a");
+        ASSERT_TRUE(reader.next(e));
+        ASSERT_TRUE(reader.next(e));
+        EXPECT_EQ(e.seq, (uint64_t)3);
+        EXPECT_EQ(e.op, ChangeEvent::Op::Remove);
+        // Live tail: a write after the reader caught up is pushed to it
+        node.put("c", "3");
+        ASSERT_TRUE(reader.next(e));
+        EXPECT_EQ(e.key, "c");
+        cursor = reader.cursor();
+        node.put("d", "4");
+    }
+    // After a restart the WAL tail is replayed into the feed, so the saved
+    // cursor resumes exactly where the reader stopped
+    DistributedNode node(addr.name, "test_wal_cdc.log", addr.port);
+    ChangeFeedReader reader(addr, cursor);
+    ChangeEvent e;
+    ASSERT_TRUE(reader.next(e));
+    EXPECT_EQ(e.seq, (uint64_t)5);
+    EXPECT_EQ(e.key, "d");
+    EXPECT_EQ(e.value, "4");
+}
+
+TEST(DistributedNodeTest, LargeBlobsStreamAndSurviveRestart) {
+    {
+        std::ofstream ofs("test_wal_blob.log", std::ios::trunc);
+    }
+    const NodeAddress addr{"BlobNode", "127.0.0.1", 6014};
+    std::string blob(4 << 20, '\0');
+    for (size_t i = 0; i < blob.size(); ++i) {
+        blob[i] = static_cast<char>((i * 131) % 251);
+    }
+    {
+        DistributedNode node(addr.name, "test_wal_blob.log", addr.port);
+        DataStoreClient client({addr});
+
+        // An upload stalled mid-body does not hold up other requests
+        int stalled = connectTo(addr.host, addr.port);
+        ASSERT_GE(stalled, 0);
+        ASSERT_TRUE(sendAll(stalled, "PUTBLOB half 1000000\nabc"));
+        ASSERT_TRUE(client.put("small", "v"));
+        std::string val;
+        ASSERT_TRUE(client.get("small", val));
+        EXPECT_EQ(val, "v");
+
+        ASSERT_TRUE(client.putBlob("blob", blob));
+        ASSERT_TRUE(client.getBlob("blob", val));
+        EXPECT_TRUE(val == blob);
+        // The line protocol refuses values it cannot frame
+        EXPECT_FALSE(client.get("blob", val));
+        close(stalled);
+    }
+    DistributedNode node(addr.name, "test_wal_blob.log", addr.port);
+    std::string val;
+    ASSERT_TRUE(node.get("blob", val));
+    EXPECT_TRUE(val == blob);
+    EXPECT_FALSE(node.get("half", val));
+    ASSERT_TRUE(node.get("small", val));
+    EXPECT_EQ(val, "v");
+}
+
+TEST(DistributedNodeTest, CompressedValuesPassThroughToClients) {
+    {
+        std::ofstream ofs("test_wal_lz.log", std::ios::trunc);
+    }
+    const NodeAddress addr{"LzNode", "127.0.0.1", 6015};
+    ConcurrentHashMap::Options opts;
+    opts.compressMinBytes = 64;
+    DistributedNode node(addr.name, "test_wal_lz.log", addr.port, opts);
+    DataStoreClient client({addr});
+
+    std::string doc;
+    for (int i = 0; i < 100; ++i) {
+        doc += "row " + std::to_string(i % 7) + " of the same report\n";
+    }
+    ASSERT_TRUE(client.putBlob("doc", doc));
+    ASSERT_TRUE(client.put("word", "plain"));
+    std::string val;
+    ASSERT_TRUE(node.get("doc", val));
+    EXPECT_EQ(val, doc);
+
+    // Sent compressed to a client that asks for it, decoded by the client
+    int sock = connectTo(addr.host, addr.port);
+    ASSERT_GE(sock, 0);
+    SocketReader reader(sock);
+    std::string reply;
+    ASSERT_TRUE(sendAll(sock, "GETBLOB doc LZ\n") && reader.readLine(reply));
+    close(sock);
+    EXPECT_EQ(reply.substr(reply.size() - 3), " LZ");
+    EXPECT_LT(std::strtoull(reply.c_str() + 5, nullptr, 10), doc.size() / 2);
+    ASSERT_TRUE(client.getBlob("doc", val));
+    EXPECT_EQ(val, doc);
+    ASSERT_TRUE(client.getBlob("word", val));
+    EXPECT_EQ(val, "plain");
+}
+
+TEST(DistributedNodeTest, ChangeCaptureToColumnarTable) {
+    {
+        std::ofstream ofs("test_wal_capture.log", std::ios::trunc);
+    }
+    DistributedNode node("CaptureNode", "test_wal_capture.log", 6002);
+    std::vector<CaptureColumn> columns = {
+        {"price", 0, CaptureType::Fixed, 2},
+        {"volume", 1, CaptureType::Int, 0},
+    };
+    ASSERT_TRUE(node.enableChangeCapture(columns));
+    EXPECT_FALSE(node.enableChangeCapture(columns));
+
+    node.put("AAPL", "179.33,1200");
+    node.put("IBM", "140.25,800");
+    node.put("BAD", "not_a_number");
+    node.put("GOOG", "2804.42,300");
+
+    ChangeCaptureStream *capture = node.changeCapture();
+    ASSERT_NE(capture, nullptr);
+    capture->flush();
+    EXPECT_EQ(capture->rejected(), (size_t)1);
+    EXPECT_EQ(capture->columnIndex("volume"), 1);
+    EXPECT_EQ(capture->columnIndex("missing"), -1);
+
+    capture->withTable([](const ColumnarTable &t) {
+        EXPECT_EQ(t.getNumRows(), (size_t)3);
+        EXPECT_EQ(t.getColumn(0)[0], 17933);
+        EXPECT_EQ(t.filterLessThan(1, 1000), (size_t)2);
+    });
+
+    // A stalled worker never lets the pending queue grow past maxPending
+    ChangeCaptureStream bounded(columns, ',', 1024, std::chrono::milliseconds(60000), 2);
+    for (int i = 0; i < 5; ++i) {
+        bounded.publish("K" + std::to_string(i), "1.00,1");
+    }
+    EXPECT_EQ(bounded.dropped(), (size_t)3);
+    bounded.flush();
+    bounded.withTable([](const ColumnarTable &t) { EXPECT_EQ(t.getNumRows(), (size_t)2); });
+}
+
+TEST(DistributedNodeTest, QueryOverWireAndScatterGather) {
+    for (const char *f : {"test_wal_query1.log", "test_wal_query2.log"}) {
+        std::ofstream ofs(f, std::ios::trunc);
+    }
+    DistributedNode node1("Q1", "test_wal_query1.log", 6003);
+    DistributedNode node2("Q2", "test_wal_query2.log", 6004);
+    std::vector<CaptureColumn> columns = {
+        {"price", 0, CaptureType::Int, 0},
+        {"volume", 1, CaptureType::Int, 0},
+    };
+    ASSERT_TRUE(node1.enableChangeCapture(columns));
+    ASSERT_TRUE(node2.enableChangeCapture(columns));
+
+    // Declared columns answer before the first row arrives
+    AnalyticsQuery q;
+    QueryResult empty;
+    ASSERT_TRUE(AnalyticsQuery::parse("QUERY COUNT price WHERE volume GE 100", q));
+    ASSERT_TRUE(QueryCoordinator::queryNode("127.0.0.1", 6003, q, empty));
+    EXPECT_EQ(empty.count, (uint64_t)0);
+
+    node1.put("A", "10,100");
+    node1.put("B", "20,200");
+    node2.put("C", "30,300");
+    node2.put("D", "40,50");
+    node1.changeCapture()->flush();
+    node2.changeCapture()->flush();
+
+    ASSERT_TRUE(AnalyticsQuery::parse("QUERY SUM price WHERE volume GE 100", q));
+    EXPECT_EQ(q.toString(), "QUERY SUM price WHERE volume GE 100");
+    EXPECT_FALSE(AnalyticsQuery::parse("QUERY SUM price WHERE volume ?? 1", q));
+
+    QueryResult single;
+    ASSERT_TRUE(AnalyticsQuery::parse("QUERY SELECT price WHERE volume GE 100", q));
+    ASSERT_TRUE(QueryCoordinator::queryNode("127.0.0.1", 6003, q, single));
+    EXPECT_EQ(single.values, (std::vector<int>{10, 20}));
+
+    QueryCoordinator coordinator({{"127.0.0.1", 6003}, {"127.0.0.1", 6004}});
+    QueryResult merged;
+    ASSERT_TRUE(AnalyticsQuery::parse("QUERY AVG price WHERE volume GE 100", q));
+    ASSERT_TRUE(coordinator.execute(q, merged));
+    EXPECT_EQ(merged.count, (uint64_t)3);
+    EXPECT_EQ(merged.sum, 60);
+    EXPECT_EQ(merged.min, 10);
+    EXPECT_EQ(merged.max, 30);
+    EXPECT_DOUBLE_EQ(merged.avg(), 20.0);
+
+    QueryResult bad;
+    ASSERT_TRUE(AnalyticsQuery::parse("QUERY COUNT nope", q));
+    EXPECT_FALSE(QueryCoordinator::queryNode("127.0.0.1", 6003, q, bad));
+}
+
+TEST(ColumnarTableTest, ParallelQueryMatchesSerial) {
+    ColumnarTable t;
+    for (int i = 0; i < 300000; ++i) {
+        t.addRow({i % 1000, i});
+    }
+    auto resolve = [](const std::string &name) { return name == "a" ? 0 : (name == "b" ? 1 : -1); };
+    AnalyticsQuery q;
+    ASSERT_TRUE(AnalyticsQuery::parse("QUERY COUNT b WHERE a LT 100 AND b GE 1000", q));
+    ThreadPool pool(4);
+    QueryResult serial, parallel;
+    ASSERT_TRUE(executeQuery(t, q, resolve, nullptr, serial));
+    ASSERT_TRUE(executeQuery(t, q, resolve, &pool, parallel));
+    EXPECT_EQ(serial.count, parallel.count);
+    EXPECT_EQ(serial.sum, parallel.sum);
+    EXPECT_EQ(serial.count, (uint64_t)(300 * 100 - 100));
+}
+
+TEST(ColumnarTableTest, StreamedQuerySendsOutsideTheLock) {
+    ColumnarTable t;
+    for (int i = 0; i < 300000; ++i) {
+        t.addRow({i % 1000, i});
+    }
+    auto resolve = [](const std::string &name) { return name == "a" ? 0 : (name == "b" ? 1 : -1); };
+    AnalyticsQuery q;
+    ASSERT_TRUE(AnalyticsQuery::parse("QUERY SELECT b WHERE a EQ 7", q));
+    bool locked = false;
+    auto withTable = [&](const std::function<void(const ColumnarTable &)> &f) {
+        locked = true;
+        f(t);
+        locked = false;
+    };
+    std::string reply;
+    size_t pieces = 0;
+    queryResponse(withTable, q, resolve, nullptr, [&](const std::string &piece) {
+        EXPECT_FALSE(locked);
+        reply += piece;
+        ++pieces;
+        return true;
+    });
+    // 300 matches over two windows, then the aggregate
+    EXPECT_EQ(pieces, (size_t)3);
+    ASSERT_EQ(reply.compare(0, 14, "RESULT SELECT\n"), 0);
+    // A batch (count + values) per 64K-row range, end marker, count/sum/min/max
+    EXPECT_EQ(reply.size(), 14 + 5 * 4 + 300 * 4 + 4 + 4 * 8);
+}
+
 // ----------------------------------------------------------
 // 7) LockFreeRingBuffer & ThreadPool Tests (EXTRA coverage)
 // ----------------------------------------------------------
+namespace {
+struct EpochPayload {
+    static constexpr uint64_t kLive = 0x5eed5eed;
+    explicit EpochPayload(std::atomic<size_t> &freed) : freed(freed) {}
+    ~EpochPayload() {
+        magic = 0;
+        freed.fetch_add(1);
+    }
+    uint64_t magic = kLive;
+    std::string data = std::string(64, 'p');
+    std::atomic<size_t> &freed;
+};
+} // namespace
+
+TEST(EpochManagerTest, GuardBlocksReclaimUntilReleased) {
+    std::atomic<size_t> freed{0};
+    EpochManager epochs;
+    {
+        EpochManager::Guard outer(epochs);
+        {
+            EpochManager::Guard inner(epochs);
+        }
+        epochs.retire(new EpochPayload(freed));
+        for (int i = 0; i < 3; ++i) {
+            epochs.tryReclaim();
+        }
+        // Still inside the outer Guard
+        EXPECT_EQ(freed.load(), (size_t)0);
+        EXPECT_EQ(epochs.pending(), (size_t)1);
+    }
+    epochs.tryReclaim();
+    EXPECT_EQ(freed.load(), (size_t)1);
+
+    // An exited thread's registration never holds the epoch back
+    std::thread([&]() { EpochManager::Guard g(epochs); }).join();
+    epochs.retire(new EpochPayload(freed));
+    epochs.tryReclaim();
+    EXPECT_EQ(freed.load(), (size_t)2);
+}
+
+TEST(EpochManagerTest, StressReadersAndRetirers) {
+    std::atomic<size_t> freed{0};
+    const size_t kThreshold = 64;
+    EpochManager epochs(kThreshold);
+    std::atomic<EpochPayload*> current{new EpochPayload(freed)};
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> badReads{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+                EpochManager::Guard guard(epochs);
+                EpochPayload *p = current.load(std::memory_order_acquire);
+                if (p->magic != EpochPayload::kLive || p->data.size() != 64) {
+                    badReads.fetch_add(1);
+                }
+            }
+        });
+    }
+    const size_t kRetired = 8000;
+    size_t maxPending = 0;
+    std::vector<std::thread> writers;
+    std::mutex pendingMtx;
+    for (int t = 0; t < 2; ++t) {
+        writers.emplace_back([&]() {
+            for (size_t i = 0; i < kRetired / 2; ++i) {
+                epochs.retire(current.exchange(new EpochPayload(freed),
+                                               std::memory_order_acq_rel));
+                if (i % 256 == 0) {
+                    std::lock_guard<std::mutex> lock(pendingMtx);
+                    maxPending = std::max(maxPending, epochs.pending());
+                }
+                if (i % 64 == 0) {
+                    // Give preempted readers (on few cores) a chance to leave
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto &w : writers) {
+        w.join();
+    }
+    // Garbage stays bounded while readers never stop entering Guards
+    EXPECT_LT(maxPending, kRetired / 4);
+    stop = true;
+    for (auto &r : readers) {
+        r.join();
+    }
+    EXPECT_EQ(badReads.load(), (size_t)0);
+    epochs.tryReclaim();
+    EXPECT_EQ(freed.load(), kRetired);
+    delete current.load();
+}
+
 TEST_F(TimedTest, BasicPushPop) {
     LockFreeRingBuffer<int, 5> ring;
     EXPECT_EQ(ring.size(), (size_t)0);
@@ -235,6 +2096,40 @@ TEST_F(TimedTest, Overfill) {
     EXPECT_TRUE(ring.push(4));
 }
 
+TEST(BoundedMpmcQueueTest, ManyProducersOneConsumer) {
+    BoundedMpmcQueue<int> queue(5);
+    EXPECT_EQ(queue.capacity(), (size_t)8);
+
+    const int kProducers = 4, kPerProducer = 5000;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < kPerProducer; ++i) {
+                while (!queue.tryPush(p * kPerProducer + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    // Every value arrives exactly once, in order per producer
+    std::vector<int> last(kProducers, -1);
+    int received = 0, val = 0;
+    while (received < kProducers * kPerProducer) {
+        if (!queue.tryPop(val)) {
+            std::this_thread::yield();
+            continue;
+        }
+        const int p = val / kPerProducer;
+        EXPECT_GT(val % kPerProducer, last[p]);
+        last[p] = val % kPerProducer;
+        ++received;
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    EXPECT_FALSE(queue.tryPop(val));
+}
+
 TEST_F(TimedTest, SimpleTask) {
     ThreadPool pool(2);
 